@@ -23,6 +23,7 @@
 
 #include <Eigen/Dense>
 #include <Eigen/Geometry>
+#include <cmath>
 #include <iostream>
 
 /// Returns the 3D cross product Skew symmetric matrix of a given 3D vector.
@@ -109,17 +110,24 @@ Eigen::Quaternion<typename Derived::Scalar> QuaternionFromSmallAngle(
   }
 }
 
+/// False if an entry is NaN or Inf, which makes the sum non-finite, so this
+/// is a single vectorized pass without branches. Also false if the sum
+/// overflows, which no healthy matrix of the filter does.
+template<class D>
+inline bool IsFinite(const Eigen::MatrixBase<D> & mat) {
+  return std::isfinite(mat.sum());
+}
+
 /// Debug output to check numeric value of Eigen types.
 template<class D>
 bool CheckForNumeric(const Eigen::MatrixBase<D> & mat,
                      const std::string & info) {
-  enum {
-    rows = Eigen::MatrixBase < D > ::RowsAtCompileTime,
-    cols = Eigen::MatrixBase < D > ::ColsAtCompileTime
-  };
+  // Only search for the entry to report if there is one.
+  if (IsFinite(mat))
+    return true;
 
-  for (int i = 0; i < rows; ++i) {
-    for (int j = 0; j < cols; ++j) {
+  for (int i = 0; i < mat.rows(); ++i) {
+    for (int j = 0; j < mat.cols(); ++j) {
       if (std::isnan(mat(i, j))) {
         std::cerr << "=== ERROR ===  " << info << ": NAN at index [" << i << ","
             << j << "]" << std::endl;
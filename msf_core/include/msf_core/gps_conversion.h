@@ -25,6 +25,11 @@ class GPSConversion {
 public:
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
+  /// Columns of latitude [deg], longitude [deg] and altitude [m].
+  typedef Eigen::Matrix<double, 3, Eigen::Dynamic> WGS84Points;
+  /// Columns of ECEF or ENU coordinates [m].
+  typedef Eigen::Matrix<double, 3, Eigen::Dynamic> CartesianPoints;
+
   GPSConversion();
   // Default copy constructor and assignment operator are OK.
 
@@ -45,11 +50,64 @@ public:
                                const double longitude,
                                const double altitude) const;
 
+  /// Batch version of WGS84ToENU, converts the points column by column.
+  void WGS84ToENU(const WGS84Points& wgs84, CartesianPoints& enu) const;
+
+  msf_core::Vector3 ENUToECEF(const msf_core::Vector3& enu) const;
+
+  /// Closed form (Bowring) conversion, sub-millimeter close to the surface.
+  msf_core::Vector3 ECEFToWGS84(const msf_core::Vector3& ecef) const;
+
+  /// Returns latitude [deg], longitude [deg] and altitude [m].
+  msf_core::Vector3 ENUToWGS84(const msf_core::Vector3& enu) const;
+
+  void ENUToWGS84(const CartesianPoints& enu, WGS84Points& wgs84) const;
+
+  /**
+   * \brief Sets the radius around the reference in which the local tangent
+   * plane approximation is used. The maximum approximation error within this
+   * radius is evaluated against the exact conversion when the reference is
+   * initialized.
+   */
+  void SetLocalApproximationRadius(double radius);
+
+  /// Maximum error [m] of WGS84ToENULocal within the approximation radius.
+  double GetLocalApproximationError() const {
+    return local_max_error_;
+  }
+
+  /**
+   * \brief Local tangent plane approximation of WGS84ToENU: a second order
+   * expansion in the offsets to the reference, which needs no trigonometric
+   * functions. Only valid close to the reference, see
+   * GetLocalApproximationError.
+   */
+  msf_core::Vector3 WGS84ToENULocal(const double latitude,
+                                    const double longitude,
+                                    const double altitude) const;
+
+  void WGS84ToENULocal(const WGS84Points& wgs84, CartesianPoints& enu) const;
+
   void AdjustReference(const double z_correction);
 
 private:
-  msf_core::Quaternion ecef_ref_orientation_;
+  msf_core::Matrix3 ecef_ref_rotation_;  ///< Rotation ECEF to ENU.
   msf_core::Vector3 ecef_ref_point_;
+  msf_core::Vector3 wgs84_ref_point_;  ///< Latitude, longitude, altitude.
+
+  /// Meters per radian latitude (north) and longitude (east) at reference.
+  double local_north_scale_;
+  double local_east_scale_;
+  /// Prime vertical radius of curvature plus altitude at reference.
+  double local_prime_radius_;
+  double local_s_lat_;
+  double local_c_lat_;
+  /// ENU offset accumulated by AdjustReference.
+  msf_core::Vector3 local_offset_;
+  double local_radius_;
+  double local_max_error_;
+
+  void EvaluateLocalApproximationError();
 };
 }  // namespace msf_core
 #endif  // GPS_CONVERSION_H_
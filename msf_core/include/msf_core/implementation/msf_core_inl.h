@@ -19,9 +19,11 @@
 #ifndef MSF_CORE_INL_H_
 #define MSF_CORE_INL_H_
 
+#include <algorithm>
 #include <chrono>
 #include <thread>
 #include <deque>
+#include <limits>
 #include <numeric>
 #include <string>
 #include <vector>
@@ -48,6 +50,24 @@ MSF_Core<EKFState_T>::MSF_Core(const MSF_SensorManager<EKFState_T>& GetUserCalc)
   isfuzzyState_ = false;
   time_P_propagated = 0;
   it_last_IMU = stateBuffer_.GetIteratorEnd();
+  degradation_level_ = DEGRADATION_NONE;
+  processing_lag_ = 0;
+  min_time_offset_ = std::numeric_limits<double>::infinity();
+  processing_end_walltime_ = 0;
+  level_changed_walltime_ = 0;
+  virtual_measurement_states_ = false;
+
+  workspace_.KH.resize(nErrorStatesAtCompileTime, nErrorStatesAtCompileTime);
+  workspace_.F_accum.resize(nErrorStatesAtCompileTime,
+                            nErrorStatesAtCompileTime);
+  workspace_.tmp.resize(nErrorStatesAtCompileTime, nErrorStatesAtCompileTime);
+  workspace_.P_virtual.resize(nErrorStatesAtCompileTime,
+                              nErrorStatesAtCompileTime);
+  square_root_covariance_.Resize(nErrorStatesAtCompileTime);
+
+  smoother_.SetCallback([this](const shared_ptr<EKFState_T>& state) {
+    usercalc_.PublishSmoothedState(state);
+  });
 }
 
 template<typename EKFState_T>
@@ -55,9 +75,7 @@ MSF_Core<EKFState_T>::~MSF_Core() {
 }
 
 template<typename EKFState_T>
-void MSF_Core<EKFState_T>::SetPCore(
-    Eigen::Matrix<double, EKFState_T::nErrorStatesAtCompileTime,
-        EKFState_T::nErrorStatesAtCompileTime>& P) {
+void MSF_Core<EKFState_T>::SetPCore(ErrorStateCov& P) {
   enum {
     // We might want to calculate this, but on the other hand the values for the
     // matrix later on are anyway hardcoded.
@@ -94,6 +112,131 @@ const MSF_SensorManager<EKFState_T>& MSF_Core<EKFState_T>::GetUserCalc() const {
   return usercalc_;
 }
 
+template<typename EKFState_T>
+void MSF_Core<EKFState_T>::SetCovarianceThreads(int num_threads,
+                                                int min_dimension) {
+  covariance_kernels_.SetNumThreads(num_threads);
+  covariance_kernels_.SetMinDimension(min_dimension);
+  if (covariance_kernels_.IsParallel(nErrorStatesAtCompileTime)) {
+    MSF_INFO_STREAM("Using " << covariance_kernels_.GetNumThreads()
+                    << " threads for the covariance of the "
+                    << nErrorStatesAtCompileTime << " error states.");
+  }
+}
+
+template<typename EKFState_T>
+void MSF_Core<EKFState_T>::SetSquareRootCovariance(bool enabled,
+                                                   bool single_precision) {
+  square_root_covariance_.SetEnabled(enabled);
+  square_root_covariance_.SetSinglePrecision(single_precision);
+  if (enabled) {
+    MSF_INFO_STREAM("Using the square-root form of the covariance"
+                    << (single_precision ? " with a single precision factor."
+                        : "."));
+  }
+}
+
+template<typename EKFState_T>
+void MSF_Core<EKFState_T>::SetVirtualMeasurementStates(bool enabled) {
+  virtual_measurement_states_ = enabled;
+  if (enabled) {
+    MSF_INFO_STREAM("Applying the measurements between two states on virtual "
+                    "states.");
+  }
+}
+
+template<typename EKFState_T>
+void MSF_Core<EKFState_T>::SetSmootherLag(double lag) {
+  smoother_.SetLag(lag);
+  applied_corrections_.clear();
+  if (smoother_.IsEnabled()) {
+    MSF_INFO_STREAM("Smoothing the states over a lag of " << lag << " s.");
+  }
+}
+
+template<typename EKFState_T>
+void MSF_Core<EKFState_T>::FlushSmoother() {
+  smoother_.Flush();
+}
+
+template<typename EKFState_T>
+void MSF_Core<EKFState_T>::SetSensorLowPriority(int sensorID,
+                                                bool low_priority) {
+  if (low_priority)
+    low_priority_sensors_[sensorID] = 0;
+  else
+    low_priority_sensors_.erase(sensorID);
+}
+
+template<typename EKFState_T>
+size_t MSF_Core<EKFState_T>::GetRejectedMeasurements(int sensorID) const {
+  typename std::map<int, size_t>::const_iterator it = rejected_measurements_
+      .find(sensorID);
+  return it == rejected_measurements_.end() ? 0 : it->second;
+}
+
+template<typename EKFState_T>
+double MSF_Core<EKFState_T>::WallTime() {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template<typename EKFState_T>
+void MSF_Core<EKFState_T>::UpdateProcessingLag(double msg_stamp) {
+  const double max_lag = usercalc_.GetParamMaxProcessingLag();
+  if (max_lag <= 0) {
+    processing_lag_ = 0;
+    if (degradation_level_ != DEGRADATION_NONE)
+      SetDegradationLevel(DEGRADATION_NONE);
+    return;
+  }
+
+  const double walltime = WallTime();
+
+  // Wall time minus message time is the transport delay plus the time we lag
+  // behind. If the core was idle before this message it had kept up, so the
+  // current offset is the delay only.
+  const double time_offset = walltime - msg_stamp;
+  const double idle_threshold = 5e-4;
+  if (walltime - processing_end_walltime_ > idle_threshold
+      || time_offset < min_time_offset_) {
+    min_time_offset_ = time_offset;
+  }
+  processing_lag_ = time_offset - min_time_offset_;
+
+  // Step one level at a time and give each level some time to take effect.
+  const double escalate_hold_time = 0.5;
+  const double recover_hold_time = 2.0;
+  const double time_since_change = walltime - level_changed_walltime_;
+  if (processing_lag_ > max_lag && degradation_level_ < DEGRADATION_MAX
+      && time_since_change > escalate_hold_time) {
+    SetDegradationLevel(static_cast<DegradationLevel>(degradation_level_ + 1));
+    level_changed_walltime_ = walltime;
+  } else if (processing_lag_ < 0.5 * max_lag
+      && degradation_level_ > DEGRADATION_NONE
+      && time_since_change > recover_hold_time) {
+    SetDegradationLevel(static_cast<DegradationLevel>(degradation_level_ - 1));
+    level_changed_walltime_ = walltime;
+  }
+}
+
+template<typename EKFState_T>
+void MSF_Core<EKFState_T>::SetDegradationLevel(DegradationLevel level) {
+  static const char* names[] = { "none", "skip covariance publishing",
+      "reduce covariance propagation", "decimate low priority sensors",
+      "coarse repropagation" };
+  if (level > degradation_level_) {
+    MSF_WARN_STREAM(
+        "Processing lags " << processing_lag_ << " s behind, degrading to "
+        "level " << level << " (" << names[level] << ")");
+  } else {
+    MSF_INFO_STREAM(
+        "Processing lags " << processing_lag_ << " s behind, recovering to "
+        "level " << level << " (" << names[level] << ")");
+  }
+  degradation_level_ = level;
+}
+
 template<typename EKFState_T>
 void MSF_Core<EKFState_T>::ProcessIMU(
     const msf_core::Vector3& linear_acceleration,
@@ -103,6 +246,9 @@ void MSF_Core<EKFState_T>::ProcessIMU(
   if (!initialized_)
     return;
 
+  ProcessingScope processing_scope(processing_end_walltime_);
+  UpdateProcessingLag(msg_stamp);
+
   msf_timing::DebugTimer timer_PropGetClosestState("PropGetClosestState");
   if (it_last_IMU == stateBuffer_.GetIteratorEnd()) {
     it_last_IMU = stateBuffer_.GetIteratorClosestBefore(msg_stamp);
@@ -216,6 +362,9 @@ void MSF_Core<EKFState_T>::ProcessExternallyPropagatedState(
   if (!initialized_)
     return;
 
+  ProcessingScope processing_scope(processing_end_walltime_);
+  UpdateProcessingLag(msg_stamp);
+
   // fast method to get last_IMU is broken
   // TODO(slynen): fix iterator setting for state callback
 
@@ -290,9 +439,7 @@ void MSF_Core<EKFState_T>::ProcessExternallyPropagatedState(
 
     stateBuffer_.Clear();
     MeasurementBuffer_.Clear();
-    while (!queueFutureMeasurements_.empty()) {
-      queueFutureMeasurements_.pop();
-    }
+    pendingMeasurements_.clear();
   }
 
   stateBuffer_.Insert(currentState);
@@ -302,7 +449,8 @@ void MSF_Core<EKFState_T>::ProcessExternallyPropagatedState(
 
   isnumeric = CheckForNumeric(
       currentState->template Get<StateDefinition_T::p>(), "prediction p");
-  isnumeric = CheckForNumeric(currentState->P, "prediction done P");
+  isnumeric = numeric_health_.CheckCovariance(currentState->P,
+                                              "prediction done P");
 
   // Check if we can apply some pending measurement.
   HandlePendingMeasurements();
@@ -310,12 +458,24 @@ void MSF_Core<EKFState_T>::ProcessExternallyPropagatedState(
 
 template<typename EKFState_T>
 void MSF_Core<EKFState_T>::HandlePendingMeasurements() {
-  if (queueFutureMeasurements_.empty())
+  if (pendingMeasurements_.empty() || !initialized_ || !predictionMade_)
     return;
-  shared_ptr<MSF_MeasurementBase<EKFState_T> > meas = queueFutureMeasurements_
-      .front();
-  queueFutureMeasurements_.pop();
-  AddMeasurement(meas);
+  const double time_last = stateBuffer_.GetLast()->time;
+  typename measurementBufferT::iterator_T it_first = MeasurementBuffer_
+      .GetIteratorEnd();
+  typename PendingMeasurements_T::iterator it_pending = pendingMeasurements_
+      .begin();
+  for (; it_pending != pendingMeasurements_.end()
+      && it_pending->first <= time_last; ++it_pending) {
+    typename measurementBufferT::iterator_T it_meas;
+    // The first one is the oldest, the others are applied after it.
+    if (InsertMeasurement(it_pending->second, it_meas)
+        && it_first == MeasurementBuffer_.GetIteratorEnd())
+      it_first = it_meas;
+  }
+  pendingMeasurements_.erase(pendingMeasurements_.begin(), it_pending);
+  if (it_first != MeasurementBuffer_.GetIteratorEnd())
+    ApplyMeasurements(it_first);
 }
 
 template<typename EKFState_T>
@@ -323,6 +483,11 @@ void MSF_Core<EKFState_T>::CleanUpBuffers() {
   double timeold = 60;  // 1 min.
   stateBuffer_.ClearOlderThan(timeold);
   MeasurementBuffer_.ClearOlderThan(timeold);
+  if (!applied_corrections_.empty()) {
+    applied_corrections_.erase(
+        applied_corrections_.begin(),
+        applied_corrections_.lower_bound(stateBuffer_.GetFirst()->time));
+  }
 }
 
 template<typename EKFState_T>
@@ -331,10 +496,12 @@ void MSF_Core<EKFState_T>::PropagateState(shared_ptr<EKFState_T>& state_old,
 
   double dt = state_new->time - state_old->time;
 
-  // Reset new state to zero.
-  boost::fusion::for_each(state_new->statevars, msf_tmp::ResetState());
+  // The updates of the state are applied again after the propagation.
+  applied_corrections_.erase(state_new->time);
 
-  // Zero props: copy constant for non propagated states.
+  // Zero props: copy constant for non propagated states. Together with the
+  // propagation below this writes every state variable, so the new state
+  // needs no reset before.
   boost::fusion::for_each(
       state_new->statevars,
       msf_tmp::CopyNonPropagationStates<EKFState_T>(*state_old));
@@ -377,9 +544,12 @@ void MSF_Core<EKFState_T>::PropagateState(shared_ptr<EKFState_T>& state_old,
   state_old->template Get<StateDefinition_T::q>().coeffs();
   state_new->template Get<StateDefinition_T::q>().normalize();
 
-  dv = (state_new->template Get<StateDefinition_T::q>().toRotationMatrix() *
-       ea + state_old->template Get<StateDefinition_T::q>().toRotationMatrix() *
-       eaold) / 2;
+  // The rotation of state_old is cached from its own propagation, the one of
+  // state_new is reused by PredictProcessCovariance.
+  dv = (const_cast<const EKFState_T&>(*state_new)
+      .template GetRotationMatrix<StateDefinition_T::q>() * ea
+      + const_cast<const EKFState_T&>(*state_old)
+      .template GetRotationMatrix<StateDefinition_T::q>() * eaold) / 2;
   state_new->template Get<StateDefinition_T::v>() =
       state_old->template Get<StateDefinition_T::v>()
       + (dv - constants::GRAVITY) * dt;
@@ -402,13 +572,14 @@ void MSF_Core<EKFState_T>::PropagatePOneStep() {
   // Might happen if there is a measurement in the future.
   if (stateIteratorPLastPropagatedNext != stateBuffer_.GetIteratorEnd()) {
 
-    PredictProcessCovariance(stateIteratorPLastPropagated->second,
-                             stateIteratorPLastPropagatedNext->second);
+    stateIteratorPLastPropagatedNext = PropagateCovarianceStep(
+        stateIteratorPLastPropagated, stateBuffer_.GetLast()->time);
 
     if (!CheckForNumeric(
         stateIteratorPLastPropagatedNext->second
             ->template Get<StateDefinition_T::p>(),
-        "prediction p")) {
+        "prediction p") || !numeric_health_.CheckCovariance(
+        stateIteratorPLastPropagatedNext->second->P, "prediction P")) {
       MSF_WARN_STREAM(
           "prop state from:\t"<<
           stateIteratorPLastPropagated->second->ToEigenVector());
@@ -419,23 +590,83 @@ void MSF_Core<EKFState_T>::PropagatePOneStep() {
       predictionMade_ = initialized_ = false;
     }
   }
+  UpdateSmoother();
+}
+
+template<typename EKFState_T>
+void MSF_Core<EKFState_T>::UpdateSmoother() {
+  if (!smoother_.IsEnabled() || !initialized_)
+    return;
+  // The states skipped by the covariance propagation have no transition of
+  // their own.
+  if (degradation_level_ >= DEGRADATION_REDUCE_COVARIANCE_PROPAGATION) {
+    smoother_.Reset();
+    return;
+  }
+  // The updates and inserted states discard the copies they changed, the
+  // states from there on are added again.
+  smoother_.DiscardFrom(time_P_propagated);
+  double time_last = smoother_.GetLastTime();
+  if (time_last < 0)
+    time_last = time_P_propagated - smoother_.GetLag();
+  // The transition of a state to the next is known once the covariance of
+  // the next state is propagated.
+  const ErrorState no_correction = ErrorState::Zero();
+  for (typename StateBuffer_T::iterator_T it = stateBuffer_
+      .GetIteratorClosestAfter(time_last);
+      it != stateBuffer_.GetIteratorEnd() && it->first < time_P_propagated;
+      ++it) {
+    typename AppliedCorrections_T::const_iterator it_correction =
+        applied_corrections_.find(it->first);
+    smoother_.Add(*it->second, it_correction == applied_corrections_.end() ?
+        no_correction : it_correction->second);
+  }
+}
+
+template<typename EKFState_T>
+typename MSF_Core<EKFState_T>::StateBuffer_T::iterator_T
+MSF_Core<EKFState_T>::PropagateCovarianceStep(
+    typename StateBuffer_T::iterator_T it_from, double time_max) {
+  typename StateBuffer_T::iterator_T it_end = stateBuffer_.GetIteratorEnd();
+  typename StateBuffer_T::iterator_T it_to = it_from;
+  ++it_to;
+
+  if (degradation_level_ < DEGRADATION_REDUCE_COVARIANCE_PROPAGATION) {
+    PredictProcessCovariance(it_from->second, it_to->second);
+    return it_to;
+  }
+
+  // Skip over up to degradedCovarianceStride - 1 states. These keep the
+  // covariance of it_from and an identity transition, so accumulated
+  // transitions stay consistent.
+  typename StateBuffer_T::iterator_T it_skipped = it_to;
+  for (int i = 1; i < degradedCovarianceStride; ++i) {
+    typename StateBuffer_T::iterator_T it_next = it_to;
+    ++it_next;
+    if (it_next == it_end || it_next->second->time > time_max)
+      break;
+    it_to = it_next;
+  }
+  for (; it_skipped != it_to; ++it_skipped) {
+    it_skipped->second->P = it_from->second->P;
+    it_skipped->second->Fd.setIdentity();
+  }
+  PredictProcessCovariance(it_from->second, it_to->second);
+  return it_to;
 }
 
 template<typename EKFState_T>
 void MSF_Core<EKFState_T>::GetAccumulatedStateTransitionStochasticCloning(
     const shared_ptr<EKFState_T>& state_old,
-    const shared_ptr<EKFState_T>& state_new,
-    Eigen::Matrix<double, MSF_Core<EKFState_T>::nErrorStatesAtCompileTime,
-        MSF_Core<EKFState_T>::nErrorStatesAtCompileTime>& F) {
+    const shared_ptr<EKFState_T>& state_new, ErrorStateCov& F) {
   typename StateBuffer_T::iterator_T it = stateBuffer_.GetIteratorAtValue(
       state_old);
   typename StateBuffer_T::iterator_T itend = stateBuffer_.GetIteratorAtValue(
       state_new);
-  typedef Eigen::Matrix<double, MSF_Core<EKFState_T>::nErrorStatesAtCompileTime,
-      MSF_Core<EKFState_T>::nErrorStatesAtCompileTime> F_type;
-  F = F_type::Identity();
+  F.setIdentity(nErrorStatesAtCompileTime, nErrorStatesAtCompileTime);
   for (; it != itend; ++it) {
-    F = F * it->second->Fd;
+    workspace_.tmp.noalias() = F * it->second->Fd;
+    F.swap(workspace_.tmp);
   }
 }
 
@@ -469,7 +700,8 @@ void MSF_Core<EKFState_T>::PredictProcessCovariance(
   const Matrix3 w_sk = Skew(ew);
   const Matrix3 eye3 = Eigen::Matrix<double, 3, 3>::Identity();
 
-  const Matrix3 C_eq = state_new->template Get<StateDefinition_T::q>().toRotationMatrix();
+  const Matrix3& C_eq = const_cast<const EKFState_T&>(*state_new)
+      .template GetRotationMatrix<StateDefinition_T::q>();
 
   const double dt_p2_2 = dt * dt * 0.5;
   const double dt_p3_6 = dt_p2_2 * dt / 3.0;
@@ -531,11 +763,18 @@ void MSF_Core<EKFState_T>::PredictProcessCovariance(
   // Now copy the userdefined blocks to Qd.
   boost::fusion::for_each(
       state_new->statevars,
-      msf_tmp::CopyQBlocksFromAuxiliaryStatesToQ<StateSequence_T>(Qd));
+      msf_tmp::CopyQBlocksFromAuxiliaryStatesToQ<StateSequence_T,
+          typename EKFState_T::Q_type>(Qd));
 
   // TODO (slynen) Optim: Multiplication of F blockwise, using the fact that aux
   // states have no entries outside their block.
-  state_new->P = Fd * state_old->P * Fd.transpose() + Qd;
+  if (square_root_covariance_.IsEnabled()) {
+    square_root_covariance_.Propagate(Fd, state_old->P, Qd, state_new->P);
+  } else {
+    covariance_kernels_.Sandwich(Fd, state_old->P, workspace_.tmp,
+                                 state_new->P);
+    state_new->P += Qd;
+  }
 
   // Set time for best cov prop to now.
   time_P_propagated = state_new->time;
@@ -555,8 +794,16 @@ void MSF_Core<EKFState_T>::Init(
   stateBuffer_.Clear();
   fuzzyTracker_.Reset();
 
-  while (!queueFutureMeasurements_.empty())
-    queueFutureMeasurements_.pop();
+  degradation_level_ = DEGRADATION_NONE;
+  processing_lag_ = 0;
+  min_time_offset_ = std::numeric_limits<double>::infinity();
+
+  pendingMeasurements_.clear();
+
+  smoother_.Reset();
+  applied_corrections_.clear();
+  virtual_state_.reset();
+  virtual_state_origin_.reset();
 
   // Push one state to the buffer to apply the init on.
   shared_ptr<EKFState_T> state(new EKFState_T);
@@ -605,15 +852,38 @@ void MSF_Core<EKFState_T>::AddMeasurement(
     shared_ptr<MSF_MeasurementBase<EKFState_T> > measurement) {
 
   // Return if not initialized of no imu data available.
-  if (!initialized_ || !predictionMade_)
+  if (!initialized_ || !predictionMade_) {
+    ++rejected_measurements_[measurement->sensorID_];
     return;
+  }
+
+  ProcessingScope processing_scope(processing_end_walltime_);
 
   // Check if the measurement is in the future where we don't have imu
   // measurements yet.
   if (measurement->time > stateBuffer_.GetLast()->time) {
-    queueFutureMeasurements_.push(measurement);
+    pendingMeasurements_.insert(std::make_pair(measurement->time, measurement));
     return;
+  }
 
+  typename measurementBufferT::iterator_T it_meas;
+  if (InsertMeasurement(measurement, it_meas))
+    ApplyMeasurements(it_meas);
+}
+
+template<typename EKFState_T>
+bool MSF_Core<EKFState_T>::InsertMeasurement(
+    const shared_ptr<MSF_MeasurementBase<EKFState_T> >& measurement,
+    typename measurementBufferT::iterator_T& it_meas) {
+  // Decimate low priority sensors if we can not keep up.
+  if (degradation_level_ >= DEGRADATION_DECIMATE_LOW_PRIORITY_SENSORS) {
+    typename std::map<int, size_t>::iterator it_sensor = low_priority_sensors_
+        .find(measurement->sensorID_);
+    if (it_sensor != low_priority_sensors_.end()
+        && it_sensor->second++ % degradedLowPriorityDecimation != 0) {
+      ++rejected_measurements_[measurement->sensorID_];
+      return false;
+    }
   }
   // Check if there is still a state in the buffer for this message (too old).
   if (measurement->time < stateBuffer_.GetFirst()->time) {
@@ -622,12 +892,18 @@ void MSF_Core<EKFState_T>::AddMeasurement(
         "you sure your clocks are synced and delays compensated correctly? "
         "[measurement: "<<timehuman(measurement->time)<<" (s) first state in "
             "buffer: "<<timehuman(stateBuffer_.GetFirst()->time)<<" (s)]");
-    return;  // Reject measurements too far in the past.
+    ++rejected_measurements_[measurement->sensorID_];
+    return false;  // Reject measurements too far in the past.
   }
 
   // Add this measurement to the buffer and get an iterator to it.
-  typename measurementBufferT::iterator_T it_meas =
-      MeasurementBuffer_.Insert(measurement);
+  it_meas = MeasurementBuffer_.Insert(measurement);
+  return true;
+}
+
+template<typename EKFState_T>
+void MSF_Core<EKFState_T>::ApplyMeasurements(
+    typename measurementBufferT::iterator_T it_meas) {
   // Get an iterator the the end of the measurement buffer.
   typename measurementBufferT::iterator_T it_meas_end = MeasurementBuffer_
       .GetIteratorEnd();
@@ -646,7 +922,11 @@ void MSF_Core<EKFState_T>::AddMeasurement(
       continue;
     msf_timing::DebugTimer timer_meas_get_state("Get state for measurement");
     // Propagates covariance to state.
-    shared_ptr<EKFState_T> state = GetClosestState(it_meas->second->time);
+    // Relative measurements need their states in the buffer to accumulate the
+    // transition between them.
+    shared_ptr<EKFState_T> state = GetClosestState(
+        it_meas->second->time,
+        virtual_measurement_states_ && it_meas->second->isabsolute_);
     timer_meas_get_state.Stop();
     if (state->time <= 0) {
       MSF_ERROR_STREAM_THROTTLE(
@@ -657,8 +937,15 @@ void MSF_Core<EKFState_T>::AddMeasurement(
     msf_timing::DebugTimer timer_meas_apply("Apply measurement");
     // Calls back core::ApplyCorrection(), which sets time_P_propagated to meas
     // time.
+    const bool is_virtual_state = state == virtual_state_;
     it_meas->second->Apply(state, *this);
     timer_meas_apply.Stop();
+    // The update of a virtual state went to the buffered state before it.
+    if (is_virtual_state) {
+      state = virtual_state_origin_;
+      virtual_state_.reset();
+      virtual_state_origin_.reset();
+    }
     // Make sure to propagate to next measurement or up to now if no more
     // measurements. Propagate from current state.
     it_curr = stateBuffer_.GetIteratorAtValue(state);
@@ -677,6 +964,23 @@ void MSF_Core<EKFState_T>::AddMeasurement(
       }
     }
 
+    // Repropagating to now, thin out the states on the way if degraded. The
+    // latest state is kept, the IMU handler continues from it.
+    if (degradation_level_ >= DEGRADATION_COARSE_REPROPAGATION
+        && it_end == stateBuffer_.GetIteratorEnd()) {
+      typename StateBuffer_T::iterator_T it_last = it_end;
+      --it_last;
+      typename StateBuffer_T::iterator_T it_thin = it_curr;
+      if (it_thin != it_last)
+        ++it_thin;
+      for (int i = 1; it_thin != it_last; ++i) {
+        if (i % degradedRepropagationStride != 0)
+          it_thin = stateBuffer_.Erase(it_thin);
+        else
+          ++it_thin;
+      }
+    }
+
     typename StateBuffer_T::iterator_T it_next = it_curr;
     ++it_next;
 
@@ -744,7 +1048,8 @@ shared_ptr<EKFState_T> MSF_Core<EKFState_T>::GetStateAtTime(double tstamp) {
 }
 
 template<typename EKFState_T>
-shared_ptr<EKFState_T> MSF_Core<EKFState_T>::GetClosestState(double tstamp) {
+shared_ptr<EKFState_T> MSF_Core<EKFState_T>::GetClosestState(
+    double tstamp, bool virtual_state) {
 
   double timenow = tstamp;  // Delay compensated by sensor handler.
 
@@ -799,11 +1104,26 @@ shared_ptr<EKFState_T> MSF_Core<EKFState_T>::GetClosestState(double tstamp) {
       // Propagate with respective dt.
       PropagateState(lastState, currentState);
 
-      stateBuffer_.Insert(currentState);
-
-      // Make sure we propagate P correctly to the new state.
-      if (time_P_propagated > lastState->time) {
+      if (virtual_state) {
+        // Predict the covariance of the virtual state from the state before,
+        // whose transition to the next state is overwritten by this and
+        // therefore propagated again.
+        PropPToState(lastState);
+        PredictProcessCovariance(lastState, currentState);
         time_P_propagated = lastState->time;
+        smoother_.DiscardFrom(lastState->time);
+        workspace_.P_virtual = currentState->P;
+        virtual_state_ = currentState;
+        virtual_state_origin_ = lastState;
+      } else {
+        stateBuffer_.Insert(currentState);
+
+        // Make sure we propagate P correctly to the new state.
+        if (time_P_propagated > lastState->time) {
+          time_P_propagated = lastState->time;
+        }
+        // The transition of the state before changed.
+        smoother_.DiscardFrom(lastState->time);
       }
 
       closestState = currentState;
@@ -835,9 +1155,10 @@ void MSF_Core<EKFState_T>::PropPToState(shared_ptr<EKFState_T>& state) {
   typename StateBuffer_T::iterator_T itMinus = it;
   ++it;
   // Until we reached the current state or the end of the state list.
-  for (; it != stateBuffer_.GetIteratorEnd() && it->second->time <= state->time;
-      ++it, ++itMinus) {
-    PredictProcessCovariance(itMinus->second, it->second);
+  while (it != stateBuffer_.GetIteratorEnd() && it->second->time <= state->time) {
+    itMinus = PropagateCovarianceStep(itMinus, state->time);
+    it = itMinus;
+    ++it;
   }
 }
 
@@ -849,6 +1170,25 @@ bool MSF_Core<EKFState_T>::ApplyCorrection(shared_ptr<EKFState_T>& delaystate,
   if (!initialized_ || !predictionMade_)
     return false;
 
+  if (delaystate == virtual_state_) {
+    // Map the update of the virtual state v onto the state before it with the
+    // smoother gain G = P * Fd' * P_v^-1:
+    //   dx = G * dx_v,  P += G * (P_v_updated - P_v) * G'.
+    shared_ptr<EKFState_T> origin = virtual_state_origin_;
+    virtual_state_.reset();
+    ErrorStateCov& G_t = workspace_.F_accum;
+    workspace_.tmp.noalias() = origin->Fd * origin->P;
+    G_t = workspace_.P_virtual.ldlt().solve(workspace_.tmp);
+    ErrorState origin_correction = G_t.transpose() * correction;
+    workspace_.P_virtual = delaystate->P - workspace_.P_virtual;
+    workspace_.tmp.noalias() = workspace_.P_virtual * G_t;
+    origin->P.template triangularView<Eigen::Upper>() += G_t.transpose()
+        * workspace_.tmp;
+    origin->P.template triangularView<Eigen::StrictlyLower>() =
+        origin->P.transpose();
+    return ApplyCorrection(origin, origin_correction, fuzzythres);
+  }
+
   // Give the user the possibility to fix some states.
   usercalc_.AugmentCorrectionVector(correction);
 
@@ -890,7 +1230,8 @@ bool MSF_Core<EKFState_T>::ApplyCorrection(shared_ptr<EKFState_T>& delaystate,
   // State update:
   // TODO(slynen) What to do with attitude? Augment measurement noise?
   // Store old values in case of fuzzy tracking.
-  EKFState_T buffstate = *delaystate;
+  correction_backup_ = *delaystate;
+  EKFState_T& buffstate = correction_backup_;
 
   // Call correction function for every state.
   delaystate->Correct(correction);
@@ -898,6 +1239,15 @@ bool MSF_Core<EKFState_T>::ApplyCorrection(shared_ptr<EKFState_T>& delaystate,
   // Allow the user to sanity check the new state.
   usercalc_.SanityCheckCorrection(*delaystate, buffstate, correction);
 
+  if (smoother_.IsEnabled()) {
+    typename AppliedCorrections_T::iterator it_correction =
+        applied_corrections_.find(delaystate->time);
+    if (it_correction == applied_corrections_.end())
+      applied_corrections_.insert(std::make_pair(delaystate->time, correction));
+    else
+      it_correction->second += correction;
+  }
+
   // TODO(slynen): Allow multiple fuzzy tracking states at the same time.
   isfuzzyState_ |= fuzzyTracker_.Check(delaystate, buffstate, fuzzythres);
 
@@ -907,6 +1257,9 @@ bool MSF_Core<EKFState_T>::ApplyCorrection(shared_ptr<EKFState_T>& delaystate,
 
   // Set time latest propagated, we need to repropagate at least from here.
   time_P_propagated = delaystate->time;
+  // The smoother holds copies of the states from here on, which are added
+  // again with the correction once their covariance is propagated.
+  smoother_.DiscardFrom(delaystate->time);
 
   return 1;
 }
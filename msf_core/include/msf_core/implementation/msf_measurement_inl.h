@@ -50,13 +50,18 @@ void MSF_MeasurementBase<EKFState_T>::CalculateAndApplyCorrection(
   S = H_delayed * P * H_delayed.transpose() + R_delayed;
   K = P * H_delayed.transpose() * S.inverse();
 
+  core.numeric_health_.CheckKernel(K);
   correction_ = K * res_delayed;
-  const typename MSF_Core<EKFState_T>::ErrorStateCov KH =
-      (MSF_Core<EKFState_T>::ErrorStateCov::Identity() - K * H_delayed);
-  P = KH * P * KH.transpose() + K * R_delayed * K.transpose();
-
-  // Make sure P stays symmetric.
-  P = 0.5 * (P + P.transpose());
+  // The Joseph form also covers a failed downdate.
+  if (!core.square_root_covariance_.IsEnabled() ||
+      !core.square_root_covariance_.Downdate(K * S.llt().matrixL(), P)) {
+    typename MSF_Core<EKFState_T>::ErrorStateCov & KH = core.workspace_.KH;
+    KH.setIdentity();
+    KH.noalias() -= K * H_delayed;
+    // Only computes the upper triangle, so P stays exactly symmetric.
+    core.covariance_kernels_.JosephUpdate(KH, K, R_delayed,
+                                          core.workspace_.tmp, P);
+  }
 
   core.ApplyCorrection(state, correction_);
 }
@@ -80,13 +85,60 @@ void MSF_MeasurementBase<EKFState_T>::CalculateAndApplyCorrection(
   S = H_delayed * P * H_delayed.transpose() + R_delayed;
   K = P * H_delayed.transpose() * S.inverse();
 
+  core.numeric_health_.CheckKernel(K);
   correction_ = K * res_delayed;
-  const typename MSF_Core<EKFState_T>::ErrorStateCov KH =
-      (MSF_Core<EKFState_T>::ErrorStateCov::Identity() - K * H_delayed);
-  P = KH * P * KH.transpose() + K * R_delayed * K.transpose();
+  // The Joseph form also covers a failed downdate.
+  if (!core.square_root_covariance_.IsEnabled() ||
+      !core.square_root_covariance_.Downdate(K * S.llt().matrixL(), P)) {
+    typename MSF_Core<EKFState_T>::ErrorStateCov & KH = core.workspace_.KH;
+    KH.setIdentity();
+    KH.noalias() -= K * H_delayed;
+    // Only computes the upper triangle, so P stays exactly symmetric.
+    core.covariance_kernels_.JosephUpdate(KH, K, R_delayed,
+                                          core.workspace_.tmp, P);
+  }
 
-  // Make sure P stays symmetric.
-  P = 0.5 * (P + P.transpose());
+  core.ApplyCorrection(state, correction_);
+}
+
+template<typename EKFState_T>
+template<int MaxNonZeros>
+void MSF_MeasurementBase<EKFState_T>::CalculateAndApplyScalarCorrection(
+    shared_ptr<EKFState_T> state, MSF_Core<EKFState_T>& core,
+    const SparseJacobianRow<MaxNonZeros>& H, double residual, double R) {
+  enum {
+    nErrorStates = MSF_Core<EKFState_T>::nErrorStatesAtCompileTime
+  };
+  typename MSF_Core<EKFState_T>::ErrorStateCov & P = state->P;
+
+  // P * H' and S = H * P * H' + R from the non-zero entries of H only.
+  Eigen::Matrix<double, nErrorStates, 1> PHt;
+  PHt.setZero();
+  for (int i = 0; i < H.size; ++i) {
+    PHt += P.col(H.indices[i]) * H.values[i];
+  }
+  double S = R;
+  for (int i = 0; i < H.size; ++i) {
+    S += H.values[i] * PHt(H.indices[i]);
+  }
+  if (!(S > 0)) {
+    MSF_ERROR_STREAM("Innovation covariance of scalar measurement is " << S
+                     << ", discarding the measurement.");
+    return;
+  }
+
+  /// Correction from EKF update.
+  Eigen::Matrix<double, nErrorStates, 1> correction_;
+  correction_ = PHt * (residual / S);
+
+  // With the optimal gain K = P * H' / S the Joseph form reduces to
+  // P - K * S * K'. Writing it as u * u' keeps P symmetric without the
+  // extra pass over the matrix.
+  const Eigen::Matrix<double, nErrorStates, 1> u = PHt / std::sqrt(S);
+  if (!core.square_root_covariance_.IsEnabled() ||
+      !core.square_root_covariance_.Downdate(u, P)) {
+    P.noalias() -= u * u.transpose();
+  }
 
   core.ApplyCorrection(state, correction_);
 }
@@ -108,59 +160,49 @@ void MSF_MeasurementBase<EKFState_T>::CalculateAndApplyCorrectionRelative(
   Eigen::Matrix<double, MSF_Core<EKFState_T>::nErrorStatesAtCompileTime, 1> correction_;
 
   enum {
-    Pdim = MSF_Core<EKFState_T>::nErrorStatesAtCompileTime
+    Pdim = MSF_Core<EKFState_T>::nErrorStatesAtCompileTime,
+    nMeas = R_type::RowsAtCompileTime
   };
 
   // Get the accumulated system dynamics.
-  Eigen::Matrix<double, Pdim, Pdim> F_accum;
+  typename MSF_Core<EKFState_T>::ErrorStateCov & F_accum =
+      core.workspace_.F_accum;
   core.GetAccumulatedStateTransitionStochasticCloning(state_old, state_new, F_accum);
 
-  /*[
+  /*
    *        | P_kk       P_kk * F' |
-   * P_SC = |                      |
+   * P_SC = |                      |,  H_SC = [H_kk  H_mk]
    *        | F * P_kk   P_mk      |
+   *
+   * Only the lower half of K_SC = P_SC * H_SC' * S_SC^-1 is needed, so the
+   * 2N x 2N matrix P_SC is never built.
    */
-  Eigen::Matrix<double, 2 * Pdim, 2 * Pdim> P_SC;
-  P_SC.template block<Pdim, Pdim>(0, 0) = state_old->P;
   // According to TRO paper, ICRA paper has a mistake here.
-  P_SC.template block<Pdim, Pdim>(0, Pdim) = state_old->P * F_accum.transpose();
-  P_SC.template block<Pdim, Pdim>(Pdim, 0) = F_accum * state_old->P;
-  P_SC.template block<Pdim, Pdim>(Pdim, Pdim) = state_new->P;
+  typename MSF_Core<EKFState_T>::ErrorStateCov & FP = core.workspace_.tmp;
+  FP.noalias() = F_accum * state_old->P;
 
-  /*
-   * H_SC = [H_kk  H_mk]
-   */
-  Eigen::Matrix<double, H_type::RowsAtCompileTime, H_type::ColsAtCompileTime * 2> H_SC;
-
-  H_SC.template block<H_type::RowsAtCompileTime, H_type::ColsAtCompileTime>(0,
-                                                                            0) =
-      H_old;
-  H_SC.template block<H_type::RowsAtCompileTime, H_type::ColsAtCompileTime>(
-      0, H_type::ColsAtCompileTime) = H_new;
+  // Upper and lower block rows of P_SC * H_SC'.
+  Eigen::Matrix<double, Pdim, nMeas> PHt_old, PHt_new;
+  PHt_old.noalias() = state_old->P * H_old.transpose();
+  PHt_old.noalias() += FP.transpose() * H_new.transpose();
+  PHt_new.noalias() = FP * H_old.transpose();
+  PHt_new.noalias() += state_new->P * H_new.transpose();
 
   R_type S_SC;
-  S_SC = H_SC * P_SC * H_SC.transpose() + R;
-
-  //TODO (slynen): Only compute the part of K_SC that we need.
-  Eigen::Matrix<double, MSF_Core<EKFState_T>::nErrorStatesAtCompileTime * 2,
-      R_type::RowsAtCompileTime> K_SC;
-  K_SC = P_SC * H_SC.transpose() * S_SC.inverse();
+  S_SC = H_old * PHt_old + H_new * PHt_new + R;
 
-  Eigen::Matrix<double, MSF_Core<EKFState_T>::nErrorStatesAtCompileTime,
-      R_type::RowsAtCompileTime> K;
-  K = K_SC
-      .template block<MSF_Core<EKFState_T>::nErrorStatesAtCompileTime,
-          R_type::RowsAtCompileTime>(
-      MSF_Core<EKFState_T>::nErrorStatesAtCompileTime, 0);
+  Eigen::Matrix<double, Pdim, nMeas> K;
+  K = PHt_new * S_SC.inverse();
+  core.numeric_health_.CheckKernel(K);
 
   correction_ = K * res;
 
   typename MSF_Core<EKFState_T>::ErrorStateCov & P = state_new->P;
-  P = P - K * S_SC * K.transpose();
-
-  // Make sure P stays symmetric.
-  // TODO (slynen): EV, set Evalues<eps to zero, then reconstruct.
-  state_new->P = 0.5 * (state_new->P + state_new->P.transpose());
+  if (!core.square_root_covariance_.IsEnabled() ||
+      !core.square_root_covariance_.Downdate(K * S_SC.llt().matrixL(), P)) {
+    // TODO (slynen): EV, set Evalues<eps to zero, then reconstruct.
+    core.covariance_kernels_.SubtractOuterProduct(K, S_SC, P);
+  }
 
   core.ApplyCorrection(state_new, correction_);
 }
@@ -23,6 +23,7 @@
 #include <Eigen/Dense>
 #include <Eigen/Geometry>
 #include <glog/logging.h>
+#include <algorithm>
 #include <vector>
 #include <msf_core/eigen_conversions.h>
 #include <nav_msgs/Odometry.h>
@@ -36,10 +37,11 @@ namespace msf_core {
 // Returns the stateVar at position INDEX in the state list, non const version
 // only for msf_core use you must not make these functions public. Instead
 // const_cast the state object to const to use the overload.
-template<typename stateVector_T, typename StateDefinition_T>
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
 template<int INDEX>
 inline typename boost::fusion::result_of::at_c<stateVector_T, INDEX>::type
-GenericState_T<stateVector_T, StateDefinition_T>::GetStateVariable() {
+GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::GetStateVariable() {
 
   static_assert(
       (msf_tmp::IsReferenceType<typename
@@ -52,11 +54,12 @@ GenericState_T<stateVector_T, StateDefinition_T>::GetStateVariable() {
 // Returns the state at position INDEX in the state list, non const version
 // you must not make these functions public. Instead const_cast the state object
 // to const to use the overload.
-template<typename stateVector_T, typename StateDefinition_T>
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
 template<int INDEX>
 inline typename msf_tmp::StripReference<
-    typename boost::fusion::result_of::at_c<stateVector_T, INDEX>::type>::result_t::value_t&
-GenericState_T<stateVector_T, StateDefinition_T>::Get() {
+    typename boost::fusion::result_of::at_c<stateVector_T, INDEX>::type>::result_t::Map_T&
+GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::Get() {
   static_assert(
       (msf_tmp::IsReferenceType<typename
           boost::fusion::result_of::at_c<stateVector_T, INDEX >::type>::value),
@@ -66,8 +69,9 @@ GenericState_T<stateVector_T, StateDefinition_T>::Get() {
 }
 
 // Apply the correction vector to all state vars.
-template<typename stateVector_T, typename StateDefinition_T>
-inline void GenericState_T<stateVector_T, StateDefinition_T>::Correct(
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
+inline void GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::Correct(
     const Eigen::Matrix<double, nErrorStatesAtCompileTime, 1>& correction) {
   boost::fusion::for_each(
       statevars,
@@ -76,13 +80,40 @@ inline void GenericState_T<stateVector_T, StateDefinition_T>::Correct(
           stateVector_T>(correction));
 }
 
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
+inline void GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::CopyNominalState(
+    const GenericState_T& other) {
+  // The values are copied in one go, the state vars keep pointing to nominal_.
+  nominal_ = other.nominal_;
+  boost::fusion::for_each(
+      statevars,
+      msf_tmp::CopyStateAttributes<GenericState_T>(other));
+  std::copy(other.rotation_cache_,
+            other.rotation_cache_ + nRotationCacheSlotsAtCompileTime,
+            rotation_cache_);
+  w_m = other.w_m;
+  a_m = other.a_m;
+  noise_gyr = other.noise_gyr;
+  noise_acc = other.noise_acc;
+  time = other.time;
+}
+
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
+inline void GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::BindStateVariables() {
+  boost::fusion::for_each(
+      statevars, msf_tmp::BindStateStorage<stateVector_T>(nominal_.data()));
+}
+
 // Returns the Q-block of the state at position INDEX in the state list, not
 // allowed for core states.
-template<typename stateVector_T, typename StateDefinition_T>
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
 template<int INDEX>
 inline typename msf_tmp::StripReference<
     typename boost::fusion::result_of::at_c<stateVector_T, INDEX>::type>::result_t::Q_T&
-GenericState_T<stateVector_T, StateDefinition_T>::GetQBlock() {
+GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::GetQBlock() {
   typedef typename msf_tmp::StripReference<
       typename boost::fusion::result_of::at_c<stateVector_T, INDEX>::type>::result_t StateVar_T;
 
@@ -100,18 +131,20 @@ GenericState_T<stateVector_T, StateDefinition_T>::GetQBlock() {
 
 // Returns the Q-block of the state at position INDEX in the state list, also
 // possible for core states, since const.
-template<typename stateVector_T, typename StateDefinition_T>
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
 template<int INDEX>
 inline const typename msf_tmp::StripReference<
     typename boost::fusion::result_of::at_c<stateVector_T, INDEX>::type>::result_t::Q_T&
-GenericState_T<stateVector_T, StateDefinition_T>::GetQBlock() const {
+GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::GetQBlock() const {
   return boost::fusion::at < boost::mpl::int_<INDEX> > (statevars).Q_;
 }
 
 /// Assembles a PoseWithCovarianceStamped message from the state
 /** it does not set the header */
-template<typename stateVector_T, typename StateDefinition_T>
-void GenericState_T<stateVector_T, StateDefinition_T>::ToPoseMsg(
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
+void GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::ToPoseMsg(
     geometry_msgs::PoseWithCovarianceStamped & pose) {
   eigen_conversions::Vector3dToPoint(Get<StateDefinition_T::p>(),
                                      pose.pose.pose.position);
@@ -123,8 +156,9 @@ void GenericState_T<stateVector_T, StateDefinition_T>::ToPoseMsg(
 
 /// Assembles an Odometry message from the state.
 /** it does not set the header */
-template<typename stateVector_T, typename StateDefinition_T>
-void GenericState_T<stateVector_T, StateDefinition_T>::ToOdometryMsg(
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
+void GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::ToOdometryMsg(
     nav_msgs::Odometry& odometry) {
   eigen_conversions::Vector3dToPoint(Get<StateDefinition_T::p>(),
                                      odometry.pose.pose.position);
@@ -149,8 +183,9 @@ void GenericState_T<stateVector_T, StateDefinition_T>::ToOdometryMsg(
 
 /// Assembles an ExtState message from the state
 /** it does not set the header */
-template<typename stateVector_T, typename StateDefinition_T>
-void GenericState_T<stateVector_T, StateDefinition_T>::ToExtStateMsg(
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
+void GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::ToExtStateMsg(
     sensor_fusion_comm::ExtState & state) {
   eigen_conversions::Vector3dToPoint(Get<StateDefinition_T::p>(),
                                      state.pose.position);
@@ -162,8 +197,9 @@ void GenericState_T<stateVector_T, StateDefinition_T>::ToExtStateMsg(
 
 /// Assembles a DoubleArrayStamped message from the state
 /** it does not set the header */
-template<typename stateVector_T, typename StateDefinition_T>
-void GenericState_T<stateVector_T, StateDefinition_T>::ToFullStateMsg(
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
+void GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::ToFullStateMsg(
     sensor_fusion_comm::DoubleArrayStamped & state) {
   state.data.resize(nStatesAtCompileTime);  // Make sure this is correctly sized.
   boost::fusion::for_each(
@@ -174,8 +210,9 @@ void GenericState_T<stateVector_T, StateDefinition_T>::ToFullStateMsg(
 
 /// Assembles a DoubleArrayStamped message from the state
 /** it does not set the header */
-template<typename stateVector_T, typename StateDefinition_T>
-void GenericState_T<stateVector_T, StateDefinition_T>::ToCoreStateMsg(
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
+void GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::ToCoreStateMsg(
     sensor_fusion_comm::DoubleArrayStamped & state) {
   state.data.resize(nCoreStatesAtCompileTime);  // Make sure this is correctly sized.
   boost::fusion::for_each(
@@ -184,27 +221,29 @@ void GenericState_T<stateVector_T, StateDefinition_T>::ToCoreStateMsg(
           state.data));
 }
 
-template<typename stateVector_T, typename StateDefinition_T>
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
 Eigen::Matrix<double,
     GenericState_T<stateVector_T,
-                   StateDefinition_T>::nCoreStatesAtCompileTime,1>
-GenericState_T<stateVector_T, StateDefinition_T>::ToEigenVector() {
+                   StateDefinition_T, CovarianceStorage>::nCoreStatesAtCompileTime,1>
+GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::ToEigenVector() {
   Eigen::Matrix<double,
-      GenericState_T<stateVector_T, StateDefinition_T>::nCoreStatesAtCompileTime,
+      GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::nCoreStatesAtCompileTime,
       1> data;
   boost::fusion::for_each(
       statevars,
       msf_tmp::CoreStatetoDoubleArray<
           typename Eigen::Matrix<double,
               GenericState_T<stateVector_T,
-                             StateDefinition_T>::nCoreStatesAtCompileTime, 1>,
+                             StateDefinition_T, CovarianceStorage>::nCoreStatesAtCompileTime, 1>,
                              stateVector_T>(data));
   return data;
 }
 
 //TODO (slynen) Template to container.
-template<typename stateVector_T, typename StateDefinition_T>
-void GenericState_T<stateVector_T, StateDefinition_T>::CalculateIndicesInErrorState(
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
+void GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::CalculateIndicesInErrorState(
     std::vector<std::tuple<int, int, int> >& vec) {
   boost::fusion::for_each(
       statevars,
@@ -212,8 +251,9 @@ void GenericState_T<stateVector_T, StateDefinition_T>::CalculateIndicesInErrorSt
           stateVector_T>(vec));
 }
 
-template<typename stateVector_T, typename StateDefinition_T>
-std::string GenericState_T<stateVector_T, StateDefinition_T>::Print() {
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
+std::string GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::Print() {
   std::stringstream ss;
   ss << "--------- State at time " << msf_core::timehuman(time)
       << "s: ---------" << std::endl;
@@ -224,27 +264,29 @@ std::string GenericState_T<stateVector_T, StateDefinition_T>::Print() {
   return ss.str();
 }
 
-template<typename stateVector_T, typename StateDefinition_T>
-bool GenericState_T<stateVector_T, StateDefinition_T>::CheckStateForNumeric() {
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
+bool GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::CheckStateForNumeric() {
   Eigen::Matrix<double,
       GenericState_T<stateVector_T,
-                     StateDefinition_T>::nCoreStatesAtCompileTime, 1> data;
+                     StateDefinition_T, CovarianceStorage>::nCoreStatesAtCompileTime, 1> data;
   boost::fusion::for_each(
       statevars,
       msf_tmp::CoreStatetoDoubleArray<
           typename Eigen::Matrix<double,
-              GenericState_T<stateVector_T, StateDefinition_T>::nCoreStatesAtCompileTime,
+              GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::nCoreStatesAtCompileTime,
               1>, stateVector_T>(data));
 
   return CheckForNumeric(data, "CheckStateForNumeric");
 }
 
 // Returns the state at position INDEX in the state list, const version.
-template<typename stateVector_T, typename StateDefinition_T>
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
 template<int INDEX>
 inline const typename msf_tmp::StripReference<
-    typename boost::fusion::result_of::at_c<stateVector_T, INDEX>::type>::result_t::value_t&
-GenericState_T<stateVector_T, StateDefinition_T>::Get() const {
+    typename boost::fusion::result_of::at_c<stateVector_T, INDEX>::type>::result_t::Map_T&
+GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::Get() const {
   static_assert(
       (msf_tmp::IsReferenceType<typename boost::fusion::result_of::at_c<stateVector_T, INDEX >::type>::value),
       "Assumed that boost::fusion would return a reference type here, which is "
@@ -253,11 +295,37 @@ GenericState_T<stateVector_T, StateDefinition_T>::Get() const {
   return boost::fusion::at < boost::mpl::int_<INDEX> > (statevars).state_;
 }
 
-template<typename stateVector_T, typename StateDefinition_T>
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
+template<int INDEX>
+inline const Eigen::Matrix3d&
+GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::GetRotationMatrix() const {
+  typedef typename msf_tmp::GetEnumStateType<stateVector_T, INDEX>::value
+      state_type;
+  static_assert(
+      msf_tmp::IsQuaternionType<
+          typename msf_tmp::StripConstReference<state_type>::result_t>::value,
+      "Rotation matrices are only available for quaternion states");
+  enum {
+    slot = msf_tmp::GetStartIndex<stateVector_T, state_type,
+        msf_tmp::RotationCacheSlotsForType>::value
+  };
+
+  const Eigen::Map<Eigen::Quaterniond>& q = Get<INDEX>();
+  RotationCacheEntry& entry = rotation_cache_[slot];
+  if (!(entry.q.array() == q.coeffs().array()).all()) {
+    entry.C = q.toRotationMatrix();
+    entry.q = q.coeffs();
+  }
+  return entry.C;
+}
+
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
 template<int INDEX>
 inline typename msf_tmp::AddConstReference<
     typename boost::fusion::result_of::at_c<stateVector_T, INDEX>::type>::result_t
-    GenericState_T<stateVector_T, StateDefinition_T>::GetStateVariable() const {
+    GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::GetStateVariable() const {
   static_assert(
       (msf_tmp::IsReferenceType<typename boost::fusion::result_of::at_c<stateVector_T, INDEX >::type>::value),
       "Assumed that boost::fusion would return a reference type here, which is "
@@ -265,9 +333,10 @@ inline typename msf_tmp::AddConstReference<
   return boost::fusion::at < boost::mpl::int_<INDEX> > (statevars);
 }
 
-template<typename stateVector_T, typename StateDefinition_T>
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
 template<int INDEX>
-inline void GenericState_T<stateVector_T, StateDefinition_T>::Set(
+inline void GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::Set(
     const typename msf_tmp::StripConstReference<
         typename boost::fusion::result_of::at_c
             <stateVector_T, INDEX>::type>::result_t::value_t& newvalue) {
@@ -285,9 +354,10 @@ inline void GenericState_T<stateVector_T, StateDefinition_T>::Set(
   boost::fusion::at < boost::mpl::int_<INDEX> > (statevars).state_ = newvalue;
 }
 
-template<typename stateVector_T, typename StateDefinition_T>
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
 template<int INDEX>
-inline void GenericState_T<stateVector_T, StateDefinition_T>::ClearCrossCov() {
+inline void GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::ClearCrossCov() {
   typedef typename msf_tmp::StripReference<
       typename boost::fusion::result_of::at_c<stateVector_T, INDEX>::type>::result_t StateVar_T;
 
@@ -316,9 +386,10 @@ inline void GenericState_T<stateVector_T, StateDefinition_T>::ClearCrossCov() {
  * 3D vectors: 0; quaternion: unit quaternion; scale: 1; time:0;
  * Error covariance: zeros
  */
-template<typename stateVector_T, typename StateDefinition_T>
-void GenericState_T<stateVector_T, StateDefinition_T>::Reset(
-    msf_core::StateVisitor<GenericState_T<stateVector_T, StateDefinition_T> >* statevisitor) {
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
+void GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::Reset(
+    msf_core::StateVisitor<GenericState_T>* statevisitor) {
 
   // Reset all states.
   boost::fusion::for_each(statevars, msf_tmp::ResetState());
@@ -336,8 +407,9 @@ void GenericState_T<stateVector_T, StateDefinition_T>::Reset(
 }
 
 /// Writes the covariance corresponding to position and attitude to cov.
-template<typename stateVector_T, typename StateDefinition_T>
-void GenericState_T<stateVector_T, StateDefinition_T>::GetPoseCovariance(
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
+void GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::GetPoseCovariance(
     geometry_msgs::PoseWithCovariance::_covariance_type& cov) {
 
   typedef typename msf_tmp::GetEnumStateType<stateVector_T, StateDefinition_T::p>::value p_type;
@@ -366,8 +438,9 @@ void GenericState_T<stateVector_T, StateDefinition_T>::GetPoseCovariance(
 }
 
 /// Writes the covariance corresponding to velocity and attitude to cov.
-template<typename stateVector_T, typename StateDefinition_T>
-void GenericState_T<stateVector_T, StateDefinition_T>::GetVelocityAttitudeCovariance(
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
+void GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::GetVelocityAttitudeCovariance(
     Eigen::Matrix<double, 6, 6>& cov) {
 
   typedef typename msf_tmp::GetEnumStateType<stateVector_T, StateDefinition_T::v>::value v_type;
@@ -394,8 +467,9 @@ void GenericState_T<stateVector_T, StateDefinition_T>::GetVelocityAttitudeCovari
 
 /// Writes the covariance corresponding to velocity and angular velocity expressed in the IMU frame
 // to cov.
-template<typename stateVector_T, typename StateDefinition_T>
-void GenericState_T<stateVector_T, StateDefinition_T>::GetTwistCovarianceInImuFrame(
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
+void GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::GetTwistCovarianceInImuFrame(
     geometry_msgs::TwistWithCovariance::_covariance_type& cov) {
   typedef typename msf_tmp::GetEnumStateType<stateVector_T, StateDefinition_T::b_w>::value b_w_type;
 
@@ -403,8 +477,8 @@ void GenericState_T<stateVector_T, StateDefinition_T>::GetTwistCovarianceInImuFr
   static const int idxstartcorr_b_w = msf_tmp::GetStartIndex<stateVector_T,
       b_w_type, msf_tmp::CorrectionStateLengthForType>::value;
 
-  const msf_core::Quaternion& q_W_I = Get<StateDefinition_T::q>();
-  const msf_core::Matrix3 R_W_I = q_W_I.toRotationMatrix();
+  const msf_core::Matrix3& R_W_I =
+      GetRotationMatrix<StateDefinition_T::q>();
   const msf_core::Vector3& v_W =  Get<StateDefinition_T::v>();
   const msf_core::Vector3 v_I =  R_W_I.transpose() * v_W;
 
@@ -434,8 +508,9 @@ void GenericState_T<stateVector_T, StateDefinition_T>::GetTwistCovarianceInImuFr
                                    cov_noise_gyr;
 }
 
-template<typename stateVector_T, typename StateDefinition_T>
-void GenericState_T<stateVector_T, StateDefinition_T>::GetCoreCovariance(
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
+void GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::GetCoreCovariance(
     sensor_fusion_comm::DoubleMatrixStamped& cov) {
 
   const int n_core = nCoreErrorStatesAtCompileTime;
@@ -450,8 +525,9 @@ void GenericState_T<stateVector_T, StateDefinition_T>::GetCoreCovariance(
   }
 }
 
-template<typename stateVector_T, typename StateDefinition_T>
-void GenericState_T<stateVector_T, StateDefinition_T>::GetAuxCovariance(
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
+void GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::GetAuxCovariance(
     sensor_fusion_comm::DoubleMatrixStamped& cov) {
 
   const int n_core = nCoreErrorStatesAtCompileTime;
@@ -469,8 +545,9 @@ void GenericState_T<stateVector_T, StateDefinition_T>::GetAuxCovariance(
   }
 }
 
-template<typename stateVector_T, typename StateDefinition_T>
-void GenericState_T<stateVector_T, StateDefinition_T>::GetCoreAuxCovariance(
+template<typename stateVector_T, typename StateDefinition_T,
+    int CovarianceStorage>
+void GenericState_T<stateVector_T, StateDefinition_T, CovarianceStorage>::GetCoreAuxCovariance(
     sensor_fusion_comm::DoubleMatrixStamped& cov) {
 
   const int n_core = nCoreErrorStatesAtCompileTime;
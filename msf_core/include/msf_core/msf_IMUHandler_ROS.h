@@ -39,11 +39,15 @@ class IMUHandler_ROS : public IMUHandler<EKFState_T> {
                            this);
     subState_ = nh.subscribe("hl_state_input", 10,
                              &IMUHandler_ROS::StateCallback, this);
+    this->SetIngestionQueueSize(100);
   }
 
   virtual ~IMUHandler_ROS() { }
 
   void StateCallback(const sensor_fusion_comm::ExtEkfConstPtr & msg) {
+    this->SequenceWatchDog(msg->header.seq, subState_.getTopic(),
+                           msg->header.stamp.toSec(),
+                           ros::Time::now().toSec());
     static_cast<MSF_SensorManagerROS<EKFState_T>&>(this->manager_)
         .SetHLControllerStateBuffer(*msg);
 
@@ -90,14 +94,9 @@ class IMUHandler_ROS : public IMUHandler<EKFState_T> {
   }
 
   void IMUCallback(const sensor_msgs::ImuConstPtr & msg) {
-    static int lastseq = constants::INVALID_SEQUENCE;
-    if (static_cast<int>(msg->header.seq) != lastseq + 1
-        && lastseq != constants::INVALID_SEQUENCE) {
-      MSF_WARN_STREAM(
-          "msf_core: imu message drop curr seq:" << msg->header.seq
-              << " expected: " << lastseq + 1);
-    }
-    lastseq = msg->header.seq;
+    this->SequenceWatchDog(msg->header.seq, subImu_.getTopic(),
+                           msg->header.stamp.toSec(),
+                           ros::Time::now().toSec());
 
     msf_core::Vector3 linacc;
     linacc << msg->linear_acceleration.x, msg->linear_acceleration.y, msg
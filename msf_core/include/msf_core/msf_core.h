@@ -33,11 +33,15 @@ http://google-styleguide.googlecode.com/svn/trunk/cppguide.xml
 #ifndef MSF_CORE_H_
 #define MSF_CORE_H_
 
+#include <map>
 #include <vector>
-#include <queue>
 
 #include <Eigen/Eigen>
 
+#include <msf_core/msf_covariance_kernels.h>
+#include <msf_core/msf_numerichealth.h>
+#include <msf_core/msf_smoother.h>
+#include <msf_core/msf_squarerootcovariance.h>
 #include <msf_core/msf_sortedContainer.h>
 #include <msf_core/msf_state.h>
 #include <msf_core/msf_checkFuzzyTracking.h>
@@ -66,7 +70,9 @@ class MSF_Core {
     /// Error state length.
     nErrorStatesAtCompileTime = EKFState_T::nErrorStatesAtCompileTime,
     /// Complete state length.
-    nStatesAtCompileTime = EKFState_T::nStatesAtCompileTime
+    nStatesAtCompileTime = EKFState_T::nStatesAtCompileTime,
+    /// Compile time size of P, Eigen::Dynamic for dynamic size storage.
+    nCovarianceDimAtCompileTime = EKFState_T::nCovarianceDimAtCompileTime
   };
 
   typedef typename EKFState_T::StateDefinition_T StateDefinition_T;
@@ -74,8 +80,24 @@ class MSF_Core {
   /// The error state type.
   typedef Eigen::Matrix<double, nErrorStatesAtCompileTime, 1> ErrorState;
   /// The error state covariance type.
-  typedef Eigen::Matrix<double, nErrorStatesAtCompileTime,
-      nErrorStatesAtCompileTime> ErrorStateCov;
+  typedef typename EKFState_T::P_type ErrorStateCov;
+
+  /**
+   * Levels of reduced processing the core steps through when it can not keep
+   * up with the incoming data. Each level includes the ones before.
+   */
+  enum DegradationLevel {
+    DEGRADATION_NONE = 0,
+    /// Do not publish the covariance matrices.
+    DEGRADATION_SKIP_COVARIANCE_PUBLISHING,
+    /// Propagate the covariance over several states in one step.
+    DEGRADATION_REDUCE_COVARIANCE_PROPAGATION,
+    /// Drop part of the measurements of low priority sensors.
+    DEGRADATION_DECIMATE_LOW_PRIORITY_SENSORS,
+    /// Thin out the states when repropagating after an update.
+    DEGRADATION_COARSE_REPROPAGATION,
+    DEGRADATION_MAX = DEGRADATION_COARSE_REPROPAGATION
+  };
 
   /// The type of the state buffer containing all the states.
   typedef msf_core::SortedContainer<EKFState_T> StateBuffer_T;
@@ -102,16 +124,19 @@ class MSF_Core {
   /**
    * \brief Finds the closest state to the requested time in the internal state.
    * \param tstamp The time stamp to find the closest state to.
+   * \param virtual_state If a state has to be interpolated, it is not inserted
+   * into the buffer and the correction applied to it is mapped back onto the
+   * state before it, see SetVirtualMeasurementStates.
    */
-  shared_ptr<EKFState_T> GetClosestState(double tstamp);
+  shared_ptr<EKFState_T> GetClosestState(double tstamp,
+                                         bool virtual_state = false);
 
   /**
    * \brief Returns the accumulated dynamic matrix between two states.
    */
   void GetAccumulatedStateTransitionStochasticCloning(
       const shared_ptr<EKFState_T>& state_old,
-      const shared_ptr<EKFState_T>& state_new,
-      Eigen::Matrix<double, nErrorStatesAtCompileTime, nErrorStatesAtCompileTime>& F);
+      const shared_ptr<EKFState_T>& state_new, ErrorStateCov& F);
   /**
    * \brief Returns previous measurement of the same type.
    */
@@ -150,9 +175,7 @@ class MSF_Core {
    * \brief sets the covariance matrix of the core states to simulated values.
    * \param P the error state covariance Matrix to fill.
    */
-  void SetPCore(
-      Eigen::Matrix<double, EKFState_T::nErrorStatesAtCompileTime,
-          EKFState_T::nErrorStatesAtCompileTime>& P);
+  void SetPCore(ErrorStateCov& P);
 
   /**
    * \brief Ctor takes a pointer to an object which does the user defined
@@ -165,6 +188,62 @@ class MSF_Core {
 
   const MSF_SensorManager<EKFState_T>& GetUserCalc() const;
 
+  /// The current level of reduced processing.
+  DegradationLevel GetDegradationLevel() const {
+    return degradation_level_;
+  }
+
+  /// The time [s] the processing lags behind the incoming IMU data.
+  double GetProcessingLag() const {
+    return processing_lag_;
+  }
+
+  /**
+   * \brief Marks the measurements of a sensor as low priority, these are
+   * decimated first when the core can not keep up.
+   */
+  void SetSensorLowPriority(int sensorID, bool low_priority);
+
+  /// Number of measurements of a sensor the core did not apply.
+  size_t GetRejectedMeasurements(int sensorID) const;
+
+  /// Counters of the checks for non-finite covariances.
+  const NumericHealth& GetNumericHealth() const {
+    return numeric_health_;
+  }
+
+  /**
+   * \brief Sets the number of threads for the covariance products and the
+   * error state dimension from which on they are used.
+   * \param num_threads Threads including the filter thread, <= 0 uses all
+   * cores.
+   */
+  void SetCovarianceThreads(int num_threads, int min_dimension);
+
+  /**
+   * \brief Enables the fixed-lag smoother, which publishes the states smoothed
+   * over the given lag [s] through the sensor manager. Zero disables it.
+   */
+  void SetSmootherLag(double lag);
+
+  /// Waits until the smoother has published the states handed to it.
+  void FlushSmoother();
+
+  /**
+   * \brief Propagates and updates the covariance through its Cholesky factor,
+   * which keeps it positive semi-definite on long runs at a higher cost.
+   * \param single_precision Keeps the factor in float, P stays in double.
+   */
+  void SetSquareRootCovariance(bool enabled, bool single_precision = false);
+
+  /**
+   * \brief Applies absolute measurements which fall between two states on a
+   * temporary state at the measurement time instead of inserting a state into
+   * the buffer. The update is mapped back onto the state before the
+   * measurement, so the buffer keeps the states of the IMU readings.
+   */
+  void SetVirtualMeasurementStates(bool enabled);
+
  private:
   /**
    * \brief Get the index of the best state having no temporal drift at compile
@@ -184,8 +263,10 @@ class MSF_Core {
   StateBuffer_T stateBuffer_;
   /// EKF Measurements and init values sorted by t asc.
   measurementBufferT MeasurementBuffer_;
-  /// Buffer for measurements to apply in future.
-  std::queue<shared_ptr<MSF_MeasurementBase<EKFState_T> > > queueFutureMeasurements_;
+  /// Measurements newer than the latest state, sorted by time.
+  typedef std::multimap<double, shared_ptr<MSF_MeasurementBase<EKFState_T> > >
+      PendingMeasurements_T;
+  PendingMeasurements_T pendingMeasurements_;
   /// Last time stamp where we have a valid propagation.
   double time_P_propagated;
   /// Last time stamp where we have a valid state.
@@ -203,6 +284,65 @@ class MSF_Core {
   /// A class which provides methods for customization of several calculations.
   const MSF_SensorManager<EKFState_T>& usercalc_;
 
+  /**
+   * Matrices of the size of P for the updates and the covariance propagation.
+   * Sized once in the ctor, so dynamic size states do not allocate per step.
+   */
+  struct CovarianceWorkspace {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    ErrorStateCov KH;  ///< I - K * H of the update.
+    ErrorStateCov F_accum;  ///< Transition between two states.
+    ErrorStateCov tmp;  ///< Intermediate product.
+    ErrorStateCov P_virtual;  ///< Prior covariance of the virtual state.
+  };
+  CovarianceWorkspace workspace_;
+  /// The state before the last correction, for the sanity and fuzzy checks.
+  EKFState_T correction_backup_;
+  /// Multi-threaded products for the covariance of large states.
+  CovarianceKernels covariance_kernels_;
+  /// Square-root form of the covariance propagation and updates.
+  SquareRootCovariance<ErrorStateCov> square_root_covariance_;
+
+  enum {
+    /// Number of states the covariance is propagated over in one step when
+    /// degraded.
+    degradedCovarianceStride = 4,
+    /// Only every n-th measurement of a low priority sensor is applied when
+    /// degraded.
+    degradedLowPriorityDecimation = 3,
+    /// Only every n-th state is kept when repropagating to now when degraded.
+    degradedRepropagationStride = 4
+  };
+  DegradationLevel degradation_level_;
+  /// Time the processing lags behind the IMU data, see UpdateProcessingLag.
+  double processing_lag_;
+  /// Wall time minus message time when the core last kept up.
+  double min_time_offset_;
+  /// Wall time the core finished processing the last message.
+  double processing_end_walltime_;
+  double level_changed_walltime_;
+  /// Number of measurements seen from each low priority sensor.
+  std::map<int, size_t> low_priority_sensors_;
+  /// Number of measurements rejected for each sensor.
+  std::map<int, size_t> rejected_measurements_;
+  /// Checks the covariance for non-finite values.
+  NumericHealth numeric_health_;
+
+  /// Measurements between two states are applied on a temporary state.
+  bool virtual_measurement_states_;
+  /// The temporary state of the measurement being applied and the buffered
+  /// state before it, which receives the update.
+  shared_ptr<EKFState_T> virtual_state_;
+  shared_ptr<EKFState_T> virtual_state_origin_;
+
+  /// Smooths the states once their covariance is propagated.
+  FixedLagSmoother<EKFState_T> smoother_;
+  /// Sum of the corrections applied to each state, kept for the smoother.
+  typedef std::map<double, ErrorState, std::less<double>,
+      Eigen::aligned_allocator<std::pair<const double, ErrorState> > >
+      AppliedCorrections_T;
+  AppliedCorrections_T applied_corrections_;
+
   /**
    * \brief Applies the correction.
    * \param delaystate The state to apply the correction on.
@@ -250,8 +390,63 @@ class MSF_Core {
   /// Propagates P by one step to distribute processing load.
   void PropagatePOneStep();
 
-  /// Checks the queue of measurements to be applied in the future.
+  /// Hands the states with a propagated covariance to the smoother.
+  void UpdateSmoother();
+
+  /**
+   * \brief Applies all pending measurements which are covered by the states
+   * now, in time order and with a single repropagation.
+   */
   void HandlePendingMeasurements();
+
+  /**
+   * \brief Inserts a measurement into the buffer unless it is rejected.
+   * \param it_meas Set to the measurement in the buffer.
+   * \returns false if the measurement was rejected.
+   */
+  bool InsertMeasurement(
+      const shared_ptr<MSF_MeasurementBase<EKFState_T> >& measurement,
+      typename measurementBufferT::iterator_T& it_meas);
+
+  /**
+   * \brief Applies the measurements in the buffer from it_meas on, each
+   * followed by the repropagation up to the next one, and publishes the state.
+   */
+  void ApplyMeasurements(typename measurementBufferT::iterator_T it_meas);
+
+  /// Stores the wall time at the end of its scope as end of processing.
+  class ProcessingScope {
+   public:
+    explicit ProcessingScope(double& end_walltime)
+        : end_walltime_(end_walltime) {
+    }
+    ~ProcessingScope() {
+      end_walltime_ = WallTime();
+    }
+   private:
+    double& end_walltime_;
+  };
+
+  /// Monotonic wall time in seconds.
+  static double WallTime();
+
+  /**
+   * \brief Measures the processing lag against wall time for the IMU
+   * message with the given time stamp and raises or lowers the degradation
+   * level accordingly.
+   */
+  void UpdateProcessingLag(double msg_stamp);
+
+  /// Sets a new degradation level and reports the change.
+  void SetDegradationLevel(DegradationLevel level);
+
+  /**
+   * \brief Propagates the covariance from the given state one step towards
+   * the state at time_max. The step spans several states when degraded.
+   * \returns the iterator to the state the covariance was propagated to.
+   */
+  typename StateBuffer_T::iterator_T PropagateCovarianceStep(
+      typename StateBuffer_T::iterator_T it_from, double time_max);
 };
 }
 // msf_core
@@ -0,0 +1,278 @@
+/*
+ * Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <slynen at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MSF_COVARIANCE_KERNELS_H_
+#define MSF_COVARIANCE_KERNELS_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Dense>
+
+namespace msf_core {
+/**
+ * \class CovarianceKernels
+ * \brief The O(N^3) covariance products of the filter, A * P * A' for the
+ * propagation and the Joseph form update and P - K * S * K', split into panels
+ * of rows which a pool of worker threads processes in parallel. Below the size
+ * threshold or with one thread, the products run on the calling thread.
+ *
+ * Only the upper triangle of the result is computed and then mirrored to the
+ * lower one, so the results are exactly symmetric and need no extra pass to
+ * symmetrize them.
+ */
+class CovarianceKernels {
+ public:
+  enum {
+    /// Rows per task, small enough to balance the triangular work.
+    panelRows = 16
+  };
+
+  /// num_threads <= 0 uses all cores.
+  CovarianceKernels(int num_threads = 1, int min_dimension = 60)
+      : min_dimension_(min_dimension),
+        stop_(false),
+        generation_(0),
+        task_(nullptr),
+        num_tasks_(0),
+        next_task_(0),
+        workers_done_(0) {
+    SetNumThreads(num_threads);
+  }
+
+  ~CovarianceKernels() {
+    StopWorkers();
+  }
+
+  /// Restarts the pool, must not be called while a product is running.
+  void SetNumThreads(int num_threads) {
+    StopWorkers();
+    if (num_threads <= 0)
+      num_threads = std::max(1u, std::thread::hardware_concurrency());
+    num_threads_ = num_threads;
+    stop_ = false;
+    // The calling thread takes part in the work.
+    for (int t = 1; t < num_threads_; ++t)
+      workers_.push_back(
+          std::thread(&CovarianceKernels::WorkerLoop, this, generation_));
+  }
+  int GetNumThreads() const {
+    return num_threads_;
+  }
+
+  /// Size of P from which on the products run on multiple threads.
+  void SetMinDimension(int min_dimension) {
+    min_dimension_ = min_dimension;
+  }
+  int GetMinDimension() const {
+    return min_dimension_;
+  }
+
+  bool IsParallel(int dimension) const {
+    return !workers_.empty() && dimension >= min_dimension_;
+  }
+
+  /**
+   * \brief out = A * P * A'. out may be P, tmp must not alias any argument.
+   */
+  template<typename Matrix_T>
+  void Sandwich(const Matrix_T& A, const Matrix_T& P, Matrix_T& tmp,
+                Matrix_T& out) {
+    const int n = P.rows();
+    if (!IsParallel(n)) {
+      tmp.noalias() = A * P;
+      out.template triangularView<Eigen::Upper>() = tmp * A.transpose();
+      MirrorUpperTriangle(out);
+      return;
+    }
+    const int num_panels = (n + panelRows - 1) / panelRows;
+    ParallelFor(num_panels, [&](int panel) {
+      const int row = panel * panelRows;
+      const int rows = std::min(static_cast<int>(panelRows), n - row);
+      tmp.middleRows(row, rows).noalias() = A.middleRows(row, rows) * P;
+    });
+    ParallelFor(num_panels, [&](int panel) {
+      const int row = panel * panelRows;
+      const int rows = std::min(static_cast<int>(panelRows), n - row);
+      out.block(row, row, rows, n - row).noalias() = tmp.middleRows(row, rows)
+          * A.bottomRows(n - row).transpose();
+    });
+    MirrorUpperTriangle(out);
+  }
+
+  /**
+   * \brief The Joseph form update P = KH * P * KH' + K * R * K' with
+   * KH = I - K * H. tmp must not alias any argument.
+   */
+  template<typename Matrix_T, typename K_T, typename R_T>
+  void JosephUpdate(const Matrix_T& KH, const Eigen::MatrixBase<K_T>& K,
+                    const Eigen::MatrixBase<R_T>& R, Matrix_T& tmp,
+                    Matrix_T& P) {
+    const int n = P.rows();
+    const Eigen::Matrix<double, K_T::RowsAtCompileTime, K_T::ColsAtCompileTime>
+        KR = K * R;
+    if (!IsParallel(n)) {
+      tmp.noalias() = KH * P;
+      P.template triangularView<Eigen::Upper>() = tmp * KH.transpose();
+      P.template triangularView<Eigen::Upper>() += KR * K.transpose();
+      MirrorUpperTriangle(P);
+      return;
+    }
+    const int num_panels = (n + panelRows - 1) / panelRows;
+    ParallelFor(num_panels, [&](int panel) {
+      const int row = panel * panelRows;
+      const int rows = std::min(static_cast<int>(panelRows), n - row);
+      tmp.middleRows(row, rows).noalias() = KH.middleRows(row, rows) * P;
+    });
+    ParallelFor(num_panels, [&](int panel) {
+      const int row = panel * panelRows;
+      const int rows = std::min(static_cast<int>(panelRows), n - row);
+      P.block(row, row, rows, n - row).noalias() = tmp.middleRows(row, rows)
+          * KH.bottomRows(n - row).transpose();
+      P.block(row, row, rows, n - row).noalias() += KR.middleRows(row, rows)
+          * K.bottomRows(n - row).transpose();
+    });
+    MirrorUpperTriangle(P);
+  }
+
+  /**
+   * \brief P -= K * S * K'.
+   */
+  template<typename Matrix_T, typename K_T, typename S_T>
+  void SubtractOuterProduct(const Eigen::MatrixBase<K_T>& K,
+                            const Eigen::MatrixBase<S_T>& S, Matrix_T& P) {
+    const int n = P.rows();
+    // This is O(N^2 * M) for M measurements, so the threads only pay off for
+    // a correspondingly larger N.
+    const double work = static_cast<double>(n) * n * K.cols();
+    const double min_work = static_cast<double>(min_dimension_)
+        * min_dimension_ * min_dimension_;
+    const Eigen::Matrix<double, K_T::RowsAtCompileTime, K_T::ColsAtCompileTime>
+        KS = K * S;
+    if (!IsParallel(n) || work < min_work) {
+      P.template triangularView<Eigen::Upper>() -= KS * K.transpose();
+      P.template triangularView<Eigen::StrictlyLower>() = P.transpose();
+      return;
+    }
+    const int num_panels = (n + panelRows - 1) / panelRows;
+    ParallelFor(num_panels, [&](int panel) {
+      const int row = panel * panelRows;
+      const int rows = std::min(static_cast<int>(panelRows), n - row);
+      P.block(row, row, rows, n - row).noalias() -= KS.middleRows(row, rows)
+          * K.bottomRows(n - row).transpose();
+    });
+    MirrorUpperTriangle(P);
+  }
+
+ private:
+  template<typename Matrix_T>
+  void MirrorUpperTriangle(Matrix_T& M) {
+    const int n = M.rows();
+    if (!IsParallel(n)) {
+      M.template triangularView<Eigen::StrictlyLower>() = M.transpose();
+      return;
+    }
+    const int num_panels = (n + panelRows - 1) / panelRows;
+    ParallelFor(num_panels, [&](int panel) {
+      const int row = panel * panelRows;
+      const int rows = std::min(static_cast<int>(panelRows), n - row);
+      M.block(row, 0, rows, row) = M.block(0, row, row, rows).transpose();
+      for (int i = 1; i < rows; ++i)
+        M.block(row + i, row, 1, i) = M.block(row, row + i, i, 1).transpose();
+    });
+  }
+
+  /// Runs task(0) ... task(num_tasks - 1) on the pool and the calling thread.
+  void ParallelFor(int num_tasks, const std::function<void(int)>& task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      task_ = &task;
+      num_tasks_ = num_tasks;
+      next_task_ = 0;
+      workers_done_ = 0;
+      ++generation_;
+    }
+    work_available_.notify_all();
+    RunTasks();
+    std::unique_lock<std::mutex> lock(mutex_);
+    work_done_.wait(lock, [this] {
+      return workers_done_ == static_cast<int>(workers_.size());
+    });
+    task_ = nullptr;
+  }
+
+  void RunTasks() {
+    int task;
+    while ((task = next_task_++) < num_tasks_)
+      (*task_)(task);
+  }
+
+  /// Waits for the products after generation_seen.
+  void WorkerLoop(size_t generation_seen) {
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        work_available_.wait(lock, [&] {
+          return stop_ || generation_ != generation_seen;
+        });
+        if (stop_)
+          return;
+        generation_seen = generation_;
+      }
+      RunTasks();
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++workers_done_;
+      }
+      work_done_.notify_one();
+    }
+  }
+
+  void StopWorkers() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    work_available_.notify_all();
+    for (std::thread& worker : workers_)
+      worker.join();
+    workers_.clear();
+  }
+
+  int num_threads_;
+  int min_dimension_;
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable work_available_;
+  std::condition_variable work_done_;
+  bool stop_;
+  size_t generation_;
+  const std::function<void(int)>* task_;
+  int num_tasks_;
+  std::atomic<int> next_task_;
+  int workers_done_;
+
+  CovarianceKernels(const CovarianceKernels&);
+  CovarianceKernels& operator=(const CovarianceKernels&);
+};
+}  // namespace msf_core
+#endif  // MSF_COVARIANCE_KERNELS_H_
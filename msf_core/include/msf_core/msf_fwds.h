@@ -30,6 +30,12 @@ enum {
   AuxiliaryNonTemporalDrifting
 };
 
+// Storage of the error state covariance and the other matrices of its size.
+enum {
+  FixedSizeCovariance,  ///< Fixed size Eigen types, best for small states.
+  DynamicSizeCovariance  ///< Heap allocated once, for large states.
+};
+
 enum {  //set power 2 flags here
   none = 0x0,
   correctionMultiplicative = 0x1
@@ -42,7 +48,8 @@ template<typename type_T, int name_T, int STATETYPE = Auxiliary, int OPTIONS =
     none> struct StateVar_T;
 
 // The state object.
-template<typename StateVector_T, typename StateDefinition_T>
+template<typename StateVector_T, typename StateDefinition_T,
+    int CovarianceStorage = FixedSizeCovariance>
 struct GenericState_T;
 
 template<typename EKFState_T> class MSF_Core;
@@ -74,7 +81,8 @@ template<typename Sequence, typename StateVarT,
 struct ResetState;
 
 template<typename stateT> struct CopyNonPropagationStates;
-template<typename stateList_T> struct CopyQBlocksFromAuxiliaryStatesToQ;
+template<typename stateList_T, typename Q_T>
+struct CopyQBlocksFromAuxiliaryStatesToQ;
 template<typename T, typename stateList_T> struct CorrectState;
 template<typename T, typename stateList_T> struct StatetoDoubleArray;
 
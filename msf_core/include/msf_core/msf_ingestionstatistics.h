@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <slynen at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MSF_INGESTIONSTATISTICS_H_
+#define MSF_INGESTIONSTATISTICS_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <ostream>
+
+namespace msf_core {
+/**
+ * \class IngestionStatistics
+ * \brief Rolling statistics of the messages arriving from a sensor: arrival
+ * rate, inter-arrival jitter, lag of the arrival behind the header stamp and
+ * sequence gaps. The averages are exponential over roughly the last
+ * 1 / smoothing messages, so a starving or bursty sensor shows up quickly.
+ */
+class IngestionStatistics {
+ public:
+  /// queue_size is the subscriber queue length, zero if unknown.
+  IngestionStatistics(size_t queue_size = 0, double smoothing = 0.05)
+      : queue_size_(queue_size),
+        smoothing_(smoothing) {
+    Reset();
+  }
+
+  /// Used to tell drops in the subscriber queue from drops on the transport.
+  void SetQueueSize(size_t queue_size) {
+    queue_size_ = queue_size;
+  }
+
+  /**
+   * \brief Adds a message with the given sequence number and header stamp
+   * which arrived at arrival_time, both in seconds of the same clock.
+   * \returns the number of messages missing before this one.
+   */
+  size_t Add(size_t seq, double stamp, double arrival_time) {
+    ++received_;
+    size_t missing = 0;
+    // A sequence number from the past (e.g. a restarted bag or driver)
+    // restarts the statistics of the intervals. Publishers which do not count
+    // the sequence send the same number every time.
+    if (received_ > 1 && seq >= last_seq_ && arrival_time >= last_arrival_) {
+      missing = seq > last_seq_ ? seq - last_seq_ - 1 : 0;
+      const double dt_arrival = arrival_time - last_arrival_;
+      const double dt_stamp = stamp - last_stamp_;
+      if (intervals_ == 0) {
+        mean_period_ = dt_arrival;
+        mean_stamp_period_ = dt_stamp / (missing + 1);
+      } else {
+        jitter_ += smoothing_ * (std::fabs(dt_arrival - mean_period_)
+            - jitter_);
+        mean_period_ += smoothing_ * (dt_arrival - mean_period_);
+        mean_stamp_period_ += smoothing_ * (dt_stamp / (missing + 1)
+            - mean_stamp_period_);
+      }
+      ++intervals_;
+      if (missing > 0) {
+        sequence_gaps_ += missing;
+        // A full subscriber queue delays the messages it keeps by at least
+        // its length, so drops with this much lag are counted as overflows.
+        if (queue_size_ > 0 && arrival_time - stamp
+            >= (queue_size_ - 1) * mean_stamp_period_)
+          queue_overflows_ += missing;
+      }
+    }
+    const double lag = arrival_time - stamp;
+    if (received_ == 1) {
+      mean_lag_ = lag;
+      max_lag_ = lag;
+    } else {
+      mean_lag_ += smoothing_ * (lag - mean_lag_);
+      max_lag_ = std::max(max_lag_, lag);
+    }
+    last_seq_ = seq;
+    last_stamp_ = stamp;
+    last_arrival_ = arrival_time;
+    return missing;
+  }
+
+  size_t Received() const {
+    return received_;
+  }
+  /// Arrival rate [Hz], zero before the second message.
+  double Rate() const {
+    return intervals_ > 0 && mean_period_ > 0 ? 1. / mean_period_ : 0;
+  }
+  /// Mean absolute deviation of the inter-arrival times from their mean [s].
+  double Jitter() const {
+    return jitter_;
+  }
+  /// Arrival time minus header stamp [s].
+  double MeanLag() const {
+    return mean_lag_;
+  }
+  double MaxLag() const {
+    return max_lag_;
+  }
+  /// Number of messages missing in the sequence numbers.
+  size_t SequenceGaps() const {
+    return sequence_gaps_;
+  }
+  /// Estimated number of the missing messages dropped by a full subscriber
+  /// queue rather than on the transport.
+  size_t QueueOverflows() const {
+    return queue_overflows_;
+  }
+
+  void Print(std::ostream& out) const {
+    out << "received " << received_ << ", rate " << Rate() << " Hz, jitter "
+        << Jitter() * 1e3 << " ms, lag " << MeanLag() * 1e3 << " ms (max "
+        << MaxLag() * 1e3 << " ms), missing " << sequence_gaps_
+        << " (queue overflows ~" << queue_overflows_ << ")";
+  }
+
+  void Reset() {
+    received_ = 0;
+    intervals_ = 0;
+    sequence_gaps_ = 0;
+    queue_overflows_ = 0;
+    last_seq_ = 0;
+    last_stamp_ = 0;
+    last_arrival_ = 0;
+    mean_period_ = 0;
+    mean_stamp_period_ = 0;
+    jitter_ = 0;
+    mean_lag_ = 0;
+    max_lag_ = 0;
+  }
+
+ private:
+  size_t queue_size_;
+  double smoothing_;
+  size_t received_;
+  size_t intervals_;
+  size_t sequence_gaps_;
+  size_t queue_overflows_;
+  size_t last_seq_;
+  double last_stamp_;
+  double last_arrival_;
+  double mean_period_;
+  double mean_stamp_period_;
+  double jitter_;
+  double mean_lag_;
+  double max_lag_;
+};
+}  // namespace msf_core
+#endif  // MSF_INGESTIONSTATISTICS_H_
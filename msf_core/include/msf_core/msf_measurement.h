@@ -17,6 +17,8 @@
 #ifndef MEASUREMENT_H_
 #define MEASUREMENT_H_
 
+#include <cassert>
+#include <cmath>
 #include <Eigen/Dense>
 #include <boost/shared_ptr.hpp>
 
@@ -24,6 +26,25 @@
 #include <msf_core/msf_types.h>
 
 namespace msf_core {
+/**
+ * \brief The non-zero entries of the 1xN Jacobian of a scalar measurement.
+ */
+template<int MaxNonZeros>
+struct SparseJacobianRow {
+  SparseJacobianRow()
+      : size(0) {
+  }
+  void Add(int index, double value) {
+    assert(size < MaxNonZeros);
+    indices[size] = index;
+    values[size] = value;
+    ++size;
+  }
+  int size;
+  int indices[MaxNonZeros];
+  double values[MaxNonZeros];
+};
+
 /**
  * \brief The base class for all measurement types.
  * These are the objects provided to the EKF core to be applied in correct order
@@ -64,6 +85,16 @@ class MSF_MeasurementBase {
                                    const Eigen::MatrixXd& residual,
                                    const Eigen::MatrixXd& R);
 
+  /**
+   * Update for a scalar measurement, which only needs the non-zero entries of
+   * H. This is a rank one update of P in O(N^2), instead of the dense
+   * products of CalculateAndApplyCorrection.
+   */
+  template<int MaxNonZeros>
+  void CalculateAndApplyScalarCorrection(
+      shared_ptr<EKFState_T> state, MSF_Core<EKFState_T>& core,
+      const SparseJacobianRow<MaxNonZeros>& H, double residual, double R);
+
   template<class H_type, class Res_type, class R_type>
   void CalculateAndApplyCorrectionRelative(
       shared_ptr<EKFState_T> state_old, shared_ptr<EKFState_T> state_new,
@@ -107,8 +138,7 @@ class MSF_InvalidMeasurement : public MSF_MeasurementBase<EKFState_T> {
 template<typename T, typename RMAT_T, typename EKFState_T>
 class MSF_Measurement : public MSF_MeasurementBase<EKFState_T> {
  private:
-  virtual void MakeFromSensorReadingImpl(
-      const boost::shared_ptr<T const> reading) = 0;
+  virtual void MakeFromSensorReadingImpl(const T& reading) = 0;
  protected:
   RMAT_T R_;
  public:
@@ -123,6 +153,13 @@ class MSF_Measurement : public MSF_MeasurementBase<EKFState_T> {
   virtual ~MSF_Measurement() { }
   void MakeFromSensorReading(const boost::shared_ptr<T const> reading,
                              double timestamp) {
+    MakeFromSensorReading(*reading, timestamp);
+  }
+  /**
+   * \brief Reads the measurement from a reading owned by the caller, e.g. a
+   * message on the stack, so the sensor path does not need to allocate it.
+   */
+  void MakeFromSensorReading(const T& reading, double timestamp) {
     this->time = timestamp;
     MakeFromSensorReadingImpl(reading);
 
@@ -134,7 +171,7 @@ class MSF_Measurement : public MSF_MeasurementBase<EKFState_T> {
           "measurement. Please double check!");
     }
 
-    for (int i = 0; i < R_.RowsAtCompileTime; ++i) {
+    for (int i = 0; i < R_.rows(); ++i) {
       if (R_(i, i) == 0.0) {
         MSF_WARN_STREAM_THROTTLE(
             2,
@@ -143,9 +180,59 @@ class MSF_Measurement : public MSF_MeasurementBase<EKFState_T> {
       }
     }
   }
+  const RMAT_T& GetR() const {
+    return R_;
+  }
 // Apply is implemented by respective sensor measurement types.
 };
 
+/**
+ * \brief The class for 1-D measurements, e.g. pressure, altitude, range or a
+ * single position axis. Derived classes provide the residual and the non-zero
+ * entries of H, the update then runs in O(N^2) for N error states.
+ * \note Only absolute measurements are supported.
+ */
+template<typename T, typename EKFState_T, int MaxNonZeros = 9>
+class MSF_ScalarMeasurement : public MSF_Measurement<T,
+    Eigen::Matrix<double, 1, 1>, EKFState_T> {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  typedef SparseJacobianRow<MaxNonZeros> SparseH_T;
+
+  MSF_ScalarMeasurement(bool isAbsoluteMeasurement, int sensorID)
+      : MSF_Measurement<T, Eigen::Matrix<double, 1, 1>, EKFState_T>(
+          isAbsoluteMeasurement, sensorID) {
+  }
+  virtual ~MSF_ScalarMeasurement() { }
+
+  /**
+   * \brief Computes the residual and the non-zero entries of H for the given
+   * state.
+   */
+  virtual void CalculateScalarH(shared_ptr<EKFState_T> state, SparseH_T& H,
+                                double& residual) = 0;
+
+  virtual void Apply(shared_ptr<EKFState_T> state,
+                     MSF_Core<EKFState_T>& core) {
+    if (state->time == constants::INVALID_TIME) {
+      MSF_WARN_STREAM(
+          "Apply " << this->Type() << " update was called with an invalid "
+          "state.");
+      return;  // Early abort.
+    }
+    SparseH_T H;
+    double residual = 0;
+    CalculateScalarH(state, H, residual);
+    if (std::isnan(residual) || std::isinf(residual)) {
+      MSF_ERROR_STREAM("Residual of " << this->Type() << " measurement is "
+                       << residual << ", discarding the measurement.");
+      return;
+    }
+    this->CalculateAndApplyScalarCorrection(state, core, H, residual,
+                                            this->R_(0, 0));
+  }
+};
+
 /**
  * \brief A measurement to be send to initialize parts of or the full EKF state
  * this can especially be used to split the initialization of the EKF
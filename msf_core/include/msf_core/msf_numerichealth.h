@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <slynen at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MSF_NUMERICHEALTH_H_
+#define MSF_NUMERICHEALTH_H_
+
+#include <cmath>
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+#include <msf_core/eigen_utils.h>
+
+namespace msf_core {
+/**
+ * \class NumericHealth
+ * \brief Checks the covariance for non-finite values on the hot path at
+ * constant cost. Every check looks at the trace, which a NaN or Inf on the
+ * diagonal or fed through the propagation makes non-finite. The full O(N^2)
+ * check runs only every full_check_period checks or after a kernel which can
+ * produce non-finite values, e.g. an inversion, flagged its result.
+ */
+class NumericHealth {
+ public:
+  explicit NumericHealth(size_t full_check_period = 100)
+      : full_check_period_(full_check_period) {
+    Reset();
+  }
+
+  void SetFullCheckPeriod(size_t full_check_period) {
+    full_check_period_ = full_check_period;
+  }
+
+  /// Checks a small kernel result, a non-finite one forces the next full check.
+  template<class D>
+  bool CheckKernel(const Eigen::MatrixBase<D>& result) {
+    if (IsFinite(result))
+      return true;
+    flagged_ = true;
+    ++kernel_flags_;
+    return false;
+  }
+
+  template<class D>
+  bool CheckCovariance(const Eigen::MatrixBase<D>& P,
+                       const std::string& info) {
+    ++sentinel_checks_;
+    bool healthy = std::isfinite(P.trace());
+    if (healthy && (flagged_ || ++checks_since_full_ >= full_check_period_)) {
+      ++full_checks_;
+      healthy = IsFinite(P);
+      flagged_ = false;
+      checks_since_full_ = 0;
+    }
+    if (!healthy) {
+      ++failures_;
+      // Report the entry.
+      CheckForNumeric(P, info);
+    }
+    return healthy;
+  }
+
+  size_t SentinelChecks() const {
+    return sentinel_checks_;
+  }
+  size_t FullChecks() const {
+    return full_checks_;
+  }
+  size_t KernelFlags() const {
+    return kernel_flags_;
+  }
+  size_t Failures() const {
+    return failures_;
+  }
+
+  void Print(std::ostream& out) const {
+    out << "covariance checks " << sentinel_checks_ << " (full "
+        << full_checks_ << "), kernel flags " << kernel_flags_
+        << ", non-finite " << failures_;
+  }
+
+  void Reset() {
+    flagged_ = false;
+    checks_since_full_ = 0;
+    sentinel_checks_ = 0;
+    full_checks_ = 0;
+    kernel_flags_ = 0;
+    failures_ = 0;
+  }
+
+ private:
+  size_t full_check_period_;
+  bool flagged_;
+  size_t checks_since_full_;
+  size_t sentinel_checks_;
+  size_t full_checks_;
+  size_t kernel_flags_;
+  size_t failures_;
+};
+}  // namespace msf_core
+#endif  // MSF_NUMERICHEALTH_H_
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <slynen at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MSF_RATELIMITER_H_
+#define MSF_RATELIMITER_H_
+
+#include <cstddef>
+#include <Eigen/Core>
+
+namespace msf_core {
+/**
+ * \class MeasurementRateLimiter
+ * \brief Decimates the readings of a sensor to a maximum rate based on their
+ * timestamps, so drops on the transport do not change the resulting rate as
+ * long as a reading arrives within each period.
+ */
+class MeasurementRateLimiter {
+ public:
+  struct Statistics {
+    Statistics()
+        : received(0),
+          accepted(0),
+          dropped(0) {
+    }
+    size_t received;
+    size_t accepted;
+    size_t dropped;  ///< Readings rejected to stay below the maximum rate.
+  };
+
+  /// A max_rate of zero accepts every reading.
+  MeasurementRateLimiter(double max_rate = 0, bool average_dropped = false)
+      : average_dropped_(average_dropped),
+        timestamp_last_accepted_(-1),
+        timestamp_next_due_(0) {
+    SetMaxRate(max_rate);
+  }
+
+  void SetMaxRate(double max_rate) {
+    max_rate_ = max_rate > 0 ? max_rate : 0;
+    minimum_dt_ = max_rate_ > 0 ? 1. / max_rate_ : 0;
+  }
+  double GetMaxRate() const {
+    return max_rate_;
+  }
+
+  /// If set, the handler merges the dropped readings into the accepted one.
+  void SetAverageDropped(bool average_dropped) {
+    average_dropped_ = average_dropped;
+  }
+  bool AverageDropped() const {
+    return average_dropped_;
+  }
+
+  /// Returns true if the reading at timestamp is to be processed.
+  bool Accept(double timestamp) {
+    // Small time correction to avoid rounding errors in the timestamps.
+    const double epsilon = 0.01 * minimum_dt_;
+    ++statistics_.received;
+    // Readings from the past (e.g. a restarted bag) restart the decimation.
+    const bool restart = timestamp_last_accepted_ < 0
+        || timestamp < timestamp_last_accepted_;
+    if (!restart && minimum_dt_ > 0
+        && timestamp < timestamp_next_due_ - epsilon) {
+      ++statistics_.dropped;
+      return false;
+    }
+    // Advance on a fixed grid, so late readings do not lower the rate. After
+    // a gap the grid starts again from this reading.
+    timestamp_next_due_ += minimum_dt_;
+    if (restart || timestamp_next_due_ <= timestamp)
+      timestamp_next_due_ = timestamp + minimum_dt_;
+    timestamp_last_accepted_ = timestamp;
+    ++statistics_.accepted;
+    return true;
+  }
+
+  const Statistics& GetStatistics() const {
+    return statistics_;
+  }
+
+  void Reset() {
+    timestamp_last_accepted_ = -1;
+    timestamp_next_due_ = 0;
+    statistics_ = Statistics();
+  }
+
+ private:
+  double max_rate_;
+  double minimum_dt_;
+  bool average_dropped_;
+  double timestamp_last_accepted_;
+  double timestamp_next_due_;
+  Statistics statistics_;
+};
+
+/**
+ * \class ReadingAverager
+ * \brief Running mean of N-dimensional readings and their timestamps, used to
+ * merge the readings dropped by the MeasurementRateLimiter.
+ */
+template<int N>
+class ReadingAverager {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  typedef Eigen::Matrix<double, N, 1> Reading_T;
+
+  ReadingAverager() {
+    Reset();
+  }
+
+  void Add(double timestamp, const Reading_T& reading) {
+    sum_ += reading;
+    timestamp_sum_ += timestamp;
+    ++count_;
+  }
+  size_t Count() const {
+    return count_;
+  }
+  /// Only defined if Count() > 0.
+  Reading_T Mean() const {
+    return sum_ / count_;
+  }
+  double MeanTimestamp() const {
+    return timestamp_sum_ / count_;
+  }
+  void Reset() {
+    sum_.setZero();
+    timestamp_sum_ = 0;
+    count_ = 0;
+  }
+
+ private:
+  Reading_T sum_;
+  double timestamp_sum_;
+  size_t count_;
+};
+}  // namespace msf_core
+#endif  // MSF_RATELIMITER_H_
@@ -17,6 +17,13 @@
 #ifndef MSF_SENSORHANDLER_H_
 #define MSF_SENSORHANDLER_H_
 
+#include <algorithm>
+#include <map>
+#include <ostream>
+#include <string>
+#include <msf_core/msf_ingestionstatistics.h>
+#include <msf_core/msf_ratelimiter.h>
+
 namespace msf_core {
 /**
  * \class SensorHandler
@@ -25,23 +32,72 @@ namespace msf_core {
 template<typename EKFState_T>
 class SensorHandler {
   friend class MSF_SensorManager<EKFState_T> ;
-  int lastseq_;
+ public:
+  typedef std::map<std::string, IngestionStatistics> IngestionStatisticsMap_T;
+ private:
+  /// Arrival of the messages, per topic the handler subscribes to.
+  IngestionStatisticsMap_T ingestion_statistics_;
+  /// Subscriber queue size of the topics, zero if unknown.
+  size_t ingestion_queue_size_;
  protected:
   MSF_SensorManager<EKFState_T>& manager_;
   int sensorID;
   std::string topic_namespace_;
   std::string parameternamespace_;
   bool received_first_measurement_;
+  MeasurementRateLimiter rate_limiter_;
+  /// Readings dropped by all rate limiters of this handler.
+  size_t rate_limited_;
+  /// Measurements of low priority sensors are decimated first under load.
+  bool low_priority_;
   void SetSensorID(int ID) {
     sensorID = ID;
   }
-  void SequenceWatchDog(size_t seq, const std::string& topic) {
-    if (static_cast<int>(seq) != lastseq_ + 1 && lastseq_ != 0) {
+  /// Sets the subscriber queue size of all topics of this handler.
+  void SetIngestionQueueSize(size_t queue_size) {
+    ingestion_queue_size_ = queue_size;
+    for (typename IngestionStatisticsMap_T::iterator it = ingestion_statistics_
+        .begin(); it != ingestion_statistics_.end(); ++it)
+      it->second.SetQueueSize(queue_size);
+  }
+  /**
+   * \brief Warns about dropped messages and adds the message to the ingestion
+   * statistics of its topic. stamp and arrival_time are in seconds of the same
+   * clock.
+   */
+  void SequenceWatchDog(size_t seq, const std::string& topic, double stamp,
+                        double arrival_time) {
+    typename IngestionStatisticsMap_T::iterator it = ingestion_statistics_
+        .find(topic);
+    if (it == ingestion_statistics_.end()) {
+      it = ingestion_statistics_.insert(
+          std::make_pair(topic, IngestionStatistics(ingestion_queue_size_)))
+          .first;
+    }
+    const size_t missing = it->second.Add(seq, stamp, arrival_time);
+    if (missing > 0) {
       MSF_WARN_STREAM(
           topic << ": message drop curr seq:" << seq << " expected: "
-                << lastseq_ + 1);
+                << seq - missing);
     }
-    lastseq_ = seq;
+  }
+  /// Returns false if the reading has to be dropped to stay below the maximum
+  /// rate configured for this handler.
+  bool RateLimit(double timestamp) {
+    return RateLimit(rate_limiter_, timestamp);
+  }
+  /// As above, for inputs which have their own rate limiter.
+  bool RateLimit(MeasurementRateLimiter& rate_limiter, double timestamp) {
+    if (rate_limiter.Accept(timestamp))
+      return true;
+    ++rate_limited_;
+    const MeasurementRateLimiter::Statistics& stats = rate_limiter
+        .GetStatistics();
+    MSF_WARN_STREAM_THROTTLE(
+        30, topic_namespace_ << ": measurement rate limited to "
+            << rate_limiter.GetMaxRate() << " Hz, dropped " << stats.dropped
+            << " of " << stats.received << " readings");
+    return false;
   }
  public:
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
@@ -49,16 +105,41 @@ class SensorHandler {
   SensorHandler(MSF_SensorManager<EKFState_T>& mng,
                 const std::string& topic_namespace,
                 const std::string& parameternamespace)
-      : lastseq_(0),
+      : ingestion_queue_size_(0),
         manager_(mng),
         sensorID(constants::INVALID_ID),
         topic_namespace_(topic_namespace),
         parameternamespace_(parameternamespace),
-        received_first_measurement_(false) {
+        received_first_measurement_(false),
+        rate_limited_(0),
+        low_priority_(false) {
+    manager_.ingestion_handlers_.push_back(this);
   }
   virtual ~SensorHandler() {
+    manager_.ingestion_handlers_.erase(
+        std::remove(manager_.ingestion_handlers_.begin(),
+                    manager_.ingestion_handlers_.end(), this),
+        manager_.ingestion_handlers_.end());
   }
   bool ReceivedFirstMeasurement() const {return received_first_measurement_;}
+  const MeasurementRateLimiter& GetRateLimiter() const {return rate_limiter_;}
+  /// The ingestion statistics of each topic that received a message.
+  const IngestionStatisticsMap_T& GetIngestionStatistics() const {
+    return ingestion_statistics_;
+  }
+  /// Prints the readings dropped by this handler, followed by the ingestion
+  /// statistics of each of its topics on a line of its own.
+  void PrintIngestionStatistics(std::ostream& out) const {
+    out << topic_namespace_ << ": rate limited " << rate_limited_
+        << ", rejected by core "
+        << manager_.msf_core_->GetRejectedMeasurements(sensorID);
+    for (typename IngestionStatisticsMap_T::const_iterator it =
+        ingestion_statistics_.begin(); it != ingestion_statistics_.end();
+        ++it) {
+      out << std::endl << "  " << it->first << ": ";
+      it->second.Print(out);
+    }
+  }
 };
 }
 #endif  // MSF_SENSORHANDLER_H_
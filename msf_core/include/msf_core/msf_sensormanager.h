@@ -19,6 +19,8 @@
 
 #include <Eigen/Dense>
 #include <string.h>
+#include <ostream>
+#include <vector>
 #include <msf_core/msf_types.h>
 #include <msf_core/msf_statevisitor.h>
 #include <msf_core/msf_macros.h>
@@ -39,8 +41,14 @@ class MSF_Core;
  */
 template<typename EKFState_T>
 class MSF_SensorManager : public StateVisitor<EKFState_T> {
+  friend class SensorHandler<EKFState_T>;
  private:
   int sensorID_;
+  /**
+   * All handlers including the IMU handler, which register themselves. Must
+   * be declared before the handlers, so it outlives them.
+   */
+  std::vector<const SensorHandler<EKFState_T>*> ingestion_handlers_;
  protected:
   typedef std::vector<shared_ptr<SensorHandler<EKFState_T> > > Handlers;
   Handlers handlers;  ///< A list of sensor handlers which provide measurements.
@@ -74,9 +82,18 @@ class MSF_SensorManager : public StateVisitor<EKFState_T> {
    */
   void AddHandler(shared_ptr<SensorHandler<EKFState_T> > handler) {
     handler->SetSensorID(sensorID_++);
+    msf_core_->SetSensorLowPriority(handler->sensorID, handler->low_priority_);
     handlers.push_back(handler);
   }
 
+  /// Prints the ingestion statistics of all handlers and their topics.
+  void PrintIngestionStatistics(std::ostream& out) const {
+    for (size_t i = 0; i < ingestion_handlers_.size(); ++i) {
+      ingestion_handlers_[i]->PrintIngestionStatistics(out);
+      out << std::endl;
+    }
+  }
+
   /***
    * Init function for the EKF.
    */
@@ -98,9 +115,7 @@ class MSF_SensorManager : public StateVisitor<EKFState_T> {
   /***
    * This method will be called for the user to set the initial P matrix.
    */
-  virtual void SetStateCovariance(
-      Eigen::Matrix<double, EKFState_T::nErrorStatesAtCompileTime,
-          EKFState_T::nErrorStatesAtCompileTime>& P) const = 0;
+  virtual void SetStateCovariance(typename EKFState_T::P_type& P) const = 0;
 
   /***
    * This method will be called for the user to have the possibility to augment
@@ -131,6 +146,8 @@ class MSF_SensorManager : public StateVisitor<EKFState_T> {
   virtual double GetParamNoiseGyr() const = 0;
   virtual double GetParamNoiseGyrbias() const = 0;
   virtual double GetParamFuzzyTrackingThreshold() const = 0;
+  /// Processing lag [s] above which the core degrades, zero disables.
+  virtual double GetParamMaxProcessingLag() const = 0;
 
   /**
    * This functions get called by the core to publish data to external
@@ -142,6 +159,10 @@ class MSF_SensorManager : public StateVisitor<EKFState_T> {
       const shared_ptr<EKFState_T>& state) const = 0;
   virtual void PublishStateAfterUpdate(
       const shared_ptr<EKFState_T>& state) const = 0;
+  /// Gets called from the thread of the smoother, see MSF_Core::SetSmootherLag.
+  virtual void PublishSmoothedState(
+      const shared_ptr<EKFState_T>& /*state*/) const {
+  }
 
 };
 }  // namespace msf_core
@@ -17,6 +17,8 @@
 #ifndef SENSORMANAGERROS_H
 #define SENSORMANAGERROS_H
 
+#include <sstream>
+
 #include <ros/ros.h>
 #include <dynamic_reconfigure/server.h>
 
@@ -34,6 +36,7 @@
 #include <msf_core/MSF_CoreConfig.h>
 #include <msf_core/msf_sensormanager.h>
 #include <msf_core/msf_types.h>
+#include <msf_timing/Timer.h>
 
 namespace msf_core {
 
@@ -64,6 +67,7 @@ struct MSF_SensorManagerROS : public msf_core::MSF_SensorManager<EKFState_T> {
   ros::Publisher pubPose_;  ///< Publishes 6DoF pose output.
   ros::Publisher pubOdometry_;  ///< Publishes odometry output.
   ros::Publisher pubPoseAfterUpdate_;  ///< Publishes 6DoF pose output after the update has been applied.
+  ros::Publisher pubPoseSmoothed_;  ///< Publishes the 6DoF pose smoothed over the smoother lag.
   ros::Publisher pubPoseCrtl_;  ///< Publishes 6DoF pose including velocity output.
   ros::Publisher pubCorrect_;  ///< Publishes corrections for external state propagation.
   ros::Publisher pubCovCore_;  ///< Publishes the covariance matrix for the core states.
@@ -74,6 +78,8 @@ struct MSF_SensorManagerROS : public msf_core::MSF_SensorManager<EKFState_T> {
 
   sensor_fusion_comm::ExtEkf hl_state_buf_;  ///< Buffer to store external propagation data.
 
+  ros::WallTimer diagnostics_report_timer_;  ///< Prints the diagnostics report.
+
  public:
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
@@ -85,6 +91,43 @@ struct MSF_SensorManagerROS : public msf_core::MSF_SensorManager<EKFState_T> {
 
     pnh.param("data_playback", this->data_playback_, false);
 
+    // Threads for the covariance products, only used for large states.
+    int covariance_threads, covariance_min_dimension;
+    pnh.param("covariance_threads", covariance_threads, 1);
+    pnh.param("covariance_parallel_min_dimension", covariance_min_dimension,
+              60);
+    this->msf_core_->SetCovarianceThreads(covariance_threads,
+                                          covariance_min_dimension);
+
+    // Square-root form of the covariance, slower but numerically robust.
+    bool square_root_covariance;
+    pnh.param("square_root_covariance", square_root_covariance, false);
+    bool square_root_covariance_single_precision;
+    pnh.param("square_root_covariance_single_precision",
+              square_root_covariance_single_precision, false);
+    this->msf_core_->SetSquareRootCovariance(
+        square_root_covariance, square_root_covariance_single_precision);
+
+    // Lag [s] of the fixed-lag smoother, zero disables.
+    double smoother_lag;
+    pnh.param("smoother_lag", smoother_lag, 0.0);
+    this->msf_core_->SetSmootherLag(smoother_lag);
+
+    // Apply absolute measurements between two IMU states on temporary states
+    // instead of inserting states into the buffer.
+    bool virtual_measurement_states;
+    pnh.param("virtual_measurement_states", virtual_measurement_states, false);
+    this->msf_core_->SetVirtualMeasurementStates(virtual_measurement_states);
+
+    // Period [s] of the timing and sensor ingestion report, zero disables.
+    double diagnostics_report_period;
+    pnh.param("diagnostics_report_period", diagnostics_report_period, 0.0);
+    if (diagnostics_report_period > 0) {
+      diagnostics_report_timer_ = pnh.createWallTimer(
+          ros::WallDuration(diagnostics_report_period),
+          &MSF_SensorManagerROS::DiagnosticsReportCallback, this);
+    }
+
     ros::NodeHandle nh("msf_core");
 
     pubState_ = nh.advertise < sensor_fusion_comm::DoubleArrayStamped
@@ -95,6 +138,8 @@ struct MSF_SensorManagerROS : public msf_core::MSF_SensorManager<EKFState_T> {
     pubOdometry_ = nh.advertise < nav_msgs::Odometry> ("odometry", 100);
     pubPoseAfterUpdate_ = nh.advertise
         < geometry_msgs::PoseWithCovarianceStamped > ("pose_after_update", 100);
+    pubPoseSmoothed_ = nh.advertise
+        < geometry_msgs::PoseWithCovarianceStamped > ("pose_smoothed", 100);
     pubPoseCrtl_ = nh.advertise < sensor_fusion_comm::ExtState
         > ("ext_state", 1);
     pubCovCore_ = nh.advertise<sensor_fusion_comm::DoubleMatrixStamped>(
@@ -123,9 +168,21 @@ struct MSF_SensorManagerROS : public msf_core::MSF_SensorManager<EKFState_T> {
   }
 
   virtual ~MSF_SensorManagerROS() {
+    // Stop the smoother, it publishes through this object.
+    this->msf_core_->SetSmootherLag(0);
     delete reconfServer_;
   }
 
+  void DiagnosticsReportCallback(const ros::WallTimerEvent& /*event*/) {
+    std::stringstream report;
+    msf_timing::Timing::Print(report);
+    report << "Sensor ingestion:" << std::endl;
+    this->PrintIngestionStatistics(report);
+    report << "Numeric health: ";
+    this->msf_core_->GetNumericHealth().Print(report);
+    MSF_INFO_STREAM(report.str());
+  }
+
   /**
    * \brief Gets called by the internal callback caller.
    */
@@ -168,6 +225,9 @@ struct MSF_SensorManagerROS : public msf_core::MSF_SensorManager<EKFState_T> {
   virtual double GetParamFuzzyTrackingThreshold() const {
     return 0.1;
   }
+  virtual double GetParamMaxProcessingLag() const {
+    return config_.core_max_processing_lag;
+  }
   virtual void PublishStateInitial(const shared_ptr<EKFState_T>& state) const {
     /**
      * \brief Initialize the HLP based propagation.
@@ -224,6 +284,21 @@ struct MSF_SensorManagerROS : public msf_core::MSF_SensorManager<EKFState_T> {
     }
   }
 
+  virtual void PublishSmoothedState(
+      const shared_ptr<EKFState_T>& state) const {
+    static int msg_seq = 0;
+
+    if (pubPoseSmoothed_.getNumSubscribers()) {
+      geometry_msgs::PoseWithCovarianceStamped msgPose;
+      msgPose.header.stamp = ros::Time(state->time);
+      msgPose.header.seq = msg_seq++;
+      msgPose.header.frame_id = "/world";
+
+      state->ToPoseMsg(msgPose);
+      pubPoseSmoothed_.publish(msgPose);
+    }
+  }
+
   virtual void PublishStateAfterUpdate(
       const shared_ptr<EKFState_T>& state) const {
     static int msg_seq = 0;
@@ -344,7 +419,11 @@ struct MSF_SensorManagerROS : public msf_core::MSF_SensorManager<EKFState_T> {
               "world", "state"));
     }
 
-    if (pubCovCore_.getNumSubscribers()) {
+    // The covariance messages are the first thing to go under load.
+    const bool publish_covariance = this->msf_core_->GetDegradationLevel()
+        < msf_core::MSF_Core<EKFState_T>::DEGRADATION_SKIP_COVARIANCE_PUBLISHING;
+
+    if (publish_covariance && pubCovCore_.getNumSubscribers()) {
       sensor_fusion_comm::DoubleMatrixStampedPtr msg(
           new sensor_fusion_comm::DoubleMatrixStamped);
       msg->header = msgCorrect_.header;
@@ -352,7 +431,7 @@ struct MSF_SensorManagerROS : public msf_core::MSF_SensorManager<EKFState_T> {
       pubCovCore_.publish(msg);
     }
 
-    if (pubCovAux_.getNumSubscribers()) {
+    if (publish_covariance && pubCovAux_.getNumSubscribers()) {
       sensor_fusion_comm::DoubleMatrixStampedPtr msg(
           new sensor_fusion_comm::DoubleMatrixStamped);
       msg->header = msgCorrect_.header;
@@ -360,7 +439,7 @@ struct MSF_SensorManagerROS : public msf_core::MSF_SensorManager<EKFState_T> {
       pubCovAux_.publish(msg);
     }
 
-    if (pubCovCoreAux_.getNumSubscribers()) {
+    if (publish_covariance && pubCovCoreAux_.getNumSubscribers()) {
       sensor_fusion_comm::DoubleMatrixStampedPtr msg(
           new sensor_fusion_comm::DoubleMatrixStamped);
       msg->header = msgCorrect_.header;
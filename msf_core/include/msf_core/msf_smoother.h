@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <slynen at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MSF_SMOOTHER_H_
+#define MSF_SMOOTHER_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <msf_core/msf_types.h>
+
+namespace msf_core {
+/**
+ * \class FixedLagSmoother
+ * \brief Fixed-lag Rauch-Tung-Striebel smoother over copies of the filter
+ * states, each with its covariance P, the transition Fd and noise Qd to the
+ * next state and the correction the updates applied to it.
+ *
+ * The core adds the states once their covariance is final. Whenever the
+ * window spans twice the lag, a worker thread runs the backward pass over it
+ * and publishes the smoothed states which are at least lag seconds older
+ * than the newest one. Those leave the window, so every state is smoothed
+ * about twice and each IMU step adds O(1) smoother work.
+ *
+ * The smoothed error of state k is
+ *   G_k = P_k * Fd_k' * (Fd_k * P_k * Fd_k' + Qd_k)^-1
+ *   dx_k = G_k * (dx_k+1 + correction_k+1)
+ * and is applied to the state with Correct(), so multiplicative corrections
+ * are not supported.
+ */
+template<typename EKFState_T>
+class FixedLagSmoother {
+ public:
+  typedef typename EKFState_T::P_type P_type;
+  typedef Eigen::Matrix<double, EKFState_T::nErrorStatesAtCompileTime, 1>
+      ErrorState;
+  typedef std::function<void(const shared_ptr<EKFState_T>&)> Callback_T;
+
+  struct Entry {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    EKFState_T state;
+    /// The correction the updates applied to the propagated state.
+    ErrorState correction;
+  };
+  typedef shared_ptr<const Entry> EntryConstPtr;
+
+  FixedLagSmoother()
+      : lag_(0),
+        last_output_time_(-1),
+        stop_(false),
+        busy_(false) {
+  }
+
+  ~FixedLagSmoother() {
+    StopWorker();
+  }
+
+  /// A lag [s] of zero disables the smoother.
+  void SetLag(double lag) {
+    Reset();
+    lag_ = lag > 0 ? lag : 0;
+    if (lag_ > 0 && !worker_.joinable()) {
+      stop_ = false;
+      worker_ = std::thread(&FixedLagSmoother::WorkerLoop, this);
+    } else if (lag_ == 0) {
+      StopWorker();
+    }
+  }
+  double GetLag() const {
+    return lag_;
+  }
+  bool IsEnabled() const {
+    return lag_ > 0;
+  }
+
+  /// Called on the worker thread with the smoothed states in time order.
+  void SetCallback(const Callback_T& callback) {
+    callback_ = callback;
+  }
+
+  /// Time of the newest state added or published, -1 if none.
+  double GetLastTime() const {
+    return window_.empty() ? last_output_time_ : window_.back()->state.time;
+  }
+
+  /// Removes the states from time on, e.g. when an update changed them.
+  void DiscardFrom(double time) {
+    while (!window_.empty() && window_.back()->state.time >= time)
+      window_.pop_back();
+  }
+
+  /// Adds a copy of the state, which must be newer than the ones added.
+  void Add(const EKFState_T& state, const ErrorState& correction) {
+    shared_ptr<Entry> entry(new Entry);
+    entry->state = state;
+    entry->correction = correction;
+    window_.push_back(entry);
+    if (window_.back()->state.time - window_.front()->state.time < 2 * lag_)
+      return;
+    const double time_output = window_.back()->state.time - lag_;
+    size_t num_output = 0;
+    while (window_[num_output]->state.time <= time_output)
+      ++num_output;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      jobs_.push_back(
+          Job(std::vector<EntryConstPtr>(window_.begin(), window_.end()),
+              num_output));
+    }
+    job_available_.notify_one();
+    last_output_time_ = window_[num_output - 1]->state.time;
+    window_.erase(window_.begin(), window_.begin() + num_output);
+  }
+
+  /// Drops the window and the windows not yet smoothed.
+  void Reset() {
+    window_.clear();
+    last_output_time_ = -1;
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.clear();
+  }
+
+  /// Waits until the worker has published all windows handed to it.
+  void Flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    job_done_.wait(lock, [this] {return jobs_.empty() && !busy_;});
+  }
+
+  /**
+   * \brief The backward pass over the window, which starts at the newest
+   * state. Returns the smoothed copies of the first num_output states.
+   */
+  static void Smooth(const std::vector<EntryConstPtr>& window,
+                     size_t num_output,
+                     std::vector<shared_ptr<EKFState_T> >& smoothed) {
+    smoothed.resize(num_output);
+    const int n = window.back()->state.P.rows();
+    ErrorState dx_next;
+    dx_next.setZero(n);
+    P_type P_next = window.back()->state.P;
+    P_type P_pred, tmp, G_t;
+    for (int k = static_cast<int>(window.size()) - 2; k >= 0; --k) {
+      const EKFState_T& state = window[k]->state;
+      tmp.noalias() = state.Fd * state.P;
+      P_pred.noalias() = tmp * state.Fd.transpose();
+      P_pred += state.Qd;
+      // P is symmetric, so the gain is (P_pred^-1 * Fd * P)'.
+      G_t = P_pred.ldlt().solve(tmp);
+      const ErrorState innovation = dx_next + window[k + 1]->correction;
+      dx_next.noalias() = G_t.transpose() * innovation;
+      P_next -= P_pred;
+      tmp.noalias() = P_next * G_t;
+      P_next.noalias() = G_t.transpose() * tmp;
+      P_next += state.P;
+      if (k < static_cast<int>(num_output)) {
+        smoothed[k].reset(new EKFState_T(state));
+        smoothed[k]->Correct(dx_next);
+        smoothed[k]->P = P_next;
+      }
+    }
+  }
+
+ private:
+  struct Job {
+    Job(const std::vector<EntryConstPtr>& window, size_t num_output)
+        : window(window),
+          num_output(num_output) {
+    }
+    std::vector<EntryConstPtr> window;
+    size_t num_output;
+  };
+
+  void WorkerLoop() {
+    std::vector<shared_ptr<EKFState_T> > smoothed;
+    while (true) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      job_available_.wait(lock, [this] {return stop_ || !jobs_.empty();});
+      if (stop_)
+        return;
+      Job job = jobs_.front();
+      jobs_.pop_front();
+      busy_ = true;
+      lock.unlock();
+      Smooth(job.window, job.num_output, smoothed);
+      if (callback_) {
+        for (size_t i = 0; i < smoothed.size(); ++i)
+          callback_(smoothed[i]);
+      }
+      lock.lock();
+      busy_ = false;
+      lock.unlock();
+      job_done_.notify_all();
+    }
+  }
+
+  void StopWorker() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    job_available_.notify_all();
+    if (worker_.joinable())
+      worker_.join();
+  }
+
+  double lag_;
+  double last_output_time_;
+  /// States not yet published, only used on the thread of the core.
+  std::deque<EntryConstPtr> window_;
+  Callback_T callback_;
+
+  std::thread worker_;
+  std::mutex mutex_;
+  std::condition_variable job_available_;
+  std::condition_variable job_done_;
+  std::deque<Job> jobs_;
+  bool stop_;
+  bool busy_;
+
+  FixedLagSmoother(const FixedLagSmoother&);
+  FixedLagSmoother& operator=(const FixedLagSmoother&);
+};
+}  // namespace msf_core
+#endif  // MSF_SMOOTHER_H_
@@ -339,6 +339,17 @@ class SortedContainer {
     return start->second;
   }
 
+  /**
+   * \brief Removes the object at the iterator from the container.
+   * \returns iterator to the following object.
+   */
+  inline typename ListT::iterator Erase(typename ListT::iterator it) {
+    typename ListT::iterator next = it;
+    ++next;
+    stateList.erase(it);
+    return next;
+  }
+
   /**
    * \brief This function updates the time of an object in the container
    * this function effectively changes the map ordering, so the previous
@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <slynen at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MSF_SQUAREROOTCOVARIANCE_H_
+#define MSF_SQUAREROOTCOVARIANCE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <Eigen/Dense>
+
+namespace msf_core {
+/**
+ * \class SquareRootCovariance
+ * \brief Propagates and updates the error state covariance through its lower
+ * Cholesky factor L, P = L * L'. The propagation takes the factor from the QR
+ * decomposition of [F * L, sqrt(Qd)]', the updates P - U * U' downdate it by
+ * one rank per column of U. P is rebuilt from the factor, so it is symmetric
+ * and positive semi-definite by construction.
+ *
+ * The factor of the last result is kept together with the P rebuilt from it.
+ * If the next step starts from that P, the factor carries over. It is only
+ * taken from P again if P was changed elsewhere in between, e.g. set by the
+ * user or the update was applied to an older state. If P is not positive
+ * definite then, its eigenvalues are clipped before.
+ *
+ * The factor can be kept in single precision, which halves the memory
+ * traffic of the QR decomposition and the downdates. P and the inputs stay in
+ * double precision.
+ */
+template<typename Matrix_T>
+class SquareRootCovariance {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  enum {
+    Rows = Matrix_T::RowsAtCompileTime,
+    StackedRows = Rows == Eigen::Dynamic ? Eigen::Dynamic : 2 * Rows
+  };
+  typedef Eigen::Matrix<double, Rows, 1> Vector_T;
+
+  SquareRootCovariance()
+      : enabled_(false),
+        single_precision_(false),
+        factor_valid_(false),
+        repairs_(0),
+        factorizations_(0) {
+  }
+
+  void SetEnabled(bool enabled) {
+    enabled_ = enabled;
+  }
+  bool IsEnabled() const {
+    return enabled_;
+  }
+
+  /// Keeps the Cholesky factor in single precision.
+  void SetSinglePrecision(bool single_precision) {
+    single_precision_ = single_precision;
+    factor_valid_ = false;
+  }
+  bool IsSinglePrecision() const {
+    return single_precision_;
+  }
+
+  /// Sizes the workspace, so dynamic size matrices do not allocate per step.
+  void Resize(int n) {
+    tmp_.resize(n, n);
+    P_factored_.resize(n, n);
+    x_.resize(n);
+    factor_double_.Resize(n);
+    factor_single_.Resize(n);
+    factor_valid_ = false;
+  }
+
+  /// Number of times P was not positive definite and had to be repaired.
+  size_t GetRepairs() const {
+    return repairs_;
+  }
+
+  /// Number of times the factor was taken from P rather than carried over.
+  size_t GetFactorizations() const {
+    return factorizations_;
+  }
+
+  /**
+   * \brief P_new = F * P * F' + Q. Q may be singular. P_new must not alias
+   * any argument.
+   */
+  void Propagate(const Matrix_T& F, const Matrix_T& P, const Matrix_T& Q,
+                 Matrix_T& P_new) {
+    if (single_precision_)
+      Propagate(F, P, Q, factor_single_, P_new);
+    else
+      Propagate(F, P, Q, factor_double_, P_new);
+  }
+
+  /**
+   * \brief P -= U * U', e.g. K * S * K' = (K * chol(S)) * (K * chol(S))' for
+   * the update. Returns false and leaves P unchanged if the result is not
+   * positive definite.
+   */
+  template<typename U_T>
+  bool Downdate(const Eigen::MatrixBase<U_T>& U, Matrix_T& P) {
+    if (single_precision_)
+      return Downdate(U, factor_single_, P);
+    return Downdate(U, factor_double_, P);
+  }
+
+ private:
+  /// The factor and the workspace of the steps in the given precision.
+  template<typename Scalar>
+  struct Factor_T {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    typedef Eigen::Matrix<Scalar, Rows, Rows> Matrix_S;
+    typedef Eigen::Matrix<Scalar, StackedRows, Rows> Stacked_S;
+    void Resize(int n) {
+      L.resize(n, n);
+      stacked.resize(2 * n, n);
+      x.resize(n);
+    }
+    Matrix_S L;
+    Stacked_S stacked;
+    Eigen::Matrix<Scalar, Rows, 1> x;
+    Eigen::HouseholderQR<Stacked_S> qr;
+  };
+
+  template<typename Scalar>
+  void Propagate(const Matrix_T& F, const Matrix_T& P, const Matrix_T& Q,
+                 Factor_T<Scalar>& factor, Matrix_T& P_new) {
+    const int n = P.rows();
+    Factor(P, factor);
+    factor.stacked.topRows(n).noalias() = factor.L.transpose()
+        * F.transpose().template cast<Scalar>();
+    // Q = T' * L * D * L' * T from the LDLT decomposition with pivoting.
+    ldlt_.compute(Q);
+    tmp_ = ldlt_.matrixL();
+    tmp_ *= ldlt_.vectorD().cwiseMax(0).cwiseSqrt().asDiagonal();
+    factor.stacked.bottomRows(n) = (ldlt_.transpositionsP().transpose() * tmp_)
+        .transpose().template cast<Scalar>();
+    // [F * L, sqrt(Q)] * [F * L, sqrt(Q)]' = R' * Q' * Q * R = R' * R.
+    factor.qr.compute(factor.stacked);
+    factor.L = factor.qr.matrixQR().topRows(n)
+        .template triangularView<Eigen::Upper>().transpose();
+    Rebuild(factor, P_new);
+  }
+
+  template<typename U_T, typename Scalar>
+  bool Downdate(const Eigen::MatrixBase<U_T>& U, Factor_T<Scalar>& factor,
+                Matrix_T& P) {
+    Factor(P, factor);
+    for (int j = 0; j < U.cols(); ++j) {
+      factor.x = U.col(j).template cast<Scalar>();
+      if (!DowndateRankOne(factor.L, factor.x)) {
+        // Partly downdated, it is no factor of P anymore.
+        factor_valid_ = false;
+        return false;
+      }
+    }
+    Rebuild(factor, P);
+    return true;
+  }
+
+  /// Takes the factor from P, unless it is the result of the last step.
+  template<typename Scalar>
+  void Factor(const Matrix_T& P, Factor_T<Scalar>& factor) {
+    if (factor_valid_ && P == P_factored_)
+      return;
+    ++factorizations_;
+    llt_.compute(P);
+    if (llt_.info() != Eigen::Success) {
+      // Clip the eigenvalues to a small positive value.
+      eigen_.compute(P);
+      x_ = eigen_.eigenvalues();
+      const double min_eigenvalue = std::max(x_.maxCoeff(), 1.)
+          * std::numeric_limits<double>::epsilon() * P.rows();
+      x_ = x_.cwiseMax(min_eigenvalue);
+      tmp_.noalias() = eigen_.eigenvectors() * x_.asDiagonal()
+          * eigen_.eigenvectors().transpose();
+      llt_.compute(tmp_.template selfadjointView<Eigen::Lower>());
+      ++repairs_;
+    }
+    tmp_ = llt_.matrixL();
+    factor.L = tmp_.template cast<Scalar>();
+  }
+
+  /// P = L * L', exactly symmetric. Remembers P to carry the factor over.
+  template<typename Scalar>
+  void Rebuild(const Factor_T<Scalar>& factor, Matrix_T& P) {
+    tmp_ = factor.L.template cast<double>();
+    P.setZero();
+    P.template selfadjointView<Eigen::Lower>().rankUpdate(tmp_);
+    P.template triangularView<Eigen::StrictlyUpper>() = P.transpose();
+    P_factored_ = P;
+    factor_valid_ = true;
+  }
+
+  /// L * L' - x * x' by Givens-like rotations, O(N^2).
+  template<typename L_T, typename X_T>
+  static bool DowndateRankOne(L_T& L, X_T& x) {
+    typedef typename L_T::Scalar Scalar;
+    const int n = L.rows();
+    for (int k = 0; k < n; ++k) {
+      const Scalar diagonal = L(k, k);
+      const Scalar r2 = diagonal * diagonal - x(k) * x(k);
+      if (!(r2 > 0))
+        return false;
+      const Scalar r = std::sqrt(r2);
+      const Scalar c = r / diagonal;
+      const Scalar s = x(k) / diagonal;
+      L(k, k) = r;
+      const int m = n - k - 1;
+      if (m == 0)
+        break;
+      L.col(k).tail(m) = (L.col(k).tail(m) - s * x.tail(m)) / c;
+      x.tail(m) = c * x.tail(m) - s * L.col(k).tail(m);
+    }
+    return true;
+  }
+
+  bool enabled_;
+  bool single_precision_;
+  /// Whether the factor of the current precision belongs to P_factored_.
+  bool factor_valid_;
+  size_t repairs_;
+  size_t factorizations_;
+
+  Matrix_T tmp_;
+  /// The last P rebuilt from the factor.
+  Matrix_T P_factored_;
+  Vector_T x_;
+  Factor_T<double> factor_double_;
+  Factor_T<float> factor_single_;
+  Eigen::LLT<Matrix_T> llt_;
+  Eigen::LDLT<Matrix_T> ldlt_;
+  Eigen::SelfAdjointEigenSolver<Matrix_T> eigen_;
+};
+}  // namespace msf_core
+#endif  // MSF_SQUAREROOTCOVARIANCE_H_
@@ -22,6 +22,7 @@
 #include <msf_core/msf_statevisitor.h>
 #include <Eigen/Dense>
 #include <Eigen/Geometry>
+#include <limits>
 #include <vector>
 #include <utility>
 #include <msf_core/eigen_conversions.h>
@@ -58,23 +59,55 @@ struct StateVar_T {
         name_T>&>::value
   };
   typedef Eigen::Matrix<double, sizeInCorrection_, sizeInCorrection_> Q_T;
+  ///View of the value in the nominal state array of the owning state.
+  typedef Eigen::Map<value_t> Map_T;
 
   Q_T Q;  ///< The noise covariance matrix block of this state.
-  value_t state_;  ///< The state variable of this state.
+  Map_T state_;  ///< The state variable of this state.
   bool hasResetValue;  //<Indicating that this statevariable has a reset value
                        // to be applied to the state on init.
-  StateVar_T() {
+  StateVar_T()
+      : state_(nullptr) {
     hasResetValue = false;
     Q.setZero();
   }
+  /// Copies the value, the view stays on the storage of this state.
+  StateVar_T& operator=(const StateVar_T& other) {
+    Q = other.Q;
+    state_ = other.state_;
+    hasResetValue = other.hasResetValue;
+    return *this;
+  }
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+ private:
+  // Would alias the storage of other.
+  StateVar_T(const StateVar_T& other);
+};
+
+/**
+ * \brief Rotation matrix of a quaternion state together with the quaternion it
+ * was computed from. Comparing the quaternion on every read invalidates the
+ * entry on any write to the state, also through statevars directly.
+ */
+struct RotationCacheEntry {
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  RotationCacheEntry()
+      : q(Eigen::Vector4d::Constant(
+            std::numeric_limits<double>::quiet_NaN())) {
+  }
+  Eigen::Vector4d q;  ///< Coefficients of the quaternion, NaN if unset.
+  Eigen::Matrix3d C;  ///< Its rotation matrix.
 };
 
 /**
  * \brief The state vector containing all the state variables for this EKF
  * configuration.
+ * \note Set CovarianceStorage to DynamicSizeCovariance for large states, e.g.
+ * many calibration states. P and the matrices of its size are then allocated
+ * on the heap, which keeps the compile times and the stack usage low.
  */
-template<typename StateSeq_T, typename StateDef_T>
+template<typename StateSeq_T, typename StateDef_T, int CovarianceStorage>
 struct GenericState_T {
  public:
   ///The state vector defining the state variables of this EKF.
@@ -82,11 +115,9 @@ struct GenericState_T {
   ///<The enums of the state variables.
   typedef StateDef_T StateDefinition_T;
 
-  friend class msf_core::MSF_Core<
-      GenericState_T<StateSequence_T, StateDefinition_T> >;
+  friend class msf_core::MSF_Core<GenericState_T>;
   friend struct msf_core::CopyNonPropagationStates<GenericState_T>;
-  friend class msf_core::MSF_InitMeasurement<
-      GenericState_T<StateSequence_T, StateDefinition_T> >;
+  friend class msf_core::MSF_InitMeasurement<GenericState_T>;
 
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
   enum {
@@ -106,7 +137,15 @@ struct GenericState_T {
         msf_tmp::PropagatedCoreStateLengthForType>::value,
     /// N total error states with propagation.
     nPropagatedCoreErrorStatesAtCompileTime = msf_tmp::CountStates<
-        StateSequence_T, msf_tmp::PropagatedCoreErrorStateLengthForType>::value
+        StateSequence_T, msf_tmp::PropagatedCoreErrorStateLengthForType>::value,
+    /// Compile time size of P, Eigen::Dynamic for dynamic size storage.
+    nCovarianceDimAtCompileTime =
+        CovarianceStorage == DynamicSizeCovariance ?
+            static_cast<int>(Eigen::Dynamic) :
+            static_cast<int>(nErrorStatesAtCompileTime),
+    /// N quaternion state vars, one rotation matrix cache entry each.
+    nRotationCacheSlotsAtCompileTime = msf_tmp::CountStates<StateSequence_T,
+        msf_tmp::RotationCacheSlotsForType>::value
   };
 
  private:
@@ -127,15 +166,18 @@ struct GenericState_T {
   template<int INDEX>
   inline typename msf_tmp::StripReference<
       typename boost::fusion::result_of::at_c<StateSequence_T, INDEX>::type>::
-      result_t::value_t&
+      result_t::Map_T&
   Get();
 
  public:
-  typedef Eigen::Matrix<double, nErrorStatesAtCompileTime,
-      nErrorStatesAtCompileTime> P_type;  ///< Type of the error state
-                                          // covariance matrix.
+  typedef Eigen::Matrix<double, nCovarianceDimAtCompileTime,
+      nCovarianceDimAtCompileTime> P_type;  ///< Type of the error state
+                                            // covariance matrix.
   typedef P_type F_type;
   typedef P_type Q_type;
+  /// All state variables in the order of the state list. Quaternions are
+  /// stored as their coefficients x, y, z, w.
+  typedef Eigen::Matrix<double, nStatesAtCompileTime, 1> NominalState_T;
 
   StateSequence_T statevars;  ///< The actual state variables.
 
@@ -153,19 +195,49 @@ struct GenericState_T {
   Q_type Qd;   ///< Discrete propagation noise matrix.
 
   GenericState_T() {
+    BindStateVariables();
     time = constants::INVALID_TIME;
-    P.setZero();
-    Qd.setZero();
-    Fd.setIdentity();
+    P.setZero(nErrorStatesAtCompileTime, nErrorStatesAtCompileTime);
+    Qd.setZero(nErrorStatesAtCompileTime, nErrorStatesAtCompileTime);
+    Fd.setIdentity(nErrorStatesAtCompileTime, nErrorStatesAtCompileTime);
     Reset();
   }
 
+  GenericState_T(const GenericState_T& other)
+      : P(other.P),
+        Fd(other.Fd),
+        Qd(other.Qd) {
+    BindStateVariables();
+    CopyNominalState(other);
+  }
+
+  GenericState_T& operator=(const GenericState_T& other) {
+    CopyNominalState(other);
+    P = other.P;
+    Fd = other.Fd;
+    Qd = other.Qd;
+    return *this;
+  }
+
   /**
    * \brief Apply the correction vector to all state vars.
    */
   inline void Correct(
       const Eigen::Matrix<double, nErrorStatesAtCompileTime, 1>& correction);
 
+  /**
+   * \brief Copies the state variables, system inputs, IMU noise and time of
+   * other, but not P, Fd and Qd, which make up most of the state's size.
+   */
+  inline void CopyNominalState(const GenericState_T& other);
+
+  /**
+   * \brief Returns the values of all state variables as one vector.
+   */
+  inline const NominalState_T& GetNominalState() const {
+    return nominal_;
+  }
+
   /**
    * \brief Returns the Q-block of the state at position INDEX in the state list,
    * not allowed for core states.
@@ -195,9 +267,7 @@ struct GenericState_T {
    * Error covariance: zeros.
    */
   void Reset(
-      msf_core::StateVisitor<GenericState_T<StateSequence_T,
-                                            StateDefinition_T> >*
-                                            GetUserCalc = nullptr);
+      msf_core::StateVisitor<GenericState_T>* GetUserCalc = nullptr);
 
   /**
    * \brief Write the covariance corresponding to position and attitude to cov.
@@ -296,9 +366,19 @@ struct GenericState_T {
   template<int INDEX>
   inline const typename msf_tmp::StripReference<
       typename boost::fusion::result_of::at_c<StateSequence_T, INDEX>::type>::
-      result_t::value_t&
+      result_t::Map_T&
   Get() const;
 
+  /**
+   * \brief Returns the rotation matrix of the quaternion state at position
+   * INDEX. It is computed on the first read after the quaternion changed, so
+   * the core and the measurements share it. Use the transpose for the
+   * conjugate quaternion.
+   * \note Not safe for concurrent reads of the same state object.
+   */
+  template<int INDEX>
+  inline const Eigen::Matrix3d& GetRotationMatrix() const;
+
   /**
    * \brief Returns the stateVar at position INDEX in the state list,
    * const version.
@@ -325,20 +405,31 @@ struct GenericState_T {
   template<int INDEX>
   inline void
   ClearCrossCov();
+
+ private:
+  /// Points the state variables to their values in nominal_.
+  inline void BindStateVariables();
+
+  /// The values of the state variables, which are views into it.
+  NominalState_T nominal_;
+  mutable RotationCacheEntry rotation_cache_[nRotationCacheSlotsAtCompileTime];
 };
 
 /**
  * \brief Comparator for the state objects. sorts by time asc.
  */
-template<typename stateSequence_T, typename stateDefinition_T>
+template<typename stateSequence_T, typename stateDefinition_T,
+    int CovarianceStorage = FixedSizeCovariance>
 class SortStates {
  public:
   /**
    * \brief Implements the sorting by time.
    */
   bool operator()(
-      const GenericState_T<stateSequence_T, stateDefinition_T>& lhs,
-      const GenericState_T<stateSequence_T, stateDefinition_T>&rhs) const {
+      const GenericState_T<stateSequence_T, stateDefinition_T,
+          CovarianceStorage>& lhs,
+      const GenericState_T<stateSequence_T, stateDefinition_T,
+          CovarianceStorage>&rhs) const {
     return (lhs.time_ < rhs.time_);
   }
 };
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <slynen at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MSF_STATECOMPOSITION_H_
+#define MSF_STATECOMPOSITION_H_
+
+#include <Eigen/Dense>
+#include <boost/fusion/container.hpp>
+#include <boost/fusion/mpl.hpp>
+#include <boost/mpl/back_inserter.hpp>
+#include <boost/mpl/copy.hpp>
+#include <boost/mpl/vector.hpp>
+#include <msf_core/msf_fwds.h>
+
+namespace msf_core {
+/**
+ * \brief The IMU core states, the first pack of every composed state.
+ *
+ * A state pack is a template on the name of its first state. It names its
+ * states with consecutive values from there, gives the next free name as
+ * nextName and lists its state variables in StateVars_T. See ComposeStates.
+ */
+template<int FirstName>
+struct CoreStatePack {
+  enum {
+    p = FirstName,
+    v,
+    q,
+    b_w,
+    b_a,
+    nextName
+  };
+  // Must not change the ordering here for now, CalcQ has it hardcoded.
+  typedef boost::mpl::vector<
+      /// Translation from the world frame to the IMU frame expressed in the
+      /// world frame.
+      StateVar_T<Eigen::Matrix<double, 3, 1>, p, CoreStateWithPropagation>,
+      /// Velocity of the IMU frame expressed in the world frame.
+      StateVar_T<Eigen::Matrix<double, 3, 1>, v, CoreStateWithPropagation>,
+      /// Rotation from the world frame to the IMU frame expressed in the world
+      /// frame.
+      StateVar_T<Eigen::Quaternion<double>, q, CoreStateWithPropagation>,
+      /// Gyro biases.
+      StateVar_T<Eigen::Matrix<double, 3, 1>, b_w, CoreStateWithoutPropagation>,
+      /// Acceleration biases.
+      StateVar_T<Eigen::Matrix<double, 3, 1>, b_a, CoreStateWithoutPropagation>
+  > StateVars_T;
+};
+
+template<int FirstName, template<int> class ... Packs>
+struct ComposeStatesImpl;
+
+template<int FirstName>
+struct ComposeStatesImpl<FirstName> {
+  typedef boost::mpl::vector<> StateVars_T;
+  struct Definition_T {
+  };
+};
+
+template<int FirstName, template<int> class Pack,
+    template<int> class ... OtherPacks>
+struct ComposeStatesImpl<FirstName, Pack, OtherPacks...> {
+  typedef Pack<FirstName> Head_T;
+  typedef ComposeStatesImpl<Head_T::nextName, OtherPacks...> Tail_T;
+  typedef typename boost::mpl::copy<typename Tail_T::StateVars_T,
+      boost::mpl::back_inserter<typename Head_T::StateVars_T> >::type
+      StateVars_T;
+  struct Definition_T : public Head_T, public Tail_T::Definition_T {
+  };
+};
+
+/**
+ * \brief Composes the state of a filter from the core states and the state
+ * packs of its sensors, so a filter carries exactly the states its sensors
+ * need:
+ *
+ *   typedef msf_core::ComposeStates<msf_core::CoreStatePack,
+ *       PoseSensorStatePack, PressureSensorStatePack> Composition_T;
+ *   typedef Composition_T::StateDefinition StateDefinition;
+ *   typedef Composition_T::StateSequence_T fullState_T;
+ *
+ * The names of the states follow the order of the packs, so the ordering
+ * requirements of GenericState_T hold by construction. Measurements find
+ * their states by name, e.g. StateDefinition::q_ic.
+ * \note The names of the states must be unique across the packs.
+ */
+template<template<int> class ... Packs>
+struct ComposeStates {
+  typedef ComposeStatesImpl<0, Packs...> Impl_T;
+  /// Has the names of the states of all packs as members.
+  typedef typename Impl_T::Definition_T StateDefinition;
+  typedef typename boost::fusion::result_of::as_vector<
+      typename Impl_T::StateVars_T>::type StateSequence_T;
+};
+}  // namespace msf_core
+#endif  // MSF_STATECOMPOSITION_H_
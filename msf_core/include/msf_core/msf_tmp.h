@@ -35,6 +35,7 @@
 #include <sstream>
 #include <iostream>
 #include <iomanip>
+#include <new>
 
 #ifdef FUSION_MAX_VECTOR_SIZE
 #undef FUSION_MAX_VECTOR_SIZE
@@ -456,6 +457,14 @@ struct IsQuaternionType<mpl_::void_> {
   };
 };
 
+// The number of rotation matrix cache entries for a given state var.
+template<typename T>
+struct RotationCacheSlotsForType {
+  enum {
+    value = IsQuaternionType<T>::value ? 1 : 0
+  };
+};
+
 /**
  * \brief Return whether a state is nontemporaldrifting.
  */
@@ -792,6 +801,49 @@ struct ResetState {
   }
 };
 
+/**
+ * \brief Points the state vars to their values in the state array in a boost
+ * fusion unrolled call.
+ */
+template<typename stateList_T>
+struct BindStateStorage {
+  BindStateStorage(double* statearray)
+      : data_(statearray) {
+  }
+  template<typename T, int NAME, int STATE_T, int OPTIONS>
+  void operator()(msf_core::StateVar_T<T, NAME, STATE_T, OPTIONS>& t) const {
+    typedef msf_core::StateVar_T<T, NAME, STATE_T, OPTIONS> var_T;
+    enum {
+      startIdxInState = msf_tmp::GetStartIndex<stateList_T, var_T,
+      // Index of the data in the state vector.
+          msf_tmp::StateLengthForType>::value
+    };
+    // An Eigen::Map can only be pointed elsewhere by constructing it again.
+    new (&t.state_) typename var_T::Map_T(data_ + startIdxInState);
+  }
+ private:
+  double* data_;
+};
+
+/**
+ * \brief Copy the Q-blocks and reset flags, but not the values of the states
+ * in a boost fusion unrolled call.
+ */
+template<typename stateVarT>
+struct CopyStateAttributes {
+  CopyStateAttributes(const stateVarT& oldstate)
+      : oldstate_(oldstate) {
+  }
+  template<typename T, int NAME, int STATE_T, int OPTIONS>
+  void operator()(msf_core::StateVar_T<T, NAME, STATE_T, OPTIONS>& t) const {
+    t.Q = oldstate_.template GetStateVariable<NAME>().Q;
+    t.hasResetValue = oldstate_.template GetStateVariable<NAME>().hasResetValue;
+  }
+
+ private:
+  const stateVarT& oldstate_;
+};
+
 /**
  * \brief Copy states from previous to current states, for which there is no
  * propagation in a boost fusion unrolled call.
@@ -850,14 +902,8 @@ struct CopyNonPropagationStates {
 /**
  * \brief Copy the user calculated values in the Q-blocks to the main Q matrix.
  */
-template<typename stateList_T>
+template<typename stateList_T, typename Q_T>
 struct CopyQBlocksFromAuxiliaryStatesToQ {
-  enum {
-    nErrorStatesAtCompileTime = msf_tmp::CountStates<stateList_T,
-        msf_tmp::CorrectionStateLengthForType>::value  // N correction states.
-  };
-  typedef Eigen::Matrix<double, nErrorStatesAtCompileTime,
-      nErrorStatesAtCompileTime> Q_T;
   CopyQBlocksFromAuxiliaryStatesToQ(Q_T& Q)
       : Q_(Q) { }
   template<typename T, int NAME, int STATE_T, int OPTIONS>
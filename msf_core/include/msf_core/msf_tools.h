@@ -45,6 +45,52 @@ typename Eigen::MatrixBase<D>::Scalar GetMedian(
     return 0;
 }
 
+/***
+ * Mean of the last N values, updated in O(1) per value.
+ */
+template<int N>
+class MovingAverage {
+ public:
+  MovingAverage() {
+    Reset();
+  }
+  void Add(double value) {
+    if (count_ == N) {
+      sum_ -= values_[next_];
+    } else {
+      ++count_;
+    }
+    values_[next_] = value;
+    sum_ += value;
+    next_ = (next_ + 1) % N;
+    // Sum up again once per cycle, so the rounding errors do not accumulate.
+    if (next_ == 0) {
+      sum_ = 0;
+      for (int i = 0; i < count_; ++i)
+        sum_ += values_[i];
+    }
+  }
+  /// The number of values in the window.
+  int Count() const {
+    return count_;
+  }
+  /// Zero if no value was added yet.
+  double Mean() const {
+    return count_ > 0 ? sum_ / count_ : 0;
+  }
+  void Reset() {
+    sum_ = 0;
+    count_ = 0;
+    next_ = 0;
+  }
+
+ private:
+  double values_[N];
+  double sum_;
+  int count_;
+  int next_;  ///< Slot for the next value.
+};
+
 /***
  * Outputs the time in seconds in a human readable format for debugging.
  */
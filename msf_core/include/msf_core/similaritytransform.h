@@ -17,11 +17,13 @@
 #ifndef SIMILARITYTRANSFORM_H_
 #define SIMILARITYTRANSFORM_H_
 
+#include <deque>
 #include <vector>
 #include <utility>
 #include <geometry_msgs/PoseWithCovariance.h>
 #include <Eigen/Core>
 #include <Eigen/Geometry>
+#include <Eigen/StdVector>
 #include <limits>
 
 #include <msf_core/msf_types.h>
@@ -153,6 +155,158 @@ class From6DoF {
  private:
   PosePairVector measurements_;
 };
+
+/** \class NormalEquations
+ *
+ * \brief The sufficient statistics of the similarity transform problem: the
+ * quaternion outer product sum and the 4x4 normal equations of the position
+ * and scale least squares problem. Pose pairs can be added and removed with
+ * a weight, solving is independent of the number of pairs.
+ */
+class NormalEquations {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  NormalEquations();
+  void SetZero();
+  /// Adds weight times the contribution of the pair, negative removes it.
+  void Add(const PosePair & measurement, double weight = 1);
+  /**
+   * \brief Adds the contribution of a pair given by the relative rotation
+   * q = q1^-1 * q2 and the positions v = q1^-1 * t2 and w = q1^-1 * t1.
+   */
+  void Add(const Eigen::Quaterniond & q, const Vector3 & v, const Vector3 & w,
+           double weight = 1);
+  /// Multiplies all accumulated contributions by factor.
+  void Scale(double factor);
+  /// Solves for the similarity transform, see From6DoF::Compute.
+  void Solve(Pose & pose, double *scale, double *cond, double eps) const;
+  /// Solves for position and scale x = [p, s] and the mean rotation q.
+  void Solve(Vector4 & x, Eigen::Quaterniond & q, double *cond,
+             double eps) const;
+ private:
+  Matrix4 M_;  ///< Quaternion outer sum matrix.
+  Matrix4 AtA_;  ///< Position and scale normal equations.
+  Vector4 Atb_;
+};
+
+/** \class From6DoFIncremental
+ *
+ * \brief Computes the same similarity transform as From6DoF, but accumulates
+ * the normal equations as pose pairs arrive. Compute is O(1) regardless of
+ * the number of pairs added. Optionally old pairs are down weighted by an
+ * exponential forgetting factor and/or dropped after a sliding window.
+ */
+class From6DoFIncremental {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  /**
+   * \param forgetting_factor weight in (0, 1] applied to all previous pairs
+   * when a new pair is added, 1 disables forgetting.
+   * \param window_size number of most recent pairs to use, 0 uses all pairs.
+   * The window keeps the pairs in memory to remove them again.
+   */
+  From6DoFIncremental(double forgetting_factor = 1, size_t window_size = 0);
+
+  /// Adds a pair of measurements to the normal equations.
+  void AddMeasurement(const PosePair & measurement);
+
+  /// Adds a pair of measurements to the normal equations.
+  void AddMeasurement(const Pose & pose1, const Pose & pose2);
+
+  /// Removes all measurements.
+  void Reset();
+
+  /// Number of pairs currently contributing to the estimate.
+  size_t NumMeasurements() const {
+    return num_measurements_;
+  }
+
+  /// See From6DoF::Compute.
+  bool Compute(Pose & pose, double *scale = nullptr , double *cond = nullptr ,
+               double eps = std::numeric_limits<double>::epsilon() * 4 * 4)
+      const;
+ private:
+  NormalEquations equations_;
+  double forgetting_factor_;
+  size_t window_size_;
+  /// Weight of the oldest pair in the window when it gets removed.
+  double window_weight_;
+  size_t num_measurements_;
+  std::deque<PosePair> window_;
+  /// Additions since the window was last rebuilt, bounds round off drift.
+  size_t additions_since_rebuild_;
+};
+
+/// Parameters of From6DoFRobust.
+struct RobustOptions {
+  RobustOptions()
+      : position_threshold(0.1),
+        rotation_threshold(0.1),
+        confidence(0.99),
+        max_iterations(1000),
+        local_optimization_iterations(3),
+        num_threads(0),
+        seed(0) {
+  }
+  /// Maximum position residual of an inlier [m], in the frame of pose1.
+  double position_threshold;
+  /// Maximum rotation residual of an inlier [rad].
+  double rotation_threshold;
+  /// Probability to draw at least one outlier free sample.
+  double confidence;
+  int max_iterations;
+  /// Least squares refits on the inliers of every new best hypothesis.
+  int local_optimization_iterations;
+  /// Number of worker threads, 0 uses the number of hardware threads.
+  int num_threads;
+  unsigned int seed;
+};
+
+/** \class From6DoFRobust
+ *
+ * \brief Computes the similarity transform like From6DoF, but robust to
+ * wrong associations: LO-RANSAC over minimal samples of two pose pairs,
+ * hypotheses are evaluated in parallel on several threads. The result is the
+ * least squares fit on the inliers of the best hypothesis.
+ */
+class From6DoFRobust {
+ public:
+  From6DoFRobust(const RobustOptions & options = RobustOptions());
+
+  /// Adds a pair of measurements. No other computation is performed.
+  void AddMeasurement(const PosePair & measurement);
+
+  /// Adds a pair of measurements. No other computation is performed.
+  void AddMeasurement(const Pose & pose1, const Pose & pose2);
+
+  /**
+   * \brief See From6DoF::Compute.
+   * \param[out] inliers indices of the pose pairs in the order they were added
+   * which are consistent with the resulting transform.
+   */
+  bool Compute(Pose & pose, double *scale = nullptr , double *cond = nullptr ,
+               std::vector<size_t> *inliers = nullptr,
+               double eps = std::numeric_limits<double>::epsilon() * 4 * 4);
+ private:
+  /// The pairs in the form used by NormalEquations::Add.
+  struct Terms {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    Eigen::Quaterniond q;
+    Vector3 v;
+    Vector3 w;
+  };
+  typedef std::vector<Terms, Eigen::aligned_allocator<Terms> > TermsVector;
+
+  RobustOptions options_;
+  TermsVector terms_;
+
+  /// Marks the inliers of the transform x, q and returns their number.
+  size_t FindInliers(const Vector4 & x, const Eigen::Quaterniond & q,
+                     std::vector<char> & inliers) const;
+  /// Least squares fit on the inliers.
+  void Fit(const std::vector<char> & inliers, Vector4 & x,
+           Eigen::Quaterniond & q, double *cond, double eps) const;
+};
 }
 }  // namespace msf_core
 #endif  // SIMILARITYTRANSFORM_H_
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <slynen at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/*
+ * Times the covariance products of CovarianceKernels for a range of error
+ * state dimensions and thread counts, to find the dimension from which on
+ * the threads pay off (core/covariance_parallel_min_dimension).
+ *
+ * Usage: benchmark_covariance_kernels [max_threads]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include <msf_core/msf_covariance_kernels.h>
+
+namespace {
+typedef std::chrono::steady_clock Clock;
+
+// Runs the product until at least 0.2 s passed and returns the mean in us.
+template<typename Function>
+double TimeMicroseconds(Function function) {
+  function();  // Warm up.
+  int iterations = 0;
+  const Clock::time_point start = Clock::now();
+  Clock::duration elapsed;
+  do {
+    function();
+    ++iterations;
+    elapsed = Clock::now() - start;
+  } while (elapsed < std::chrono::milliseconds(200));
+  return std::chrono::duration<double, std::micro>(elapsed).count()
+      / iterations;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  int max_threads = std::thread::hardware_concurrency();
+  if (argc > 1)
+    max_threads = std::atoi(argv[1]);
+  if (max_threads < 1)
+    max_threads = 1;
+
+  const int dimensions[] = { 15, 25, 35, 45, 60, 75, 90, 120, 150 };
+  const int num_measurements = 6;
+
+  std::printf("%5s %8s %12s %12s %8s %12s %8s\n", "N", "threads",
+              "F*P*F' [us]", "speedup", "", "P-KSK' [us]", "speedup");
+  for (int n : dimensions) {
+    const Eigen::MatrixXd A = Eigen::MatrixXd::Random(n, n);
+    const Eigen::MatrixXd P0 = A * A.transpose();
+    const Eigen::MatrixXd F = Eigen::MatrixXd::Identity(n, n)
+        + 0.01 * Eigen::MatrixXd::Random(n, n);
+    const Eigen::MatrixXd K = 0.01
+        * Eigen::MatrixXd::Random(n, num_measurements);
+    const Eigen::MatrixXd S = Eigen::MatrixXd::Identity(num_measurements,
+                                                        num_measurements);
+    Eigen::MatrixXd P = P0, tmp(n, n), out(n, n);
+
+    double sandwich_single = 0, outer_single = 0;
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+      msf_core::CovarianceKernels kernels(threads, 0);
+      const double sandwich = TimeMicroseconds([&] {
+        kernels.Sandwich(F, P0, tmp, out);
+      });
+      const double outer = TimeMicroseconds([&] {
+        P = P0;
+        kernels.SubtractOuterProduct(K, S, P);
+      });
+      if (threads == 1) {
+        sandwich_single = sandwich;
+        outer_single = outer;
+      }
+      std::printf("%5d %8d %12.1f %12.2f %8s %12.1f %8.2f\n", n, threads,
+                  sandwich, sandwich_single / sandwich, "", outer,
+                  outer_single / outer);
+    }
+  }
+  return 0;
+}
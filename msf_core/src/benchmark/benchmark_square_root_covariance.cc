@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <slynen at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/*
+ * Times the square-root form of the covariance propagation and update
+ * (core/square_root_covariance) against the standard form for a range of
+ * error state dimensions. A step is one propagation followed by one update,
+ * run back to back as in the filter, so the square-root form carries its
+ * factor over.
+ *
+ * Usage: benchmark_square_root_covariance [num_measurements]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include <msf_core/msf_squarerootcovariance.h>
+
+namespace {
+typedef std::chrono::steady_clock Clock;
+
+// Runs the function until at least 0.2 s passed and returns the mean in us.
+template<typename Function>
+double TimeMicroseconds(Function function) {
+  function();  // Warm up.
+  int iterations = 0;
+  const Clock::time_point start = Clock::now();
+  Clock::duration elapsed;
+  do {
+    function();
+    ++iterations;
+    elapsed = Clock::now() - start;
+  } while (elapsed < std::chrono::milliseconds(200));
+  return std::chrono::duration<double, std::micro>(elapsed).count()
+      / iterations;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  int num_measurements = 6;
+  if (argc > 1)
+    num_measurements = std::atoi(argv[1]);
+  if (num_measurements < 1)
+    num_measurements = 1;
+
+  const int dimensions[] = { 15, 25, 35, 45, 60, 90, 120 };
+
+  std::printf("%5s %15s %14s %8s %15s %8s\n", "N", "standard [us]",
+              "sqrt [us]", "ratio", "sqrt float [us]", "ratio");
+  for (int n : dimensions) {
+    const Eigen::MatrixXd A = Eigen::MatrixXd::Random(n, n);
+    const Eigen::MatrixXd P0 = A * A.transpose()
+        + Eigen::MatrixXd::Identity(n, n);
+    // A rotation, so the covariance stays bounded over the runs.
+    const Eigen::MatrixXd F = Eigen::HouseholderQR<Eigen::MatrixXd>(
+        Eigen::MatrixXd::Identity(n, n)
+            + 0.01 * Eigen::MatrixXd::Random(n, n)).householderQ();
+    // Process noise on the core states only.
+    Eigen::MatrixXd Q = Eigen::MatrixXd::Zero(n, n);
+    Q.diagonal().head(15).setConstant(1e-4);
+    const Eigen::MatrixXd H = Eigen::MatrixXd::Random(num_measurements, n);
+    const Eigen::MatrixXd R = 1e-2
+        * Eigen::MatrixXd::Identity(num_measurements, num_measurements);
+    Eigen::MatrixXd P = P0, P_new(n, n), tmp(n, n), KH(n, n);
+
+    const double standard = TimeMicroseconds([&] {
+      tmp.noalias() = F * P;
+      P.noalias() = tmp * F.transpose();
+      P += Q;
+      const Eigen::MatrixXd S = H * P * H.transpose() + R;
+      const Eigen::MatrixXd K = P * H.transpose() * S.inverse();
+      KH.setIdentity();
+      KH.noalias() -= K * H;
+      tmp.noalias() = KH * P;
+      P.noalias() = tmp * KH.transpose();
+      P.noalias() += K * R * K.transpose();
+      P = 0.5 * (P + P.transpose());
+    });
+
+    double square_root_time[2];
+    for (int single_precision = 0; single_precision < 2; ++single_precision) {
+      msf_core::SquareRootCovariance<Eigen::MatrixXd> square_root;
+      square_root.Resize(n);
+      square_root.SetSinglePrecision(single_precision);
+      P = P0;
+      square_root_time[single_precision] = TimeMicroseconds([&] {
+        square_root.Propagate(F, P, Q, P_new);
+        P.swap(P_new);
+        const Eigen::MatrixXd S = H * P * H.transpose() + R;
+        const Eigen::MatrixXd K = P * H.transpose() * S.inverse();
+        square_root.Downdate(K * S.llt().matrixL(), P);
+      });
+    }
+    std::printf("%5d %15.1f %14.1f %8.2f %15.1f %8.2f\n", n, standard,
+                square_root_time[0], square_root_time[0] / standard,
+                square_root_time[1], square_root_time[1] / standard);
+  }
+  return 0;
+}
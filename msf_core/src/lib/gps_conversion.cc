@@ -15,17 +15,35 @@
  * limitations under the License.
  */
 #include <msf_core/gps_conversion.h>
+
+#include <cmath>
+
 #include <msf_core/msf_macros.h>
 #include <ros/ros.h>
-#include <msf_core/sincos.h>
 
 namespace msf_core {
 
+namespace {
+const double a = 6378137.0;  // semi-major axis
+const double e_sq = 6.69437999014e-3;  // first eccentricity squared
+const double b = a * sqrt(1 - e_sq);  // semi-minor axis
+const double ep_sq = e_sq / (1 - e_sq);  // second eccentricity squared
+const double defaultLocalApproximationRadius = 1000;
+}
+
 GPSConversion::GPSConversion()
-  : ecef_ref_orientation_(),
-    ecef_ref_point_(msf_core::Vector3::Zero())
+  : ecef_ref_rotation_(msf_core::Matrix3::Identity()),
+    ecef_ref_point_(msf_core::Vector3::Zero()),
+    wgs84_ref_point_(msf_core::Vector3::Zero()),
+    local_north_scale_(0),
+    local_east_scale_(0),
+    local_prime_radius_(0),
+    local_s_lat_(0),
+    local_c_lat_(1),
+    local_offset_(msf_core::Vector3::Zero()),
+    local_radius_(defaultLocalApproximationRadius),
+    local_max_error_(0)
 {
-  ecef_ref_orientation_.setIdentity();
 }
 
 GPSConversion::~GPSConversion() {}
@@ -33,10 +51,11 @@ GPSConversion::~GPSConversion() {}
 void GPSConversion::InitReference(const double latitude,
                                   const double longitude,
                                   const double altitude) {
-  msf_core::Matrix3 R;
-  double s_long, s_lat, c_long, c_lat;
-  sincos(latitude * DEG2RAD, &s_lat, &c_lat);
-  sincos(longitude * DEG2RAD, &s_long, &c_long);
+  msf_core::Matrix3& R = ecef_ref_rotation_;
+  const double s_lat = std::sin(latitude * DEG2RAD);
+  const double c_lat = std::cos(latitude * DEG2RAD);
+  const double s_long = std::sin(longitude * DEG2RAD);
+  const double c_long = std::cos(longitude * DEG2RAD);
 
   R(0, 0) = -s_long;
   R(0, 1) = c_long;
@@ -50,20 +69,30 @@ void GPSConversion::InitReference(const double latitude,
   R(2, 1) = c_lat * s_long;
   R(2, 2) = s_lat;
 
-  ecef_ref_orientation_ = msf_core::Quaternion(R);
-
   ecef_ref_point_ = WGS84ToECEF(latitude, longitude, altitude);
+  wgs84_ref_point_ << latitude, longitude, altitude;
+
+  // Radii of curvature in the meridian (M) and prime vertical (N).
+  const double w_sq = 1 - e_sq * s_lat * s_lat;
+  const double N = a / sqrt(w_sq);
+  const double M = N * (1 - e_sq) / w_sq;
+  local_north_scale_ = M + altitude;
+  local_east_scale_ = (N + altitude) * c_lat;
+  local_prime_radius_ = N + altitude;
+  local_s_lat_ = s_lat;
+  local_c_lat_ = c_lat;
+  local_offset_.setZero();
+
+  EvaluateLocalApproximationError();
 }
 
 msf_core::Vector3 GPSConversion::WGS84ToECEF(const double latitude,
                                              const double longitude,
                                              const double altitude) const {
-  const double a = 6378137.0;  // semi-major axis
-  const double e_sq = 6.69437999014e-3;  // first eccentricity squared
-
-  double s_long, s_lat, c_long, c_lat;
-  sincos(latitude * DEG2RAD, &s_lat, &c_lat);
-  sincos(longitude * DEG2RAD, &s_long, &c_long);
+  const double s_lat = std::sin(latitude * DEG2RAD);
+  const double c_lat = std::cos(latitude * DEG2RAD);
+  const double s_long = std::sin(longitude * DEG2RAD);
+  const double c_long = std::cos(longitude * DEG2RAD);
 
   const double N = a / sqrt(1 - e_sq * s_lat * s_lat);
 
@@ -82,7 +111,7 @@ msf_core::Vector3 GPSConversion::ECEFToENU(const msf_core::Vector3& ecef) const
     MSF_ERROR_STREAM_ONCE(
         "The gps reference is not initialized. Returning global coordinates. This warning will only show once.");
   }
-  return ecef_ref_orientation_ * (ecef - ecef_ref_point_);
+  return ecef_ref_rotation_ * (ecef - ecef_ref_point_);
 }
 
 msf_core::Vector3 GPSConversion::WGS84ToENU(const double latitude,
@@ -92,10 +121,138 @@ msf_core::Vector3 GPSConversion::WGS84ToENU(const double latitude,
     return this->ECEFToENU(ecef);
 }
 
+void GPSConversion::WGS84ToENU(const WGS84Points& wgs84,
+                               CartesianPoints& enu) const {
+  if (ecef_ref_point_.norm() == 0) {
+    MSF_ERROR_STREAM_ONCE(
+        "The gps reference is not initialized. Returning global coordinates. This warning will only show once.");
+  }
+  enu.resize(3, wgs84.cols());
+  for (int i = 0; i < wgs84.cols(); ++i) {
+    const double s_lat = std::sin(wgs84(0, i) * DEG2RAD);
+    const double c_lat = std::cos(wgs84(0, i) * DEG2RAD);
+    const double s_long = std::sin(wgs84(1, i) * DEG2RAD);
+    const double c_long = std::cos(wgs84(1, i) * DEG2RAD);
+
+    const double N = a / sqrt(1 - e_sq * s_lat * s_lat);
+    const double N_alt_c_lat = (N + wgs84(2, i)) * c_lat;
+
+    const msf_core::Vector3 d_ecef(
+        N_alt_c_lat * c_long - ecef_ref_point_[0],
+        N_alt_c_lat * s_long - ecef_ref_point_[1],
+        (N * (1 - e_sq) + wgs84(2, i)) * s_lat - ecef_ref_point_[2]);
+    enu.col(i).noalias() = ecef_ref_rotation_ * d_ecef;
+  }
+}
+
+msf_core::Vector3 GPSConversion::ENUToECEF(const msf_core::Vector3& enu) const {
+  return ecef_ref_rotation_.transpose() * enu + ecef_ref_point_;
+}
+
+msf_core::Vector3 GPSConversion::ECEFToWGS84(
+    const msf_core::Vector3& ecef) const {
+  const double p = sqrt(ecef[0] * ecef[0] + ecef[1] * ecef[1]);
+  const double theta = atan2(ecef[2] * a, p * b);
+  const double s_theta = std::sin(theta);
+  const double c_theta = std::cos(theta);
+
+  const double latitude = atan2(
+      ecef[2] + ep_sq * b * s_theta * s_theta * s_theta,
+      p - e_sq * a * c_theta * c_theta * c_theta);
+  const double longitude = atan2(ecef[1], ecef[0]);
+
+  const double s_lat = std::sin(latitude);
+  const double c_lat = std::cos(latitude);
+  const double N = a / sqrt(1 - e_sq * s_lat * s_lat);
+  // Use the better conditioned expression away from the equator.
+  const double altitude =
+      fabs(c_lat) > 1e-6 ? p / c_lat - N : ecef[2] / s_lat - N * (1 - e_sq);
+
+  return (msf_core::Vector3() << latitude / DEG2RAD, longitude / DEG2RAD,
+      altitude).finished();
+}
+
+msf_core::Vector3 GPSConversion::ENUToWGS84(const msf_core::Vector3& enu) const {
+  return ECEFToWGS84(ENUToECEF(enu));
+}
+
+void GPSConversion::ENUToWGS84(const CartesianPoints& enu,
+                               WGS84Points& wgs84) const {
+  const CartesianPoints ecef = (ecef_ref_rotation_.transpose() * enu)
+      .colwise() + ecef_ref_point_;
+  wgs84.resize(3, enu.cols());
+  for (int i = 0; i < ecef.cols(); ++i) {
+    wgs84.col(i) = ECEFToWGS84(ecef.col(i));
+  }
+}
+
+void GPSConversion::SetLocalApproximationRadius(double radius) {
+  local_radius_ = radius;
+  if (ecef_ref_point_.norm() != 0)
+    EvaluateLocalApproximationError();
+}
+
+void GPSConversion::EvaluateLocalApproximationError() {
+  // The approximation error grows with the distance to the reference, so
+  // sampling the boundary of the operating area bounds it.
+  const int nBearings = 16;
+  const double altitudes[] = { -100, 0, 100 };
+  local_max_error_ = 0;
+  for (int i = 0; i < nBearings; ++i) {
+    const double s = std::sin(2 * M_PI * i / nBearings);
+    const double c = std::cos(2 * M_PI * i / nBearings);
+    for (size_t j = 0; j < sizeof(altitudes) / sizeof(altitudes[0]); ++j) {
+      const msf_core::Vector3 enu(local_radius_ * c, local_radius_ * s,
+                                  altitudes[j]);
+      const msf_core::Vector3 wgs84 = ENUToWGS84(enu);
+      const double error = (WGS84ToENULocal(wgs84[0], wgs84[1], wgs84[2])
+          - WGS84ToENU(wgs84[0], wgs84[1], wgs84[2])).norm();
+      local_max_error_ = std::max(local_max_error_, error);
+    }
+  }
+  MSF_INFO_STREAM(
+      "GPS local tangent plane approximation error within "<< local_radius_
+      << " m of the reference: " << local_max_error_ << " m");
+}
+
+msf_core::Vector3 GPSConversion::WGS84ToENULocal(const double latitude,
+                                                 const double longitude,
+                                                 const double altitude) const {
+  const double d_lat = (latitude - wgs84_ref_point_[0]) * DEG2RAD;
+  const double d_long = (longitude - wgs84_ref_point_[1]) * DEG2RAD;
+  const double d_alt = altitude - wgs84_ref_point_[2];
+
+  // First order terms.
+  const double east = d_long * local_east_scale_;
+  const double north = d_lat * local_north_scale_;
+
+  // Second order terms: convergence of the meridians and earth curvature,
+  // using d(N cos(lat)) / d(lat) = -M sin(lat).
+  msf_core::Vector3 enu;
+  enu[0] = east + d_long * (local_c_lat_ * d_alt - north * local_s_lat_);
+  enu[1] = north + d_lat * d_alt
+      + 0.5 * d_long * d_long * local_prime_radius_ * local_s_lat_
+          * local_c_lat_;
+  enu[2] = d_alt
+      - 0.5 * (east * east / local_prime_radius_
+          + north * north / local_north_scale_);
+  return enu + local_offset_;
+}
+
+void GPSConversion::WGS84ToENULocal(const WGS84Points& wgs84,
+                                    CartesianPoints& enu) const {
+  enu.resize(3, wgs84.cols());
+  for (int i = 0; i < wgs84.cols(); ++i) {
+    enu.col(i) = WGS84ToENULocal(wgs84(0, i), wgs84(1, i), wgs84(2, i));
+  }
+}
+
 void GPSConversion::AdjustReference(const double z_correction) {
 
   MSF_WARN_STREAM("z-ref old: "<< ecef_ref_point_(2));
   ecef_ref_point_(2) += z_correction;
+  // Keep the local approximation consistent with the shifted reference.
+  local_offset_ -= ecef_ref_rotation_.col(2) * z_correction;
   MSF_WARN_STREAM("z-ref new: "<< ecef_ref_point_(2));
 }
 
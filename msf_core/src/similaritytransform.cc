@@ -16,6 +16,14 @@
  */
 #include <msf_core/similaritytransform.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <mutex>
+#include <random>
+#include <thread>
+
 #include <Eigen/Eigenvalues>
 
 namespace msf_core {
@@ -31,51 +39,86 @@ void From6DoF::AddMeasurement(const Pose & pose1, const Pose & pose2) {
 }
 
 bool From6DoF::Compute(Pose & pose, double *scale, double *cond, double eps) {
-  const int n = 4;  // Number of parameters we need to optimize.
   const int m = measurements_.size();
 
   if (m < 2)
     return false;
 
-  Matrix4 M(Matrix4::Zero());  // Quaternion outer sum matrix.
-  // Matrix collecting the measurements for position and scale.
-  Eigen::Matrix<double, Eigen::Dynamic, n> A;
-  A.resize(m * 3, Eigen::NoChange);
-
-  Eigen::Matrix<double, Eigen::Dynamic, 1> b;
-  b.resize(m * 3, Eigen::NoChange);
-
+  NormalEquations equations;
   for (int i = 0; i < m; i++) {
-    // Quaternion averaging.
-    const PosePair & pp = measurements_[i];
-    const Eigen::Quaterniond q1 = GeometryMsgsToEigen(
-        pp.first.pose.orientation);
-    const Eigen::Quaterniond q2 = GeometryMsgsToEigen(
-        pp.second.pose.orientation);
-    Eigen::Quaterniond q(q1.inverse() * q2);
-    M += q.coeffs() * q.coeffs().transpose();  // Order is x y z w here !!!
-
-        //
-    const Vector3 t1 = GeometryMsgsToEigen(pp.first.pose.position);
-    const Vector3 t2 = GeometryMsgsToEigen(pp.second.pose.position);
-
-    A.block<3, 3>(i * 3, 0) = Eigen::Matrix<double, 3, 3>::Identity() * -1;
-    A.block<3, 1>(i * 3, 3) = q1.inverse() * t2;
-    b.block<3, 1>(i * 3, 0) = q1.inverse() * t1;
+    equations.Add(measurements_[i]);
   }
+  equations.Solve(pose, scale, cond, eps);
+
+  return true;
+}
+
+NormalEquations::NormalEquations() {
+  SetZero();
+}
+
+void NormalEquations::SetZero() {
+  M_.setZero();
+  AtA_.setZero();
+  Atb_.setZero();
+}
+
+void NormalEquations::Add(const PosePair & pp, double weight) {
+  const Eigen::Quaterniond q1 = GeometryMsgsToEigen(pp.first.pose.orientation);
+  const Eigen::Quaterniond q2 = GeometryMsgsToEigen(
+      pp.second.pose.orientation);
+  const Vector3 t1 = GeometryMsgsToEigen(pp.first.pose.position);
+  const Vector3 t2 = GeometryMsgsToEigen(pp.second.pose.position);
+  Add(q1.inverse() * q2, q1.inverse() * t2, q1.inverse() * t1, weight);
+}
+
+void NormalEquations::Add(const Eigen::Quaterniond & q, const Vector3 & v,
+                          const Vector3 & w, double weight) {
+  // Quaternion averaging.
+  M_ += weight * q.coeffs() * q.coeffs().transpose();  // Order is x y z w here !!!
+
+  // Every pair contributes the rows A_i = [-I, v], b_i = w to the position
+  // and scale problem. Accumulate A_i' * A_i and A_i' * b_i.
+  AtA_.block<3, 3>(0, 0) += weight * Matrix3::Identity();
+  AtA_.block<3, 1>(0, 3) -= weight * v;
+  AtA_.block<1, 3>(3, 0) -= weight * v.transpose();
+  AtA_(3, 3) += weight * v.squaredNorm();
+  Atb_.head<3>() -= weight * w;
+  Atb_(3) += weight * v.dot(w);
+}
+
+void NormalEquations::Scale(double factor) {
+  M_ *= factor;
+  AtA_ *= factor;
+  Atb_ *= factor;
+}
+
+void NormalEquations::Solve(Pose & pose, double *scale, double *cond,
+                            double eps) const {
+  Vector4 x;
+  Eigen::Quaterniond q_mean;
+  Solve(x, q_mean, cond, eps);
+
+  if (scale)
+    *scale = x[3];
+
+  pose.pose.position = EigenToGeometryMsgs(x.block<3, 1>(0, 0));
+  pose.pose.orientation = EigenToGeometryMsgs(q_mean);
+}
+
+void NormalEquations::Solve(Vector4 & x, Eigen::Quaterniond & q_mean,
+                            double *cond, double eps) const {
+  const int n = 4;  // Number of parameters we need to optimize.
 
   // Mean quaternion.
-  Eigen::SelfAdjointEigenSolver < Eigen::Matrix<double, 4, 4> > q_solver(M);
+  Eigen::SelfAdjointEigenSolver < Eigen::Matrix<double, 4, 4> > q_solver(M_);
   // Eigenvalues/vectors are sorted in increasing order here ...
-  Eigen::Quaterniond q_mean = Eigen::Quaterniond(
-      q_solver.eigenvectors().col(3));
+  q_mean = Eigen::Quaterniond(q_solver.eigenvectors().col(3));
 
   // Mean position and scale.
-  Matrix4 A_hat = A.transpose() * A;
   Matrix4 S_hat(Matrix4::Zero());
-  Vector4 b_hat = A.transpose() * b;
 
-  Eigen::JacobiSVD<Matrix4> svd(A_hat,
+  Eigen::JacobiSVD<Matrix4> svd(AtA_,
                                 Eigen::ComputeFullU | Eigen::ComputeFullV);
   for (int i = 0; i < n; i++) {
     if (svd.singularValues()[i] < eps)
@@ -86,13 +129,224 @@ bool From6DoF::Compute(Pose & pose, double *scale, double *cond, double eps) {
   if (cond)
     *cond = svd.singularValues()[0] / svd.singularValues()[n - 1];
 
-  Vector4 x = svd.matrixV() * S_hat * svd.matrixU().transpose() * b_hat;
+  x = svd.matrixV() * S_hat * svd.matrixU().transpose() * Atb_;
+}
+
+From6DoFIncremental::From6DoFIncremental(double forgetting_factor,
+                                         size_t window_size)
+    : forgetting_factor_(forgetting_factor),
+      window_size_(window_size),
+      window_weight_(std::pow(forgetting_factor, window_size)),
+      num_measurements_(0),
+      additions_since_rebuild_(0) {
+  assert(forgetting_factor > 0 && forgetting_factor <= 1);
+}
+
+void From6DoFIncremental::Reset() {
+  equations_.SetZero();
+  window_.clear();
+  num_measurements_ = 0;
+  additions_since_rebuild_ = 0;
+}
+
+void From6DoFIncremental::AddMeasurement(const Pose & pose1,
+                                         const Pose & pose2) {
+  AddMeasurement(PosePair(pose1, pose2));
+}
+
+void From6DoFIncremental::AddMeasurement(const PosePair & measurement) {
+  if (forgetting_factor_ != 1)
+    equations_.Scale(forgetting_factor_);
+  equations_.Add(measurement);
+
+  if (window_size_ == 0) {
+    ++num_measurements_;
+    return;
+  }
+
+  window_.push_back(measurement);
+  if (window_.size() > window_size_) {
+    equations_.Add(window_.front(), -window_weight_);
+    window_.pop_front();
+  }
+  num_measurements_ = window_.size();
+
+  // Removing pairs by subtraction accumulates round off, so rebuild from the
+  // window once per window length; this keeps the cost O(1) amortized.
+  if (++additions_since_rebuild_ >= window_size_) {
+    equations_.SetZero();
+    double weight = 1;
+    for (std::deque<PosePair>::const_reverse_iterator it = window_.rbegin();
+        it != window_.rend(); ++it) {
+      equations_.Add(*it, weight);
+      weight *= forgetting_factor_;
+    }
+    additions_since_rebuild_ = 0;
+  }
+}
+
+bool From6DoFIncremental::Compute(Pose & pose, double *scale, double *cond,
+                                  double eps) const {
+  if (num_measurements_ < 2)
+    return false;
+
+  equations_.Solve(pose, scale, cond, eps);
+  return true;
+}
+
+From6DoFRobust::From6DoFRobust(const RobustOptions & options)
+    : options_(options) { }
+
+void From6DoFRobust::AddMeasurement(const PosePair & pp) {
+  const Eigen::Quaterniond q1 = GeometryMsgsToEigen(pp.first.pose.orientation);
+  const Eigen::Quaterniond q2 = GeometryMsgsToEigen(
+      pp.second.pose.orientation);
+  Terms terms;
+  terms.q = q1.inverse() * q2;
+  terms.v = q1.inverse() * GeometryMsgsToEigen(pp.second.pose.position);
+  terms.w = q1.inverse() * GeometryMsgsToEigen(pp.first.pose.position);
+  terms_.push_back(terms);
+}
+
+void From6DoFRobust::AddMeasurement(const Pose & pose1, const Pose & pose2) {
+  AddMeasurement(PosePair(pose1, pose2));
+}
+
+size_t From6DoFRobust::FindInliers(const Vector4 & x,
+                                   const Eigen::Quaterniond & q,
+                                   std::vector<char> & inliers) const {
+  const Vector3 p = x.head<3>();
+  const double s = x[3];
+  const double max_position_sq = options_.position_threshold
+      * options_.position_threshold;
+  // |q_i . q| = cos(angle / 2), compare without calling acos per pair.
+  const double min_cos_half = cos(options_.rotation_threshold / 2);
+
+  size_t count = 0;
+  for (size_t i = 0; i < terms_.size(); ++i) {
+    const Terms & t = terms_[i];
+    const bool inlier = (s * t.v - p - t.w).squaredNorm() <= max_position_sq
+        && std::abs(t.q.coeffs().dot(q.coeffs())) >= min_cos_half;
+    inliers[i] = inlier;
+    count += inlier;
+  }
+  return count;
+}
+
+void From6DoFRobust::Fit(const std::vector<char> & inliers, Vector4 & x,
+                         Eigen::Quaterniond & q, double *cond,
+                         double eps) const {
+  NormalEquations equations;
+  for (size_t i = 0; i < terms_.size(); ++i) {
+    if (inliers[i])
+      equations.Add(terms_[i].q, terms_[i].v, terms_[i].w);
+  }
+  equations.Solve(x, q, cond, eps);
+}
+
+bool From6DoFRobust::Compute(Pose & pose, double *scale, double *cond,
+                             std::vector<size_t> *inliers, double eps) {
+  const size_t m = terms_.size();
+
+  if (m < 2)
+    return false;
+
+  int num_threads = options_.num_threads;
+  if (num_threads <= 0)
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  num_threads = std::max(1, std::min(num_threads, options_.max_iterations));
+
+  // Shared between the workers. The number of required iterations shrinks
+  // as better hypotheses are found.
+  std::mutex best_mutex;
+  size_t best_count = 0;
+  std::vector<char> best_inliers(m, 0);
+  std::atomic<int> next_iteration(0);
+  std::atomic<int> required_iterations(options_.max_iterations);
+
+  auto worker = [&](int thread_index) {
+    std::mt19937 rng(options_.seed + thread_index);
+    std::uniform_int_distribution<size_t> first(0, m - 1);
+    std::uniform_int_distribution<size_t> second(0, m - 2);
+    std::vector<char> hypothesis_inliers(m);
+    std::vector<char> refined_inliers(m);
+
+    while (next_iteration++ < required_iterations) {
+      // Minimal sample: two distinct pairs determine position and scale.
+      const size_t i = first(rng);
+      size_t j = second(rng);
+      if (j >= i)
+        ++j;
+
+      NormalEquations equations;
+      equations.Add(terms_[i].q, terms_[i].v, terms_[i].w);
+      equations.Add(terms_[j].q, terms_[j].v, terms_[j].w);
+      Vector4 x;
+      Eigen::Quaterniond q;
+      equations.Solve(x, q, nullptr, eps);
+
+      size_t count = FindInliers(x, q, hypothesis_inliers);
+      {
+        std::lock_guard<std::mutex> lock(best_mutex);
+        if (count <= best_count)
+          continue;
+      }
+
+      // Local optimization: refit on the inliers while their number grows.
+      for (int k = 0; k < options_.local_optimization_iterations; ++k) {
+        Fit(hypothesis_inliers, x, q, nullptr, eps);
+        const size_t refined_count = FindInliers(x, q, refined_inliers);
+        if (refined_count <= count)
+          break;
+        count = refined_count;
+        hypothesis_inliers.swap(refined_inliers);
+      }
+
+      std::lock_guard<std::mutex> lock(best_mutex);
+      if (count <= best_count)
+        continue;
+      best_count = count;
+      best_inliers = hypothesis_inliers;
+
+      const double inlier_ratio = static_cast<double>(count) / m;
+      const double p_good_sample = inlier_ratio * inlier_ratio;
+      if (p_good_sample >= 1) {
+        required_iterations = 0;
+      } else {
+        const double needed = log(1 - options_.confidence)
+            / log(1 - p_good_sample);
+        if (needed < required_iterations)
+          required_iterations = static_cast<int>(std::ceil(needed));
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int t = 1; t < num_threads; ++t)
+    threads.push_back(std::thread(worker, t));
+  worker(0);
+  for (std::thread & thread : threads)
+    thread.join();
+
+  if (best_count < 2)
+    return false;
+
+  Vector4 x;
+  Eigen::Quaterniond q;
+  Fit(best_inliers, x, q, cond, eps);
+
   if (scale)
     *scale = x[3];
-
   pose.pose.position = EigenToGeometryMsgs(x.block<3, 1>(0, 0));
-  pose.pose.orientation = EigenToGeometryMsgs(q_mean);
+  pose.pose.orientation = EigenToGeometryMsgs(q);
 
+  if (inliers) {
+    inliers->clear();
+    for (size_t i = 0; i < m; ++i) {
+      if (best_inliers[i])
+        inliers->push_back(i);
+    }
+  }
   return true;
 }
 }
@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <slynen at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <msf_core/msf_core.h>
+#include <msf_core/msf_IMUHandler.h>
+#include <msf_core/msf_sensormanager.h>
+#include <msf_core/msf_statecomposition.h>
+#include <msf_core/testing_entrypoint.h>
+
+namespace {
+typedef msf_core::ComposeStates<msf_core::CoreStatePack> Composition_T;
+typedef Composition_T::StateDefinition StateDefinition_T;
+typedef msf_core::GenericState_T<Composition_T::StateSequence_T,
+    StateDefinition_T> EKFState_T;
+
+enum {
+  nErrorStates = EKFState_T::nErrorStatesAtCompileTime,
+  /// The position is the first core state.
+  idxErrorState_p = 0
+};
+
+const double kImuPeriod = 0.005;
+const double kMeasurementPeriod = 0.05;
+/// Offset of the measurements from the IMU readings [s].
+const double kMeasurementOffset = 0.0025;
+const double kMeasurementDelay = 0.03;
+const double kMeasurementStddev = 0.001;
+const double kSmootherLag = 0.2;
+
+struct SmoothedPosition {
+  double time;
+  Eigen::Vector3d p;
+};
+
+class Manager : public msf_core::MSF_SensorManager<EKFState_T> {
+ public:
+  void Init(double /*scale*/) const {
+  }
+  void ResetState(EKFState_T& /*state*/) const {
+  }
+  void InitState(EKFState_T& /*state*/) const {
+  }
+  void CalculateQAuxiliaryStates(EKFState_T& /*state*/, double /*dt*/) const {
+  }
+  void SetStateCovariance(EKFState_T::P_type& /*P*/) const {
+  }
+  void AugmentCorrectionVector(
+      Eigen::Matrix<double, nErrorStates, 1>& /*correction*/) const {
+  }
+  void SanityCheckCorrection(
+      EKFState_T& /*delaystate*/, const EKFState_T& /*buffstate*/,
+      Eigen::Matrix<double, nErrorStates, 1>& /*correction*/) const {
+  }
+  bool GetParamFixedBias() const {
+    return false;
+  }
+  double GetParamNoiseAcc() const {
+    return 0.083;
+  }
+  double GetParamNoiseAccbias() const {
+    return 0.0083;
+  }
+  double GetParamNoiseGyr() const {
+    return 0.0013;
+  }
+  double GetParamNoiseGyrbias() const {
+    return 0.00013;
+  }
+  double GetParamFuzzyTrackingThreshold() const {
+    return 0.1;
+  }
+  double GetParamMaxProcessingLag() const {
+    return 0;
+  }
+  void PublishStateInitial(const shared_ptr<EKFState_T>& /*state*/) const {
+  }
+  void PublishStateAfterPropagation(
+      const shared_ptr<EKFState_T>& /*state*/) const {
+  }
+  void PublishStateAfterUpdate(const shared_ptr<EKFState_T>& /*state*/) const {
+  }
+  void PublishSmoothedState(const shared_ptr<EKFState_T>& state) const {
+    const EKFState_T& state_const = *state;
+    SmoothedPosition smoothed;
+    smoothed.time = state->time;
+    smoothed.p = state_const.Get<StateDefinition_T::p>();
+    std::lock_guard<std::mutex> lock(mutex_);
+    smoothed_.push_back(smoothed);
+  }
+
+  mutable std::mutex mutex_;
+  mutable std::vector<SmoothedPosition> smoothed_;
+};
+
+class IMUHandler : public msf_core::IMUHandler<EKFState_T> {
+ public:
+  IMUHandler(Manager& manager)
+      : msf_core::IMUHandler<EKFState_T>(manager, "", "") {
+  }
+  virtual bool Initialize() {
+    return true;
+  }
+};
+
+/// Absolute measurement of the position of the IMU.
+class PositionMeasurement : public msf_core::MSF_MeasurementBase<EKFState_T> {
+ public:
+  PositionMeasurement(const Eigen::Vector3d& z, double time)
+      : msf_core::MSF_MeasurementBase<EKFState_T>(true, 0),
+        z_(z) {
+    this->time = time;
+  }
+  virtual void Apply(shared_ptr<EKFState_T> state,
+                     msf_core::MSF_Core<EKFState_T>& core) {
+    Eigen::Matrix<double, 3, nErrorStates> H;
+    H.setZero();
+    H.block<3, 3>(0, idxErrorState_p).setIdentity();
+    const EKFState_T& state_const = *state;
+    const Eigen::Vector3d residual = z_
+        - state_const.Get<StateDefinition_T::p>();
+    const Eigen::Matrix3d R = Eigen::Matrix3d::Identity()
+        * kMeasurementStddev * kMeasurementStddev;
+    this->CalculateAndApplyCorrection(state, core, H, residual, R);
+  }
+  virtual std::string Type() {
+    return "position";
+  }
+ private:
+  Eigen::Vector3d z_;
+};
+
+/**
+ * Runs the filter on a robot standing at the origin, which starts 0.1 m off.
+ * The position measurements arrive delayed, but well within the lag of the
+ * smoother.
+ */
+void RunStandingStill(bool virtual_states,
+                      std::vector<SmoothedPosition>& smoothed,
+                      double& time_first_measurement) {
+  Manager manager;
+  IMUHandler imu_handler(manager);
+  msf_core::MSF_Core<EKFState_T>& core = *manager.msf_core_;
+  core.SetVirtualMeasurementStates(virtual_states);
+  core.SetSmootherLag(kSmootherLag);
+
+  const double t0 = 1000;
+  const Eigen::Vector3d g(0, 0, 9.81);
+  shared_ptr<msf_core::MSF_InitMeasurement<EKFState_T> > init(
+      new msf_core::MSF_InitMeasurement<EKFState_T>(true));
+  init->time = t0;
+  init->SetStateInitValue<StateDefinition_T::p>(Eigen::Vector3d(0.1, 0, 0));
+  init->SetStateInitValue<StateDefinition_T::v>(Eigen::Vector3d::Zero());
+  init->SetStateInitValue<StateDefinition_T::q>(
+      Eigen::Quaterniond::Identity());
+  init->SetStateInitValue<StateDefinition_T::b_w>(Eigen::Vector3d::Zero());
+  init->SetStateInitValue<StateDefinition_T::b_a>(Eigen::Vector3d::Zero());
+  init->Getw_m().setZero();
+  init->Geta_m() = g;
+  core.Init(init);
+
+  time_first_measurement = t0 + kMeasurementPeriod + kMeasurementOffset;
+  double next_measurement = time_first_measurement;
+  const int num_imu = static_cast<int>(2.0 / kImuPeriod);
+  for (int i = 1; i <= num_imu; ++i) {
+    const double t = t0 + i * kImuPeriod;
+    imu_handler.ProcessIMU(g, Eigen::Vector3d::Zero(), t, i);
+    if (t >= next_measurement + kMeasurementDelay) {
+      core.AddMeasurement(shared_ptr<PositionMeasurement>(
+          new PositionMeasurement(Eigen::Vector3d::Zero(), next_measurement)));
+      next_measurement += kMeasurementPeriod;
+    }
+  }
+  core.FlushSmoother();
+  std::lock_guard<std::mutex> lock(manager.mutex_);
+  smoothed = manager.smoothed_;
+}
+
+void ExpectSmoothedStatesCorrected(bool virtual_states) {
+  std::vector<SmoothedPosition> smoothed;
+  double time_first_measurement;
+  RunStandingStill(virtual_states, smoothed, time_first_measurement);
+  ASSERT_GT(smoothed.size(), 100u);
+  for (size_t i = 0; i < smoothed.size(); ++i) {
+    if (i > 0) {
+      EXPECT_GT(smoothed[i].time, smoothed[i - 1].time);
+    }
+    // The first measurement corrects the 0.1 m offset. A copy of a state
+    // taken before the update would still be off.
+    if (smoothed[i].time >= time_first_measurement) {
+      EXPECT_LT(smoothed[i].p.norm(), 0.01) << "at "
+          << smoothed[i].time - time_first_measurement
+          << " s after the first measurement";
+    }
+  }
+}
+}  // namespace
+
+// Tests that the smoothed states contain the delayed measurements.
+TEST(MSF_Core, SmootherIncludesDelayedMeasurements) {
+  ros::Time::init();
+  ExpectSmoothedStatesCorrected(false);
+}
+
+// As above, with the measurements applied on virtual states.
+TEST(MSF_Core, SmootherIncludesDelayedMeasurementsOnVirtualStates) {
+  ros::Time::init();
+  ExpectSmoothedStatesCorrected(true);
+}
+
+MSF_UNITTEST_ENTRYPOINT
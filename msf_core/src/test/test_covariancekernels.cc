@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <slynen at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <msf_core/msf_covariance_kernels.h>
+#include <msf_core/testing_entrypoint.h>
+
+namespace {
+Eigen::MatrixXd RandomCovariance(int n) {
+  const Eigen::MatrixXd A = Eigen::MatrixXd::Random(n, n);
+  return A * A.transpose() + Eigen::MatrixXd::Identity(n, n);
+}
+}  // namespace
+
+TEST(MSF_Core, CovarianceKernelsSandwich) {
+  msf_core::CovarianceKernels kernels(4, 0);
+  ASSERT_TRUE(kernels.IsParallel(1));
+  const int dimensions[] = { 1, 15, 16, 17, 77, 150 };
+  for (int n : dimensions) {
+    const Eigen::MatrixXd F = Eigen::MatrixXd::Random(n, n);
+    const Eigen::MatrixXd P = RandomCovariance(n);
+    Eigen::MatrixXd tmp(n, n), out(n, n);
+    kernels.Sandwich(F, P, tmp, out);
+    const Eigen::MatrixXd expected = F * P * F.transpose();
+    EXPECT_LT((out - expected).norm(), 1e-10 * expected.norm()) << n;
+    EXPECT_EQ(out, out.transpose()) << n;
+
+    // In place, as in the Joseph form update.
+    Eigen::MatrixXd P_inplace = P;
+    kernels.Sandwich(F, P_inplace, tmp, P_inplace);
+    EXPECT_LT((P_inplace - expected).norm(), 1e-10 * expected.norm()) << n;
+  }
+}
+
+TEST(MSF_Core, CovarianceKernelsSubtractOuterProduct) {
+  msf_core::CovarianceKernels kernels(3, 0);
+  const int dimensions[] = { 5, 33, 120 };
+  for (int n : dimensions) {
+    const Eigen::Matrix<double, Eigen::Dynamic, 6> K =
+        Eigen::Matrix<double, Eigen::Dynamic, 6>::Random(n, 6);
+    const Eigen::Matrix<double, 6, 6> S = Eigen::Matrix<double, 6, 6>::Identity();
+    Eigen::MatrixXd P = RandomCovariance(n);
+    const Eigen::MatrixXd expected = P - K * S * K.transpose();
+    kernels.SubtractOuterProduct(K, S, P);
+    EXPECT_LT((P - expected).norm(), 1e-10 * expected.norm()) << n;
+    EXPECT_EQ(P, P.transpose()) << n;
+  }
+}
+
+TEST(MSF_Core, CovarianceKernelsJosephUpdate) {
+  const int threads[] = { 1, 4 };
+  for (int num_threads : threads) {
+    msf_core::CovarianceKernels kernels(num_threads, 0);
+    const int dimensions[] = { 3, 40, 90 };
+    for (int n : dimensions) {
+      const Eigen::MatrixXd K = Eigen::MatrixXd::Random(n, 3);
+      const Eigen::MatrixXd H = Eigen::MatrixXd::Random(3, n);
+      const Eigen::Matrix3d R = Eigen::Vector3d(1, 2, 3).asDiagonal();
+      const Eigen::MatrixXd KH = Eigen::MatrixXd::Identity(n, n) - K * H;
+      Eigen::MatrixXd P = RandomCovariance(n);
+      const Eigen::MatrixXd expected = KH * P * KH.transpose()
+          + K * R * K.transpose();
+      Eigen::MatrixXd tmp(n, n);
+      kernels.JosephUpdate(KH, K, R, tmp, P);
+      EXPECT_LT((P - expected).norm(), 1e-10 * expected.norm()) << n;
+      EXPECT_EQ(P, P.transpose()) << n;
+    }
+  }
+}
+
+TEST(MSF_Core, CovarianceKernelsBelowThreshold) {
+  msf_core::CovarianceKernels kernels(4, 100);
+  EXPECT_FALSE(kernels.IsParallel(99));
+  EXPECT_TRUE(kernels.IsParallel(100));
+  kernels.SetNumThreads(1);
+  EXPECT_FALSE(kernels.IsParallel(1000));
+
+  const int n = 30;
+  const Eigen::MatrixXd F = Eigen::MatrixXd::Random(n, n);
+  const Eigen::MatrixXd P = RandomCovariance(n);
+  Eigen::MatrixXd tmp(n, n), out(n, n);
+  kernels.Sandwich(F, P, tmp, out);
+  EXPECT_LT((out - F * P * F.transpose()).norm(), 1e-10 * out.norm());
+  EXPECT_EQ(out, out.transpose());
+
+  const Eigen::MatrixXd K = Eigen::MatrixXd::Random(n, 2);
+  Eigen::MatrixXd P_updated = P;
+  kernels.SubtractOuterProduct(K, Eigen::Matrix2d::Identity(), P_updated);
+  EXPECT_LT((P_updated - P + K * K.transpose()).norm(), 1e-10 * P.norm());
+  EXPECT_EQ(P_updated, P_updated.transpose());
+}
+
+MSF_UNITTEST_ENTRYPOINT
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2012, Markus Achtelik, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <acmarkus at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <msf_core/gps_conversion.h>
+#include <msf_core/testing_entrypoint.h>
+#include <msf_core/testing_predicates.h>
+
+namespace {
+const double ref_lat = 47.3769;
+const double ref_lon = 8.5417;
+const double ref_alt = 408;
+
+// Random points within about a kilometer of the reference.
+msf_core::GPSConversion::WGS84Points RandomPointsAroundReference(int n) {
+  msf_core::GPSConversion::WGS84Points wgs84(3, n);
+  wgs84.setRandom();
+  wgs84.row(0) = (wgs84.row(0).array() * 0.008 + ref_lat).matrix();
+  wgs84.row(1) = (wgs84.row(1).array() * 0.008 + ref_lon).matrix();
+  wgs84.row(2) = (wgs84.row(2).array() * 50 + ref_alt).matrix();
+  return wgs84;
+}
+}
+
+TEST(MSF_Core, GPSConversionBatchMatchesSingle) {
+  using namespace msf_core;
+  GPSConversion conversion;
+  conversion.InitReference(ref_lat, ref_lon, ref_alt);
+
+  GPSConversion::WGS84Points wgs84 = RandomPointsAroundReference(100);
+  GPSConversion::CartesianPoints enu;
+  conversion.WGS84ToENU(wgs84, enu);
+
+  for (int i = 0; i < wgs84.cols(); ++i) {
+    EXPECT_NEAR_EIGEN(
+        enu.col(i),
+        conversion.WGS84ToENU(wgs84(0, i), wgs84(1, i), wgs84(2, i)), 1e-6);
+  }
+}
+
+TEST(MSF_Core, GPSConversionRoundTrip) {
+  using namespace msf_core;
+  GPSConversion conversion;
+  conversion.InitReference(ref_lat, ref_lon, ref_alt);
+
+  GPSConversion::WGS84Points wgs84 = RandomPointsAroundReference(100);
+  GPSConversion::CartesianPoints enu;
+  conversion.WGS84ToENU(wgs84, enu);
+  GPSConversion::WGS84Points wgs84_back;
+  conversion.ENUToWGS84(enu, wgs84_back);
+
+  for (int i = 0; i < wgs84.cols(); ++i) {
+    EXPECT_NEAR(wgs84(0, i), wgs84_back(0, i), 1e-9);
+    EXPECT_NEAR(wgs84(1, i), wgs84_back(1, i), 1e-9);
+    EXPECT_NEAR(wgs84(2, i), wgs84_back(2, i), 1e-4);
+  }
+}
+
+TEST(MSF_Core, GPSConversionLocalApproximation) {
+  using namespace msf_core;
+  GPSConversion conversion;
+  conversion.SetLocalApproximationRadius(1000);
+  conversion.InitReference(ref_lat, ref_lon, ref_alt);
+  conversion.AdjustReference(1.5);
+
+  const double max_error = conversion.GetLocalApproximationError();
+  EXPECT_LT(max_error, 0.01);
+
+  GPSConversion::WGS84Points wgs84 = RandomPointsAroundReference(100);
+  GPSConversion::CartesianPoints enu;
+  GPSConversion::CartesianPoints enu_local;
+  conversion.WGS84ToENU(wgs84, enu);
+  conversion.WGS84ToENULocal(wgs84, enu_local);
+
+  for (int i = 0; i < wgs84.cols(); ++i) {
+    if (enu.col(i).head<2>().norm() > 1000)
+      continue;
+    EXPECT_NEAR_EIGEN(enu_local.col(i), enu.col(i), max_error);
+  }
+}
+
+MSF_UNITTEST_ENTRYPOINT
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <slynen at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <msf_core/msf_ingestionstatistics.h>
+#include <msf_core/testing_entrypoint.h>
+
+TEST(MSF_Core, IngestionStatisticsRateAndLag) {
+  msf_core::IngestionStatistics statistics;
+  // 50 Hz arriving 20 ms after the stamp.
+  for (int i = 0; i < 200; ++i)
+    statistics.Add(i + 1, i * 0.02, i * 0.02 + 0.02);
+  EXPECT_EQ(statistics.Received(), 200u);
+  EXPECT_NEAR(statistics.Rate(), 50, 1e-6);
+  EXPECT_NEAR(statistics.Jitter(), 0, 1e-9);
+  EXPECT_NEAR(statistics.MeanLag(), 0.02, 1e-9);
+  EXPECT_EQ(statistics.SequenceGaps(), 0u);
+}
+
+TEST(MSF_Core, IngestionStatisticsJitter) {
+  msf_core::IngestionStatistics statistics;
+  // Bursts of two messages every 20 ms.
+  for (int i = 0; i < 400; ++i)
+    statistics.Add(i + 1, i * 0.01, (i / 2) * 0.02 + 0.001 * (i % 2));
+  EXPECT_NEAR(statistics.Rate(), 100, 5);
+  EXPECT_GT(statistics.Jitter(), 0.005);
+  EXPECT_GT(statistics.MaxLag(), statistics.MeanLag());
+}
+
+TEST(MSF_Core, IngestionStatisticsSequenceGaps) {
+  msf_core::IngestionStatistics statistics(10);
+  for (int i = 0; i < 20; ++i)
+    statistics.Add(i + 1, i * 0.01, i * 0.01 + 0.001);
+  // Lost on the transport, the next message arrives in time.
+  EXPECT_EQ(statistics.Add(24, 0.23, 0.231), 3u);
+  EXPECT_EQ(statistics.SequenceGaps(), 3u);
+  EXPECT_EQ(statistics.QueueOverflows(), 0u);
+
+  // Lost in a full queue, the next message arrives late.
+  EXPECT_EQ(statistics.Add(30, 0.29, 0.45), 5u);
+  EXPECT_EQ(statistics.SequenceGaps(), 8u);
+  EXPECT_EQ(statistics.QueueOverflows(), 5u);
+
+  // A restarted publisher is not a gap.
+  EXPECT_EQ(statistics.Add(1, 0, 0.46), 0u);
+  EXPECT_EQ(statistics.SequenceGaps(), 8u);
+}
+
+MSF_UNITTEST_ENTRYPOINT
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <slynen at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <msf_core/msf_tools.h>
+#include <msf_core/testing_entrypoint.h>
+
+TEST(MSF_Core, MovingAverageEmpty) {
+  msf_core::MovingAverage<4> average;
+  EXPECT_EQ(average.Count(), 0);
+  EXPECT_EQ(average.Mean(), 0);
+}
+
+TEST(MSF_Core, MovingAverageFillsUp) {
+  msf_core::MovingAverage<4> average;
+  average.Add(1);
+  average.Add(3);
+  EXPECT_EQ(average.Count(), 2);
+  EXPECT_DOUBLE_EQ(average.Mean(), 2);
+}
+
+TEST(MSF_Core, MovingAverageDropsOldest) {
+  msf_core::MovingAverage<4> average;
+  for (int i = 0; i < 10; ++i) {
+    average.Add(i);
+  }
+  EXPECT_EQ(average.Count(), 4);
+  EXPECT_DOUBLE_EQ(average.Mean(), (6 + 7 + 8 + 9) / 4.);
+  average.Reset();
+  EXPECT_EQ(average.Count(), 0);
+  average.Add(5);
+  EXPECT_DOUBLE_EQ(average.Mean(), 5);
+}
+
+TEST(MSF_Core, MovingAverageNoDrift) {
+  msf_core::MovingAverage<10> average;
+  // A large offset makes the rounding of a plain running sum visible.
+  for (int i = 0; i < 100000; ++i) {
+    average.Add(1e8 + (i % 10) * 0.1);
+  }
+  EXPECT_NEAR(average.Mean(), 1e8 + 0.45, 1e-6);
+}
+
+MSF_UNITTEST_ENTRYPOINT
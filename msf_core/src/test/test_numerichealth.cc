@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <slynen at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <limits>
+
+#include <Eigen/Dense>
+#include <msf_core/msf_numerichealth.h>
+#include <msf_core/testing_entrypoint.h>
+
+TEST(MSF_Core, CheckForNumericFindsNonFiniteEntries) {
+  Eigen::MatrixXd P = Eigen::MatrixXd::Identity(40, 40);
+  EXPECT_TRUE(CheckForNumeric(P, "P"));
+  P(17, 3) = std::numeric_limits<double>::quiet_NaN();
+  EXPECT_FALSE(CheckForNumeric(P, "P"));
+  P(17, 3) = -std::numeric_limits<double>::infinity();
+  EXPECT_FALSE(CheckForNumeric(P, "P"));
+  P(17, 3) = std::numeric_limits<double>::infinity();
+  P(3, 17) = -std::numeric_limits<double>::infinity();
+  EXPECT_FALSE(CheckForNumeric(P, "P"));
+
+  // Large but finite entries are fine even if their sum overflows.
+  Eigen::Vector3d v = Eigen::Vector3d::Constant(
+      std::numeric_limits<double>::max());
+  EXPECT_TRUE(CheckForNumeric(v, "v"));
+}
+
+TEST(MSF_Core, NumericHealthSentinel) {
+  msf_core::NumericHealth health(10);
+  Eigen::MatrixXd P = Eigen::MatrixXd::Identity(20, 20);
+  for (int i = 0; i < 20; ++i)
+    EXPECT_TRUE(health.CheckCovariance(P, "P"));
+  EXPECT_EQ(health.SentinelChecks(), 20u);
+  EXPECT_EQ(health.FullChecks(), 2u);
+
+  // The trace catches the diagonal at once.
+  P(4, 4) = std::numeric_limits<double>::quiet_NaN();
+  EXPECT_FALSE(health.CheckCovariance(P, "P"));
+  EXPECT_EQ(health.Failures(), 1u);
+
+  // Off the diagonal it is found by the next full check.
+  P(4, 4) = 1;
+  P(4, 5) = std::numeric_limits<double>::quiet_NaN();
+  int checks = 0;
+  while (health.CheckCovariance(P, "P"))
+    ++checks;
+  EXPECT_LT(checks, 10);
+  EXPECT_EQ(health.Failures(), 2u);
+
+  // A flagged kernel result forces the full check.
+  P(4, 5) = 0;
+  EXPECT_TRUE(health.CheckCovariance(P, "P"));
+  P(4, 5) = std::numeric_limits<double>::quiet_NaN();
+  Eigen::Vector2d K(1, std::numeric_limits<double>::infinity());
+  EXPECT_FALSE(health.CheckKernel(K));
+  EXPECT_EQ(health.KernelFlags(), 1u);
+  EXPECT_FALSE(health.CheckCovariance(P, "P"));
+  EXPECT_EQ(health.Failures(), 3u);
+}
+
+MSF_UNITTEST_ENTRYPOINT
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <slynen at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <msf_core/msf_ratelimiter.h>
+#include <msf_core/testing_entrypoint.h>
+
+TEST(MSF_Core, RateLimiterUnlimited) {
+  msf_core::MeasurementRateLimiter limiter;
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_TRUE(limiter.Accept(i * 0.001));
+  }
+  EXPECT_EQ(limiter.GetStatistics().accepted, 100u);
+  EXPECT_EQ(limiter.GetStatistics().dropped, 0u);
+}
+
+TEST(MSF_Core, RateLimiterDecimatesByTime) {
+  msf_core::MeasurementRateLimiter limiter(20);
+  // 100 Hz for one second with every third reading lost on the transport.
+  int accepted = 0;
+  for (int i = 0; i < 100; ++i) {
+    if (i % 3 == 1)
+      continue;
+    accepted += limiter.Accept(i * 0.01);
+  }
+  EXPECT_EQ(accepted, 20);
+  EXPECT_EQ(limiter.GetStatistics().received, 67u);
+  EXPECT_EQ(limiter.GetStatistics().dropped, 47u);
+
+  // Time jumping back restarts the decimation.
+  EXPECT_TRUE(limiter.Accept(0.5));
+  EXPECT_FALSE(limiter.Accept(0.51));
+}
+
+TEST(MSF_Core, RateLimiterDecimatesHighRates) {
+  msf_core::MeasurementRateLimiter limiter(500);
+  // 2 kHz for one second.
+  int accepted = 0;
+  for (int i = 0; i < 2000; ++i)
+    accepted += limiter.Accept(i * 0.0005);
+  EXPECT_EQ(accepted, 500);
+}
+
+TEST(MSF_Core, ReadingAverager) {
+  msf_core::ReadingAverager<2> averager;
+  averager.Add(1, Eigen::Vector2d(1, 2));
+  averager.Add(2, Eigen::Vector2d(3, 6));
+  EXPECT_EQ(averager.Count(), 2u);
+  EXPECT_DOUBLE_EQ(averager.MeanTimestamp(), 1.5);
+  EXPECT_DOUBLE_EQ(averager.Mean()(0), 2);
+  EXPECT_DOUBLE_EQ(averager.Mean()(1), 4);
+  averager.Reset();
+  EXPECT_EQ(averager.Count(), 0u);
+}
+
+MSF_UNITTEST_ENTRYPOINT
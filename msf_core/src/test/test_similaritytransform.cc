@@ -142,4 +142,182 @@ TEST(MSF_Core, SimilarityTransform) {
   EXPECT_NEAR_EIGEN(qr.coeffs(), q.coeffs(), s_q);
 }
 
+namespace {
+// Generates a noisy pose pair related by the similarity transform p, q, scale.
+msf_core::similarity_transform::PosePair MakePosePair(
+    const msf_core::Vector3& p, const Eigen::Quaterniond& q, double scale,
+    double s_p, double s_q) {
+  using namespace msf_core;
+  Vector3 p1 = p + Vector3::Random() * 0.1 + Vector3(3, 4, 5);
+  Eigen::Quaterniond q1(Eigen::Matrix<double, 4, 1>::Random());
+  q1.normalize();
+
+  Vector3 p2 = (q1 * p + p1) / scale;
+  Eigen::Quaterniond q2 = q1 * q;
+  p2 += (Vector3::Random() * s_p);
+  Eigen::Quaterniond q_noise(Eigen::Quaterniond::Identity());
+  q_noise.coeffs() += Eigen::Matrix<double, 4, 1>::Random() * s_q;
+  q_noise.normalize();
+  q2 = q2 * q_noise;
+
+  similarity_transform::PosePair pair;
+  pair.first.pose.position = EigenToGeometryMsgs(p1);
+  pair.first.pose.orientation = EigenToGeometryMsgs(q1);
+  pair.second.pose.position = EigenToGeometryMsgs(p2);
+  pair.second.pose.orientation = EigenToGeometryMsgs(q2);
+  return pair;
+}
+
+void ExpectSameTransform(const msf_core::similarity_transform::Pose& lhs,
+                         double lhs_scale,
+                         const msf_core::similarity_transform::Pose& rhs,
+                         double rhs_scale) {
+  using namespace msf_core;
+  EXPECT_NEAR_EIGEN(GeometryMsgsToEigen(lhs.pose.position),
+                    GeometryMsgsToEigen(rhs.pose.position), 1e-8);
+  Eigen::Quaterniond q_lhs = GeometryMsgsToEigen(lhs.pose.orientation);
+  Eigen::Quaterniond q_rhs = GeometryMsgsToEigen(rhs.pose.orientation);
+  // The mean quaternion is only defined up to its sign.
+  EXPECT_NEAR(std::abs(q_lhs.dot(q_rhs)), 1, 1e-8);
+  EXPECT_NEAR(lhs_scale, rhs_scale, 1e-8);
+}
+}
+
+TEST(MSF_Core, SimilarityTransformIncremental) {
+  using namespace msf_core;
+
+  Vector3 p(Vector3::Random());
+  Eigen::Quaterniond q(Eigen::Matrix<double, 4, 1>::Random());
+  q.normalize();
+  const double scale = 2;
+
+  similarity_transform::From6DoF batch;
+  similarity_transform::From6DoFIncremental incremental;
+  for (int i = 0; i < 100; i++) {
+    similarity_transform::PosePair pair = MakePosePair(p, q, scale, 1e-2, 1e-2);
+    batch.AddMeasurement(pair);
+    incremental.AddMeasurement(pair);
+  }
+  EXPECT_EQ(incremental.NumMeasurements(), 100u);
+
+  similarity_transform::Pose batch_pose;
+  similarity_transform::Pose incremental_pose;
+  double batch_scale;
+  double incremental_scale;
+  ASSERT_TRUE(batch.Compute(batch_pose, &batch_scale));
+  ASSERT_TRUE(incremental.Compute(incremental_pose, &incremental_scale));
+
+  ExpectSameTransform(incremental_pose, incremental_scale, batch_pose,
+                      batch_scale);
+}
+
+TEST(MSF_Core, SimilarityTransformSlidingWindow) {
+  using namespace msf_core;
+
+  const int window = 20;
+  similarity_transform::From6DoFIncremental incremental(1, window);
+  similarity_transform::From6DoF batch;
+
+  // The transform changes halfway, the window must only see the second one.
+  Vector3 p(Vector3::Random());
+  Eigen::Quaterniond q(Eigen::Matrix<double, 4, 1>::Random());
+  q.normalize();
+  for (int i = 0; i < 55; i++) {
+    incremental.AddMeasurement(MakePosePair(p, q, 2, 1e-2, 1e-2));
+  }
+  p = Vector3::Random();
+  q.coeffs() = Eigen::Matrix<double, 4, 1>::Random();
+  q.normalize();
+  for (int i = 0; i < 57; i++) {
+    similarity_transform::PosePair pair = MakePosePair(p, q, 3, 1e-2, 1e-2);
+    incremental.AddMeasurement(pair);
+    if (i >= 57 - window)
+      batch.AddMeasurement(pair);
+  }
+  EXPECT_EQ(incremental.NumMeasurements(), static_cast<size_t>(window));
+
+  similarity_transform::Pose batch_pose;
+  similarity_transform::Pose incremental_pose;
+  double batch_scale;
+  double incremental_scale;
+  ASSERT_TRUE(batch.Compute(batch_pose, &batch_scale));
+  ASSERT_TRUE(incremental.Compute(incremental_pose, &incremental_scale));
+
+  ExpectSameTransform(incremental_pose, incremental_scale, batch_pose,
+                      batch_scale);
+}
+
+TEST(MSF_Core, SimilarityTransformForgetting) {
+  using namespace msf_core;
+
+  similarity_transform::From6DoFIncremental incremental(0.8);
+
+  Vector3 p(Vector3::Random());
+  Eigen::Quaterniond q(Eigen::Matrix<double, 4, 1>::Random());
+  q.normalize();
+  for (int i = 0; i < 50; i++) {
+    incremental.AddMeasurement(MakePosePair(p, q, 2, 1e-3, 1e-3));
+  }
+  // After the change the old transform is forgotten exponentially fast.
+  p = Vector3::Random();
+  q.coeffs() = Eigen::Matrix<double, 4, 1>::Random();
+  q.normalize();
+  for (int i = 0; i < 100; i++) {
+    incremental.AddMeasurement(MakePosePair(p, q, 2, 1e-3, 1e-3));
+  }
+
+  similarity_transform::Pose pose;
+  double scale;
+  ASSERT_TRUE(incremental.Compute(pose, &scale));
+  EXPECT_NEAR_EIGEN(GeometryMsgsToEigen(pose.pose.position), p, 1e-2);
+  EXPECT_NEAR(
+      std::abs(GeometryMsgsToEigen(pose.pose.orientation).dot(q)), 1, 1e-3);
+  EXPECT_NEAR(scale, 2, 1e-2);
+}
+
+TEST(MSF_Core, SimilarityTransformRobust) {
+  using namespace msf_core;
+
+  Vector3 p(Vector3::Random());
+  Eigen::Quaterniond q(Eigen::Matrix<double, 4, 1>::Random());
+  q.normalize();
+  const double scale = 2;
+
+  similarity_transform::RobustOptions options;
+  options.num_threads = 4;
+  similarity_transform::From6DoFRobust robust(options);
+  similarity_transform::From6DoF inliers_only;
+  const int N = 100;
+  const int N_outliers = 40;
+  for (int i = 0; i < N; i++) {
+    similarity_transform::PosePair pair = MakePosePair(p, q, scale, 1e-2, 1e-2);
+    robust.AddMeasurement(pair);
+    inliers_only.AddMeasurement(pair);
+  }
+  // Wrong associations: unrelated pose pairs.
+  for (int i = 0; i < N_outliers; i++) {
+    Vector3 p_wrong(Vector3::Random() * 10);
+    Eigen::Quaterniond q_wrong(Eigen::Matrix<double, 4, 1>::Random());
+    q_wrong.normalize();
+    robust.AddMeasurement(MakePosePair(p_wrong, q_wrong, 1, 0, 0));
+  }
+
+  similarity_transform::Pose robust_pose;
+  similarity_transform::Pose reference_pose;
+  double robust_scale;
+  double reference_scale;
+  double cond;
+  std::vector<size_t> inliers;
+  ASSERT_TRUE(robust.Compute(robust_pose, &robust_scale, &cond, &inliers));
+  ASSERT_TRUE(inliers_only.Compute(reference_pose, &reference_scale));
+
+  ASSERT_EQ(inliers.size(), static_cast<size_t>(N));
+  for (int i = 0; i < N; i++) {
+    EXPECT_EQ(inliers[i], static_cast<size_t>(i));
+  }
+  EXPECT_GT(cond, 0);
+  ExpectSameTransform(robust_pose, robust_scale, reference_pose,
+                      reference_scale);
+}
+
 MSF_UNITTEST_ENTRYPOINT
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <slynen at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cmath>
+#include <mutex>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <msf_core/msf_smoother.h>
+#include <msf_core/testing_entrypoint.h>
+
+namespace {
+/// Position and velocity with a constant velocity model.
+struct TestState {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  enum {
+    nErrorStatesAtCompileTime = 2
+  };
+  typedef Eigen::Matrix2d P_type;
+  double time;
+  Eigen::Vector2d x;
+  P_type P;
+  P_type Fd;  ///< Transition to the next state.
+  P_type Qd;
+  void Correct(const Eigen::Vector2d& correction) {
+    x += correction;
+  }
+};
+typedef msf_core::FixedLagSmoother<TestState> Smoother_T;
+
+const double dt = 0.1;
+const double noise_acc = 0.5;
+const double noise_meas = 0.2;
+
+double Measurement(int k) {
+  return 0.5 * k * dt + 0.1 * std::sin(1.3 * k);
+}
+
+/**
+ * Filters the position measurements of states 1 ... n - 1, state 0 holds the
+ * prior.
+ */
+void Filter(int n, std::vector<TestState>& states,
+            std::vector<Eigen::Vector2d>& corrections) {
+  Eigen::Matrix2d F, Q;
+  F << 1, dt, 0, 1;
+  Q << dt * dt * dt / 3, dt * dt / 2, dt * dt / 2, dt;
+  Q *= noise_acc * noise_acc;
+  states.resize(n);
+  corrections.assign(n, Eigen::Vector2d::Zero());
+  states[0].time = 0;
+  states[0].x << 0, 0.3;
+  states[0].P = Eigen::Vector2d(1, 0.5).asDiagonal();
+  for (int k = 1; k < n; ++k) {
+    TestState& state_old = states[k - 1];
+    TestState& state = states[k];
+    state_old.Fd = F;
+    state_old.Qd = Q;
+    state.time = k * dt;
+    state.x = F * state_old.x;
+    state.P = F * state_old.P * F.transpose() + Q;
+    const Eigen::Vector2d K = state.P.col(0)
+        / (state.P(0, 0) + noise_meas * noise_meas);
+    corrections[k] = K * (Measurement(k) - state.x(0));
+    state.Correct(corrections[k]);
+    state.P -= K * state.P.row(0);
+  }
+  states[n - 1].Fd = F;
+  states[n - 1].Qd = Q;
+}
+
+/// The smoothed states of the least squares problem over all measurements.
+void Batch(int n, Eigen::VectorXd& x, Eigen::MatrixXd& P) {
+  std::vector<TestState> states;
+  std::vector<Eigen::Vector2d> corrections;
+  Filter(1, states, corrections);
+  Eigen::Matrix2d F, Q;
+  F << 1, dt, 0, 1;
+  Q << dt * dt * dt / 3, dt * dt / 2, dt * dt / 2, dt;
+  Q *= noise_acc * noise_acc;
+  Eigen::MatrixXd information = Eigen::MatrixXd::Zero(2 * n, 2 * n);
+  Eigen::VectorXd b = Eigen::VectorXd::Zero(2 * n);
+  const Eigen::Matrix2d prior_information = states[0].P.inverse();
+  information.block<2, 2>(0, 0) += prior_information;
+  b.segment<2>(0) += prior_information * states[0].x;
+  Eigen::Matrix<double, 2, 4> J;
+  J << -F, Eigen::Matrix2d::Identity();
+  for (int k = 0; k + 1 < n; ++k)
+    information.block<4, 4>(2 * k, 2 * k) += J.transpose() * Q.inverse() * J;
+  for (int k = 1; k < n; ++k) {
+    information(2 * k, 2 * k) += 1 / (noise_meas * noise_meas);
+    b(2 * k) += Measurement(k) / (noise_meas * noise_meas);
+  }
+  P = information.inverse();
+  x = P * b;
+}
+
+std::vector<Smoother_T::EntryConstPtr> MakeEntries(
+    const std::vector<TestState>& states,
+    const std::vector<Eigen::Vector2d>& corrections) {
+  std::vector<Smoother_T::EntryConstPtr> entries;
+  for (size_t k = 0; k < states.size(); ++k) {
+    shared_ptr<Smoother_T::Entry> entry(new Smoother_T::Entry);
+    entry->state = states[k];
+    entry->correction = corrections[k];
+    entries.push_back(entry);
+  }
+  return entries;
+}
+}  // namespace
+
+TEST(MSF_Core, SmootherMatchesBatchSolution) {
+  const int n = 30;
+  std::vector<TestState> states;
+  std::vector<Eigen::Vector2d> corrections;
+  Filter(n, states, corrections);
+  Eigen::VectorXd x;
+  Eigen::MatrixXd P;
+  Batch(n, x, P);
+
+  std::vector<shared_ptr<TestState> > smoothed;
+  Smoother_T::Smooth(MakeEntries(states, corrections), n - 1, smoothed);
+  ASSERT_EQ(smoothed.size(), static_cast<size_t>(n - 1));
+  for (int k = 0; k < n - 1; ++k) {
+    EXPECT_EQ(smoothed[k]->time, states[k].time);
+    EXPECT_LT((smoothed[k]->x - x.segment<2>(2 * k)).norm(), 1e-9) << k;
+    EXPECT_LT((smoothed[k]->P - P.block<2, 2>(2 * k, 2 * k)).norm(), 1e-9)
+        << k;
+  }
+  // The newest state is the filtered state in both.
+  EXPECT_LT((states[n - 1].x - x.segment<2>(2 * (n - 1))).norm(), 1e-9);
+}
+
+TEST(MSF_Core, SmootherPublishesEachStateOnce) {
+  const int n = 100;
+  const double lag = 1;
+  std::vector<TestState> states;
+  std::vector<Eigen::Vector2d> corrections;
+  Filter(n, states, corrections);
+
+  std::mutex mutex;
+  std::vector<shared_ptr<TestState> > published;
+  Smoother_T smoother;
+  smoother.SetCallback([&](const shared_ptr<TestState>& state) {
+    std::lock_guard<std::mutex> lock(mutex);
+    published.push_back(state);
+  });
+  smoother.SetLag(lag);
+  ASSERT_TRUE(smoother.IsEnabled());
+  EXPECT_EQ(smoother.GetLastTime(), -1);
+
+  // States from a later measurement are replaced.
+  for (int k = 0; k < 5; ++k)
+    smoother.Add(states[k], corrections[k]);
+  smoother.DiscardFrom(states[3].time);
+  EXPECT_EQ(smoother.GetLastTime(), states[2].time);
+
+  for (int k = 3; k < n; ++k)
+    smoother.Add(states[k], corrections[k]);
+  smoother.Flush();
+
+  ASSERT_FALSE(published.empty());
+  EXPECT_LE(published.back()->time, states[n - 1].time - lag + 1e-9);
+  for (size_t k = 0; k < published.size(); ++k) {
+    EXPECT_NEAR(published[k]->time, states[k].time, 1e-9) << k;
+    EXPECT_LE(published[k]->P.trace(), states[k].P.trace() + 1e-12) << k;
+  }
+
+  // The states of the first window are smoothed with the measurements up to
+  // the end of the window.
+  int window_end = 0;
+  while (states[window_end].time - states[0].time < 2 * lag - 1e-9)
+    ++window_end;
+  Eigen::VectorXd x;
+  Eigen::MatrixXd P;
+  Batch(window_end + 1, x, P);
+  for (int k = 0; states[k].time <= states[window_end].time - lag + 1e-9;
+      ++k) {
+    EXPECT_LT((published[k]->x - x.segment<2>(2 * k)).norm(), 1e-9) << k;
+  }
+
+  smoother.SetLag(0);
+  EXPECT_FALSE(smoother.IsEnabled());
+}
+
+MSF_UNITTEST_ENTRYPOINT
@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <slynen at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <Eigen/Dense>
+#include <msf_core/msf_squarerootcovariance.h>
+#include <msf_core/testing_entrypoint.h>
+
+namespace {
+Eigen::MatrixXd RandomCovariance(int n) {
+  const Eigen::MatrixXd A = Eigen::MatrixXd::Random(n, n);
+  return A * A.transpose() + Eigen::MatrixXd::Identity(n, n);
+}
+
+double MinEigenvalue(const Eigen::MatrixXd& P) {
+  return Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd>(P).eigenvalues()
+      .minCoeff();
+}
+}  // namespace
+
+TEST(MSF_Core, SquareRootCovariancePropagate) {
+  const int n = 25;
+  msf_core::SquareRootCovariance<Eigen::MatrixXd> square_root;
+  square_root.Resize(n);
+  const Eigen::MatrixXd F = Eigen::MatrixXd::Identity(n, n)
+      + 0.1 * Eigen::MatrixXd::Random(n, n);
+  const Eigen::MatrixXd P = RandomCovariance(n);
+  // Only part of the states have process noise, as in the filter.
+  Eigen::MatrixXd Q = Eigen::MatrixXd::Zero(n, n);
+  Q.topLeftCorner(9, 9) = RandomCovariance(9) * 1e-3;
+  Eigen::MatrixXd P_new(n, n);
+  square_root.Propagate(F, P, Q, P_new);
+  const Eigen::MatrixXd expected = F * P * F.transpose() + Q;
+  EXPECT_LT((P_new - expected).norm(), 1e-10 * expected.norm());
+  EXPECT_EQ(P_new, P_new.transpose());
+  EXPECT_EQ(square_root.GetRepairs(), 0u);
+}
+
+TEST(MSF_Core, SquareRootCovarianceDowndate) {
+  const int n = 25;
+  const int m = 3;
+  msf_core::SquareRootCovariance<Eigen::Matrix<double, n, n> > square_root;
+  const Eigen::Matrix<double, n, n> P0 = RandomCovariance(n);
+  Eigen::Matrix<double, m, n> H = Eigen::Matrix<double, m, n>::Random();
+  const Eigen::Matrix<double, m, m> R = Eigen::Matrix<double, m, m>::Identity()
+      * 1e-4;
+  const Eigen::Matrix<double, m, m> S = H * P0 * H.transpose() + R;
+  const Eigen::Matrix<double, n, m> K = P0 * H.transpose() * S.inverse();
+  const Eigen::Matrix<double, n, m> U = K * S.llt().matrixL();
+
+  Eigen::Matrix<double, n, n> P = P0;
+  ASSERT_TRUE(square_root.Downdate(U, P));
+  const Eigen::Matrix<double, n, n> expected = P0 - K * S * K.transpose();
+  EXPECT_LT((P - expected).norm(), 1e-8 * P0.norm());
+  EXPECT_EQ(P, P.transpose());
+  EXPECT_GT(MinEigenvalue(P), 0);
+
+  // Removing more than P holds fails and leaves P as it was.
+  P = P0;
+  const Eigen::Matrix<double, n, 1> too_large = 2 * P0.col(0)
+      / std::sqrt(P0(0, 0));
+  EXPECT_FALSE(square_root.Downdate(too_large, P));
+  EXPECT_EQ(P, P0);
+}
+
+TEST(MSF_Core, SquareRootCovarianceRepairsIndefiniteP) {
+  const int n = 10;
+  msf_core::SquareRootCovariance<Eigen::MatrixXd> square_root;
+  square_root.Resize(n);
+  Eigen::MatrixXd P = RandomCovariance(n);
+  // A covariance which lost definiteness to rounding.
+  Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> eigen(P);
+  Eigen::VectorXd eigenvalues = eigen.eigenvalues();
+  eigenvalues(0) = -1e-9;
+  P = eigen.eigenvectors() * eigenvalues.asDiagonal()
+      * eigen.eigenvectors().transpose();
+  ASSERT_LT(MinEigenvalue(P), 0);
+
+  const Eigen::MatrixXd I = Eigen::MatrixXd::Identity(n, n);
+  Eigen::MatrixXd P_new(n, n);
+  square_root.Propagate(I, P, Eigen::MatrixXd::Zero(n, n), P_new);
+  EXPECT_EQ(square_root.GetRepairs(), 1u);
+  EXPECT_GE(MinEigenvalue(P_new), 0);
+  EXPECT_LT((P_new - P).norm(), 1e-8 * P.norm());
+}
+
+namespace {
+/**
+ * Runs num_steps propagations, each followed by the update with a scalar
+ * measurement, and returns the square-root result in P and the standard form
+ * in expected.
+ */
+void RunFilter(msf_core::SquareRootCovariance<Eigen::MatrixXd>& square_root,
+               int num_steps, Eigen::MatrixXd& P, Eigen::MatrixXd& expected) {
+  const int n = P.rows();
+  const Eigen::MatrixXd F = Eigen::MatrixXd::Identity(n, n)
+      + 0.01 * Eigen::MatrixXd::Random(n, n);
+  Eigen::MatrixXd Q = Eigen::MatrixXd::Zero(n, n);
+  Q.topLeftCorner(9, 9) = RandomCovariance(9) * 1e-3;
+  const double R = 1e-2;
+  expected = P;
+  Eigen::MatrixXd P_new(n, n);
+  for (int i = 0; i < num_steps; ++i) {
+    const Eigen::VectorXd h = Eigen::VectorXd::Random(n);
+    square_root.Propagate(F, P, Q, P_new);
+    const Eigen::VectorXd PHt = P_new * h;
+    ASSERT_TRUE(square_root.Downdate(PHt / std::sqrt(h.dot(PHt) + R), P_new));
+    P.swap(P_new);
+
+    expected = F * expected * F.transpose() + Q;
+    const Eigen::VectorXd K = expected * h / (h.dot(expected * h) + R);
+    expected -= K * h.transpose() * expected;
+  }
+}
+}  // namespace
+
+TEST(MSF_Core, SquareRootCovarianceCarriesFactorOver) {
+  const int n = 25;
+  msf_core::SquareRootCovariance<Eigen::MatrixXd> square_root;
+  square_root.Resize(n);
+  Eigen::MatrixXd P = RandomCovariance(n);
+  Eigen::MatrixXd expected;
+  RunFilter(square_root, 10, P, expected);
+  EXPECT_EQ(square_root.GetFactorizations(), 1u);
+  EXPECT_LT((P - expected).norm(), 1e-10 * expected.norm());
+
+  // A P changed elsewhere is factored again.
+  P(0, 0) += 1;
+  RunFilter(square_root, 1, P, expected);
+  EXPECT_EQ(square_root.GetFactorizations(), 2u);
+}
+
+TEST(MSF_Core, SquareRootCovarianceSinglePrecision) {
+  const int n = 25;
+  msf_core::SquareRootCovariance<Eigen::MatrixXd> square_root;
+  square_root.Resize(n);
+  square_root.SetSinglePrecision(true);
+  Eigen::MatrixXd P = RandomCovariance(n);
+  Eigen::MatrixXd expected;
+  RunFilter(square_root, 1000, P, expected);
+  EXPECT_EQ(square_root.GetFactorizations(), 1u);
+  EXPECT_LT((P - expected).norm(), 1e-5 * expected.norm());
+  EXPECT_EQ(P, P.transpose());
+  EXPECT_GE(MinEigenvalue(P), 0);
+}
+
+MSF_UNITTEST_ENTRYPOINT
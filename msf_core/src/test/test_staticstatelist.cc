@@ -16,6 +16,7 @@
  */
 
 #include <msf_core/msf_core.h>
+#include <msf_core/msf_statecomposition.h>
 #include <msf_core/testing_entrypoint.h>
 
 // Test calculated sizes.
@@ -139,6 +140,91 @@ TEST(MSF_Core, CompileTimeComputation_StateLengthCalculation) {
             vectorlength1 + vectorlength2 + 3 + 1);
 }
 
+// Tests the covariance of states with dynamic size storage.
+TEST(MSF_Core, RuntimeTimeComputation_DynamicSizeCovariance) {
+  using namespace msf_core;
+  enum StateDefinition {
+    a,
+    b,
+    c
+  };
+  const static int vectorlength = 40;
+
+  typedef boost::fusion::vector<
+      StateVar_T<Eigen::Matrix<double, 3, 1>, a>,
+      StateVar_T<Eigen::Quaterniond, b>,
+      StateVar_T<Eigen::Matrix<double, vectorlength, 1>, c>
+  > fullState_T;
+  typedef GenericState_T<fullState_T, StateDefinition, DynamicSizeCovariance>
+      EKFState;
+  typedef GenericState_T<fullState_T, StateDefinition> FixedEKFState;
+
+  EXPECT_EQ(static_cast<int>(EKFState::nCovarianceDimAtCompileTime),
+            static_cast<int>(Eigen::Dynamic));
+  EXPECT_EQ(FixedEKFState::nCovarianceDimAtCompileTime,
+            FixedEKFState::nErrorStatesAtCompileTime);
+
+  EKFState somestate;
+  EXPECT_EQ(somestate.P.rows(), 3 + 3 + vectorlength);
+  EXPECT_EQ(somestate.P.cols(), 3 + 3 + vectorlength);
+  EXPECT_EQ(somestate.Fd.rows(), 3 + 3 + vectorlength);
+  EXPECT_EQ(somestate.Qd.rows(), 3 + 3 + vectorlength);
+  EXPECT_TRUE(somestate.Fd.isIdentity());
+
+  somestate.P.setOnes();
+  somestate.Reset();
+  EXPECT_EQ(somestate.P.rows(), 3 + 3 + vectorlength);
+  EXPECT_EQ(somestate.P.maxCoeff(), 0);
+}
+
+template<int FirstName>
+struct TestSensorStatePack {
+  enum {
+    scale = FirstName,
+    q_ic,
+    nextName
+  };
+  typedef boost::mpl::vector<
+      msf_core::StateVar_T<Eigen::Matrix<double, 1, 1>, scale>,
+      msf_core::StateVar_T<Eigen::Quaterniond, q_ic>
+  > StateVars_T;
+};
+
+template<int FirstName>
+struct TestBiasStatePack {
+  enum {
+    bias = FirstName,
+    nextName
+  };
+  typedef boost::mpl::vector<
+      msf_core::StateVar_T<Eigen::Matrix<double, 2, 1>, bias>
+  > StateVars_T;
+};
+
+// Tests the names and indices of states composed from packs.
+TEST(MSF_Core, CompileTimeComputation_StateComposition) {
+  using namespace msf_core;
+  typedef ComposeStates<CoreStatePack, TestSensorStatePack, TestBiasStatePack>
+      Composition_T;
+  typedef Composition_T::StateDefinition StateDefinition;
+  typedef GenericState_T<Composition_T::StateSequence_T, StateDefinition>
+      EKFState;
+
+  EXPECT_EQ(StateDefinition::p, 0);
+  EXPECT_EQ(StateDefinition::b_a, 4);
+  EXPECT_EQ(StateDefinition::scale, 5);
+  EXPECT_EQ(StateDefinition::q_ic, 6);
+  EXPECT_EQ(StateDefinition::bias, 7);
+  EXPECT_EQ(static_cast<int>(EKFState::nStateVarsAtCompileTime), 8);
+  EXPECT_EQ(static_cast<int>(EKFState::nErrorStatesAtCompileTime),
+            15 + 1 + 3 + 2);
+
+  const EKFState somestate;
+  EXPECT_EQ(somestate.GetStateVariable<StateDefinition::q_ic>().sizeInState_,
+            4);
+  EXPECT_EQ(somestate.Get<StateDefinition::bias>().rows(), 2);
+}
+
 TEST(MSF_Core, RuntimeTimeComputation_CopyForNonPropagationStates) {
   enum StateDefinition {
     p_,
@@ -209,4 +295,91 @@ TEST(MSF_Core, RuntimeTimeComputation_CopyForNonPropagationStates) {
                    const_ref_second_state.Get<q_>().z());
 }
 
+// Tests that the state vars are views into one array owned by each state.
+TEST(MSF_Core, RuntimeTimeComputation_NominalStateLayout) {
+  using namespace msf_core;
+  enum StateDefinition {
+    a,
+    b,
+    c
+  };
+
+  typedef boost::fusion::vector<
+      StateVar_T<Eigen::Matrix<double, 3, 1>, a>,
+      StateVar_T<Eigen::Quaterniond, b>,
+      StateVar_T<Eigen::Matrix<double, 1, 1>, c>
+  > fullState_T;
+  typedef GenericState_T<fullState_T, StateDefinition> EKFState;
+
+  EKFState somestate;
+  somestate.Set<a>(Eigen::Vector3d(1, 2, 3));
+  somestate.Set<b>(Eigen::Quaterniond(0.5, 0.5, -0.5, 0.5));
+  somestate.Set<c>(Eigen::Matrix<double, 1, 1>::Constant(7));
+
+  Eigen::Matrix<double, 8, 1> expected;
+  expected << 1, 2, 3, 0.5, -0.5, 0.5, 0.5, 7;
+  EXPECT_EQ(somestate.GetNominalState(), expected);
+
+  // Copies get their own storage.
+  EKFState copied_state = somestate;
+  EKFState assigned_state;
+  assigned_state = somestate;
+  somestate.Set<a>(Eigen::Vector3d::Zero());
+  const EKFState& const_ref_copied_state = copied_state;
+  const EKFState& const_ref_assigned_state = assigned_state;
+  EXPECT_EQ(const_ref_copied_state.Get<a>(), Eigen::Vector3d(1, 2, 3));
+  EXPECT_EQ(const_ref_assigned_state.Get<a>(), Eigen::Vector3d(1, 2, 3));
+  EXPECT_EQ(copied_state.GetNominalState(), expected);
+  EXPECT_EQ(const_ref_copied_state.Get<c>()(0), 7);
+  EXPECT_EQ(const_ref_copied_state.Get<a>().data(),
+            copied_state.GetNominalState().data());
+}
+
+// Tests that the cached rotation matrices follow the writes to the state.
+TEST(MSF_Core, RuntimeTimeComputation_RotationMatrixCache) {
+  using namespace msf_core;
+  enum StateDefinition {
+    a,
+    b,
+    c
+  };
+
+  typedef boost::fusion::vector<
+      StateVar_T<Eigen::Quaterniond, a>,
+      StateVar_T<Eigen::Matrix<double, 3, 1>, b>,
+      StateVar_T<Eigen::Quaterniond, c>
+  > fullState_T;
+  typedef GenericState_T<fullState_T, StateDefinition> EKFState;
+
+  EXPECT_EQ(EKFState::nRotationCacheSlotsAtCompileTime, 2);
+
+  EKFState somestate;
+  const EKFState& const_ref_state = somestate;
+  EXPECT_TRUE(const_ref_state.GetRotationMatrix<a>().isIdentity());
+
+  Eigen::Quaterniond q(0.3, 0.1, 0.2, 0.7);
+  q.normalize();
+  somestate.Set<a>(q);
+  somestate.Set<c>(q.conjugate());
+  EXPECT_TRUE(const_ref_state.GetRotationMatrix<a>().isApprox(
+      q.toRotationMatrix()));
+  EXPECT_TRUE(const_ref_state.GetRotationMatrix<c>().isApprox(
+      q.toRotationMatrix().transpose()));
+
+  Eigen::Matrix<double, EKFState::nErrorStatesAtCompileTime, 1> correction;
+  correction.setZero();
+  correction(2) = 0.1;
+  somestate.Correct(correction);
+  EXPECT_TRUE(const_ref_state.GetRotationMatrix<a>().isApprox(
+      const_ref_state.Get<a>().toRotationMatrix()));
+  EXPECT_FALSE(const_ref_state.GetRotationMatrix<a>().isApprox(
+      q.toRotationMatrix()));
+
+  const EKFState copied_state = somestate;
+  EXPECT_TRUE(copied_state.GetRotationMatrix<a>().isApprox(
+      const_ref_state.Get<a>().toRotationMatrix()));
+  EXPECT_TRUE(copied_state.GetRotationMatrix<c>().isApprox(
+      q.toRotationMatrix().transpose()));
+}
+
 MSF_UNITTEST_ENTRYPOINT
@@ -0,0 +1,416 @@
+/*
+ * Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <slynen at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Offline distortion and fault injection: reads a bag, distorts pose and
+ * position topics with a random walk drift, injects latency, timestamp jitter,
+ * dropouts, bursts and out-of-order delivery on the measurement topics,
+ * decimates the IMU and writes the result to a new bag.
+ *
+ * Latency, bursts and reordering shift the time a message is recorded at
+ * (its arrival time when the bag is replayed), jitter shifts the header stamp
+ * (its measurement time). All other topics are copied unchanged.
+ *
+ * usage: msf_distort_bag input.bag output.bag [--option=value ...]
+ */
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/foreach.hpp>
+#include <ros/ros.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <sensor_msgs/Imu.h>
+#include <geometry_msgs/PointStamped.h>
+#include <geometry_msgs/PoseStamped.h>
+#include <geometry_msgs/PoseWithCovarianceStamped.h>
+#include <geometry_msgs/TransformStamped.h>
+#include <sensor_fusion_comm/PointWithCovarianceStamped.h>
+#include <msf_core/msf_macros.h>
+#include <msf_core/msf_ratelimiter.h>
+#include <msf_updates/PoseDistorter.h>
+
+namespace {
+
+/// Parses --name=value command line options.
+class Options {
+ public:
+  Options(int argc, char** argv, int first) {
+    for (int i = first; i < argc; ++i) {
+      std::string arg(argv[i]);
+      size_t eq = arg.find('=');
+      if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos) {
+        MSF_WARN_STREAM("Ignoring malformed option " << arg);
+        continue;
+      }
+      values_[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+    }
+  }
+
+  template<typename T>
+  T Get(const std::string& name, const T& default_value) {
+    used_.insert(name);
+    std::map<std::string, std::string>::const_iterator it = values_.find(name);
+    if (it == values_.end())
+      return default_value;
+    T value;
+    std::istringstream ss(it->second);
+    ss >> value;
+    if (ss.fail()) {
+      MSF_WARN_STREAM("Could not parse option " << name << "=" << it->second
+                      << ", using default " << default_value);
+      return default_value;
+    }
+    return value;
+  }
+
+  /// Returns a comma separated list option.
+  std::vector<std::string> GetList(const std::string& name) {
+    std::vector<std::string> list;
+    std::istringstream ss(Get<std::string>(name, ""));
+    std::string item;
+    while (std::getline(ss, item, ','))
+      if (!item.empty())
+        list.push_back(item);
+    return list;
+  }
+
+  void WarnUnused() const {
+    typedef std::map<std::string, std::string>::value_type Option_T;
+    BOOST_FOREACH(const Option_T& option, values_) {
+      MSF_WARN_STREAM_COND(used_.count(option.first) == 0,
+                           "Unknown option --" << option.first);
+    }
+  }
+
+ private:
+  std::map<std::string, std::string> values_;
+  std::set<std::string> used_;
+};
+
+/// Faults applied to all measurement topics.
+struct FaultConfig {
+  double latency;  ///< Constant arrival delay [s].
+  double jitter_stddev;  ///< Stddev of the header stamp noise [s].
+  double dropout_probability;  ///< Probability to drop a single message.
+  double burst_probability;  ///< Probability that a message starts a burst.
+  double burst_duration;  ///< Messages in a burst arrive together at its end.
+  double reorder_probability;  ///< Probability to delay a single message.
+  double reorder_delay;  ///< Extra delay of reordered messages [s].
+};
+
+/// Counters reported at the end of a run.
+struct TopicStatistics {
+  TopicStatistics()
+      : read(0),
+        written(0),
+        dropped(0),
+        bursted(0),
+        reordered(0) {
+  }
+  size_t read;
+  size_t written;
+  size_t dropped;
+  size_t bursted;
+  size_t reordered;
+};
+
+/// Per topic fault state.
+struct TopicState {
+  TopicState()
+      : burst_end(0),
+        last_stamp(0) {
+  }
+  double burst_end;  ///< Arrival time of the current burst, 0 if none.
+  double last_stamp;  ///< Header stamp of the last distorted message.
+  msf_updates::PoseDistorter::Ptr distorter;
+  TopicStatistics stats;
+};
+
+class BagDistorter {
+ public:
+  BagDistorter(const FaultConfig& faults, unsigned int seed)
+      : faults_(faults),
+        gen_(seed),
+        imu_read_(0),
+        imu_written_(0) {
+  }
+
+  void AddDriftTopic(const std::string& topic,
+                     const msf_updates::PoseDistorter::Ptr& distorter) {
+    topics_[topic].distorter = distorter;
+  }
+
+  void AddFaultTopic(const std::string& topic) {
+    topics_[topic];
+  }
+
+  void SetImu(const std::string& topic, double rate) {
+    imu_topic_ = topic;
+    imu_rate_limiter_.SetMaxRate(rate);
+  }
+
+  void Process(rosbag::Bag& in, rosbag::Bag& out) {
+    rosbag::View view(in);
+    BOOST_FOREACH(const rosbag::MessageInstance& m, view) {
+      const std::string& topic = m.getTopic();
+      if (topic == imu_topic_) {
+        ProcessImu(m, out);
+        continue;
+      }
+      std::map<std::string, TopicState>::iterator it = topics_.find(topic);
+      if (it == topics_.end()) {
+        out.write(topic, m.getTime(), m, m.getConnectionHeader());
+        continue;
+      }
+      if (!(Process<geometry_msgs::PoseWithCovarianceStamped>(m, it->second, out)
+          || Process<geometry_msgs::TransformStamped>(m, it->second, out)
+          || Process<geometry_msgs::PoseStamped>(m, it->second, out)
+          || Process<geometry_msgs::PointStamped>(m, it->second, out)
+          || Process<sensor_fusion_comm::PointWithCovarianceStamped>(
+              m, it->second, out))) {
+        MSF_WARN_STREAM_ONCE(
+            "Topic " << topic << " has unsupported type " << m.getDataType()
+            << ", copying it unchanged");
+        out.write(topic, m.getTime(), m, m.getConnectionHeader());
+      }
+    }
+  }
+
+  void PrintStatistics() const {
+    typedef std::map<std::string, TopicState>::value_type Topic_T;
+    BOOST_FOREACH(const Topic_T& topic, topics_) {
+      const TopicStatistics& s = topic.second.stats;
+      MSF_INFO_STREAM(
+          topic.first << ": read " << s.read << " written " << s.written
+          << " dropped " << s.dropped << " bursted " << s.bursted
+          << " reordered " << s.reordered);
+    }
+    MSF_INFO_STREAM_COND(
+        !imu_topic_.empty(),
+        imu_topic_ << ": read " << imu_read_ << " written " << imu_written_);
+  }
+
+ private:
+  FaultConfig faults_;
+  std::mt19937 gen_;
+  std::map<std::string, TopicState> topics_;
+  std::string imu_topic_;
+  /// Decimates the IMU like the sensor handlers decimate their readings.
+  msf_core::MeasurementRateLimiter imu_rate_limiter_;
+  size_t imu_read_;
+  size_t imu_written_;
+
+  bool Draw(double probability) {
+    if (probability <= 0)
+      return false;
+    return std::bernoulli_distribution(probability)(gen_);
+  }
+
+  void ProcessImu(const rosbag::MessageInstance& m, rosbag::Bag& out) {
+    ++imu_read_;
+    sensor_msgs::Imu::ConstPtr msg = m.instantiate<sensor_msgs::Imu>();
+    // Decimate on a fixed grid of time stamps, not by sequence number, so
+    // drops in the input do not change the output rate.
+    if (msg && !imu_rate_limiter_.Accept(msg->header.stamp.toSec()))
+      return;
+    ++imu_written_;
+    out.write(m.getTopic(), m.getTime(), m, m.getConnectionHeader());
+  }
+
+  /// Drifts the position and attitude of the supported message types.
+  void Distort(geometry_msgs::PoseWithCovarianceStamped& msg,
+               msf_updates::PoseDistorter& distorter, double dt) {
+    Distort(msg.pose.pose.position, msg.pose.pose.orientation, distorter, dt);
+  }
+  void Distort(geometry_msgs::PoseStamped& msg,
+               msf_updates::PoseDistorter& distorter, double dt) {
+    Distort(msg.pose.position, msg.pose.orientation, distorter, dt);
+  }
+  void Distort(geometry_msgs::TransformStamped& msg,
+               msf_updates::PoseDistorter& distorter, double dt) {
+    Distort(msg.transform.translation, msg.transform.rotation, distorter, dt);
+  }
+  void Distort(geometry_msgs::PointStamped& msg,
+               msf_updates::PoseDistorter& distorter, double dt) {
+    Distort(msg.point, distorter, dt);
+  }
+  void Distort(sensor_fusion_comm::PointWithCovarianceStamped& msg,
+               msf_updates::PoseDistorter& distorter, double dt) {
+    Distort(msg.point, distorter, dt);
+  }
+
+  template<typename Point_T>
+  void Distort(Point_T& p, msf_updates::PoseDistorter& distorter, double dt) {
+    Eigen::Vector3d pos(p.x, p.y, p.z);
+    distorter.Distort(pos, dt);
+    p.x = pos.x();
+    p.y = pos.y();
+    p.z = pos.z();
+  }
+
+  template<typename Point_T>
+  void Distort(Point_T& p, geometry_msgs::Quaternion& q,
+               msf_updates::PoseDistorter& distorter, double dt) {
+    Distort(p, distorter, dt);
+    Eigen::Quaterniond att(q.w, q.x, q.y, q.z);
+    distorter.Distort(att, dt);
+    q.w = att.w();
+    q.x = att.x();
+    q.y = att.y();
+    q.z = att.z();
+  }
+
+  template<typename Msg_T>
+  bool Process(const rosbag::MessageInstance& m, TopicState& state,
+               rosbag::Bag& out) {
+    boost::shared_ptr<Msg_T> msg = m.instantiate<Msg_T>();
+    if (!msg)
+      return false;
+
+    ++state.stats.read;
+    const double stamp = msg->header.stamp.toSec();
+    double arrival = m.getTime().toSec() + faults_.latency;
+
+    if (state.distorter) {
+      const double dt = state.last_stamp > 0 ? stamp - state.last_stamp : 0;
+      state.last_stamp = stamp;
+      Distort(*msg, *state.distorter, dt);
+    }
+
+    if (Draw(faults_.dropout_probability)) {
+      ++state.stats.dropped;
+      return true;
+    }
+
+    // Messages inside a burst window are held back and arrive together.
+    if (arrival < state.burst_end) {
+      arrival = state.burst_end;
+      ++state.stats.bursted;
+    } else if (Draw(faults_.burst_probability)) {
+      state.burst_end = arrival + faults_.burst_duration;
+      arrival = state.burst_end;
+      ++state.stats.bursted;
+    } else if (Draw(faults_.reorder_probability)) {
+      arrival += faults_.reorder_delay;
+      ++state.stats.reordered;
+    }
+
+    if (faults_.jitter_stddev > 0) {
+      std::normal_distribution<> jitter(0, faults_.jitter_stddev);
+      msg->header.stamp = ros::Time(std::max(0.0, stamp + jitter(gen_)));
+    }
+
+    out.write(m.getTopic(), ros::Time(arrival), msg, m.getConnectionHeader());
+    ++state.stats.written;
+    return true;
+  }
+};
+}  // namespace
+
+int main(int argc, char** argv) {
+  ros::Time::init();
+
+  enum argIndices {
+    inbag = 1,
+    outbag = 2,
+    firstOption = 3
+  };
+
+  if (argc < firstOption) {
+    MSF_ERROR_STREAM(
+        "usage: " << argv[0] << " input.bag output.bag [--option=value ...]\n"
+        "options:\n"
+        "\t--pose_topics=a,b       pose topics to drift and fault\n"
+        "\t--position_topics=a,b   position topics to drift and fault\n"
+        "\t--fault_topics=a,b      additional topics to fault, no drift\n"
+        "\t--imu_topic=t --imu_rate=hz  decimate the imu to the given rate\n"
+        "\t--seed=n                random seed, same seed same output\n"
+        "\t--distortpos_mean --distortpos_stddev\n"
+        "\t--distortatt_mean --distortatt_stddev\n"
+        "\t--distortscale_mean --distortscale_stddev\n"
+        "\t--latency --jitter_stddev --dropout_probability\n"
+        "\t--burst_probability --burst_duration\n"
+        "\t--reorder_probability --reorder_delay");
+    return -1;
+  }
+
+  Options options(argc, argv, firstOption);
+
+  const unsigned int seed = options.Get<unsigned int>("seed", 0);
+
+  FaultConfig faults;
+  faults.latency = options.Get("latency", 0.0);
+  faults.jitter_stddev = options.Get("jitter_stddev", 0.0);
+  faults.dropout_probability = options.Get("dropout_probability", 0.0);
+  faults.burst_probability = options.Get("burst_probability", 0.0);
+  faults.burst_duration = options.Get("burst_duration", 0.2);
+  faults.reorder_probability = options.Get("reorder_probability", 0.0);
+  faults.reorder_delay = options.Get("reorder_delay", 0.1);
+
+  // Same parameter names as the pose sensor handler.
+  const Eigen::Vector3d meanpos = Eigen::Vector3d::Constant(
+      options.Get("distortpos_mean", 0.0));
+  const Eigen::Vector3d stddevpos = Eigen::Vector3d::Constant(
+      options.Get("distortpos_stddev", 0.0));
+  const Eigen::Vector3d meanatt = Eigen::Vector3d::Constant(
+      options.Get("distortatt_mean", 0.0));
+  const Eigen::Vector3d stddevatt = Eigen::Vector3d::Constant(
+      options.Get("distortatt_stddev", 0.0));
+  const double meanscale = options.Get("distortscale_mean", 0.0);
+  const double stddevscale = options.Get("distortscale_stddev", 0.0);
+
+  BagDistorter distorter(faults, seed);
+
+  std::vector<std::string> drift_topics = options.GetList("pose_topics");
+  std::vector<std::string> position_topics = options.GetList("position_topics");
+  drift_topics.insert(drift_topics.end(), position_topics.begin(),
+                      position_topics.end());
+  for (size_t i = 0; i < drift_topics.size(); ++i) {
+    // Every topic gets its own drift, derived from the global seed.
+    distorter.AddDriftTopic(
+        drift_topics[i],
+        msf_updates::PoseDistorter::Ptr(
+            new msf_updates::PoseDistorter(meanpos, stddevpos, meanatt,
+                                           stddevatt, meanscale, stddevscale,
+                                           seed + i + 1)));
+  }
+  BOOST_FOREACH(const std::string& topic, options.GetList("fault_topics")) {
+    distorter.AddFaultTopic(topic);
+  }
+  distorter.SetImu(options.Get<std::string>("imu_topic", ""),
+                   options.Get("imu_rate", 0.0));
+
+  options.WarnUnused();
+
+  rosbag::Bag in(argv[inbag], rosbag::bagmode::Read);
+  rosbag::Bag out(argv[outbag], rosbag::bagmode::Write);
+
+  MSF_INFO_STREAM("Distorting " << argv[inbag] << " into " << argv[outbag]);
+  distorter.Process(in, out);
+  distorter.PrintStatistics();
+
+  in.close();
+  out.close();
+  return 0;
+}
@@ -18,38 +18,109 @@
 #define POSEDISTORTER_H_
 
 #include <Eigen/Dense>
+#include <Eigen/StdVector>
 #include <random>
 #include <cmath>
+#include <vector>
 #include <msf_core/msf_types.h>
 #include <msf_core/msf_fwds.h>
 
 namespace msf_updates {
 
+/** \class PoseDistorter
+ *
+ * \brief Adds a random walk drift in position, attitude and scale to poses.
+ * All random numbers are drawn from a single standard normal stream in the
+ * order position (x y z), scale, attitude (x y z) per sample. A distorter
+ * constructed with a given seed therefore draws the same random sequence
+ * through the single sample and the batch interface.
+ */
 class PoseDistorter {
  public:
   typedef std::normal_distribution<> distribution_t;
   typedef shared_ptr<PoseDistorter> Ptr;
+  typedef std::vector<Eigen::Vector3d> PositionVector;
+  typedef std::vector<Eigen::Quaterniond,
+      Eigen::aligned_allocator<Eigen::Quaterniond> > AttitudeVector;
+  enum {
+    /// Number of random draws per distorted pose: position, scale, attitude.
+    nDrawsPerSample = 7
+  };
  private:
+  typedef Eigen::Matrix<double, nDrawsPerSample, 1> DrawVector;
+  typedef Eigen::Matrix<double, nDrawsPerSample, Eigen::Dynamic> DrawMatrix;
+
   Eigen::Vector3d posdrift_;
   Eigen::Quaterniond attdrift_;
   double scaledrift_;
 
-  std::random_device rd_;
   std::mt19937 gen_;
+  distribution_t d_std_;  ///< Standard normal, scaled by mean_ and stddev_.
+
+  DrawVector mean_;  ///< Drift means in draw order.
+  DrawVector stddev_;  ///< Drift standard deviations in draw order.
+  DrawMatrix draws_;  ///< Workspace for the batch interface.
 
-  distribution_t d_pos_[3];
-  distribution_t d_att_[3];
-  distribution_t d_scale;
+  bool verbose_;
+
+  void Init(const Eigen::Vector3d& meanposdrift,
+            const Eigen::Vector3d& stddevposdrift,
+            const Eigen::Vector3d& meanattdrift,
+            const Eigen::Vector3d& stddevattdrift,
+            const double meanscaledrift, const double stddevscaledrift);
+  /// Draws n samples of all drift rates into draws_, scaled by dt.
+  void DrawRates(size_t n, double dt);
+  void ApplyPosition(Eigen::Vector3d& pos, const Eigen::Vector3d& deltapos,
+                     double deltascale);
+  void ApplyAttitude(Eigen::Quaterniond& att, const Eigen::Vector3d& rpydist);
  public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  /// Seeds the generator from std::random_device, runs are not reproducible.
   PoseDistorter(const Eigen::Vector3d& meanposdrift,
                 const Eigen::Vector3d& stddevposdrift,
                 const Eigen::Vector3d& meanattdrift,
                 const Eigen::Vector3d& stddevattdrift,
                 const double meanscaledrift, const double stddevscaledrift);
+  /// Seeds the generator with the given seed, runs are reproducible.
+  PoseDistorter(const Eigen::Vector3d& meanposdrift,
+                const Eigen::Vector3d& stddevposdrift,
+                const Eigen::Vector3d& meanattdrift,
+                const Eigen::Vector3d& stddevattdrift,
+                const double meanscaledrift, const double stddevscaledrift,
+                unsigned int seed);
+  virtual ~PoseDistorter();
+
+  /// Re-seeds the generator and resets the accumulated drift.
+  void Reset(unsigned int seed);
+  /// Enables logging of the accumulated drift on every distortion.
+  void SetVerbose(bool verbose) {
+    verbose_ = verbose;
+  }
+  const Eigen::Vector3d& GetPositionDrift() const {
+    return posdrift_;
+  }
+  const Eigen::Quaterniond& GetAttitudeDrift() const {
+    return attdrift_;
+  }
+  double GetScaleDrift() const {
+    return scaledrift_;
+  }
+
   void Distort(Eigen::Vector3d& pos, Eigen::Quaterniond& att, double dt);
   void Distort(Eigen::Vector3d& pos, double dt);
   void Distort(Eigen::Quaterniond& att, double dt);
-  virtual ~PoseDistorter();
+
+  /**
+   * \brief Distorts a sequence of poses sampled at a fixed dt. The random
+   * numbers for the whole sequence are drawn in one pass before the drift is
+   * accumulated. Both vectors must have the same size.
+   */
+  void Distort(PositionVector& pos, AttitudeVector& att, double dt);
+  /// Distorts a sequence of positions sampled at a fixed dt.
+  void Distort(PositionVector& pos, double dt);
+  /// Distorts a sequence of attitudes sampled at a fixed dt.
+  void Distort(AttitudeVector& att, double dt);
 };
 
 }  // namespace msf_updates
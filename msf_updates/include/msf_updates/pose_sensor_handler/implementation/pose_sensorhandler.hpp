@@ -31,8 +31,7 @@ PoseSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::PoseSensorHandler(
                                            parameternamespace),
       n_zp_(1e-6),
       n_zq_(1e-6),
-      delay_(0),
-      timestamp_previous_pose_(0) {
+      delay_(0) {
   ros::NodeHandle pnh("~/" + parameternamespace);
 
   MSF_INFO_STREAM(
@@ -43,8 +42,35 @@ PoseSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::PoseSensorHandler(
             true);
   pnh.param("pose_measurement_world_sensor", measurement_world_sensor_, true);
   pnh.param("pose_use_fixed_covariance", use_fixed_covariance_, false);
-  pnh.param("pose_measurement_minimum_dt", pose_measurement_minimum_dt_, 0.05);
 
+  // Maximum rate of pose updates [Hz], zero processes every reading. The
+  // transform input (e.g. Vicon) is limited to 20 Hz unless it is set.
+  double max_rate = 0;
+  double max_rate_transform = 20;
+  double minimum_dt;
+  if (pnh.getParam("pose_max_rate", max_rate)) {
+    max_rate_transform = max_rate;
+  } else if (pnh.getParam("pose_measurement_minimum_dt", minimum_dt)) {
+    // It used to throttle only the transform input.
+    MSF_WARN_STREAM("pose_measurement_minimum_dt is deprecated, use "
+                    "pose_max_rate instead");
+    max_rate_transform = minimum_dt > 0 ? 1 / minimum_dt : 0;
+  }
+  bool average_throttled;
+  pnh.param("pose_average_throttled", average_throttled, false);
+  rate_limiter_.SetMaxRate(max_rate);
+  rate_limiter_.SetAverageDropped(average_throttled);
+  rate_limiter_transform_.SetMaxRate(max_rate_transform);
+  rate_limiter_transform_.SetAverageDropped(average_throttled);
+  // Low priority sensors are decimated first if the core can not keep up.
+  pnh.param("pose_low_priority", low_priority_, false);
+  MSF_INFO_STREAM_COND(max_rate > 0, "Pose sensor is limited to " << max_rate
+                       << " Hz" << (average_throttled ? ", averaging the "
+                           "dropped readings" : ""));
+  MSF_INFO_STREAM_COND(max_rate_transform != max_rate
+                       && max_rate_transform > 0,
+                       "Pose sensor transform input is limited to "
+                       << max_rate_transform << " Hz");
 
   MSF_INFO_STREAM_COND(measurement_world_sensor_, "Pose sensor is interpreting "
                        "measurement as sensor w.r.t. world");
@@ -73,6 +99,9 @@ PoseSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::PoseSensorHandler(
       > ("transform_input", 20, &PoseSensorHandler::MeasurementCallback, this);
   subPoseStamped_ = nh.subscribe < geometry_msgs::PoseStamped
       > ("pose_input", 20, &PoseSensorHandler::MeasurementCallback, this);
+  subPoseArray_ = nh.subscribe < sensor_fusion_comm::PoseWithCovarianceArrayStamped
+      > ("pose_array_input", 20, &PoseSensorHandler::MeasurementCallback, this);
+  this->SetIngestionQueueSize(20);
 
   z_p_.setZero();
   z_q_.setIdentity();
@@ -103,9 +132,24 @@ PoseSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::PoseSensorHandler(
     double distortscale_stddev;
     pnh.param("distortscale_stddev", distortscale_stddev, 0.0);
 
-    distorter_.reset(
-        new msf_updates::PoseDistorter(meanpos, stddevpos, meanatt, stddevatt,
-                                       distortscale_mean, distortscale_stddev));
+    // A non negative seed makes the distortion reproducible across runs.
+    int distort_seed;
+    pnh.param("distort_seed", distort_seed, -1);
+    bool distort_verbose;
+    pnh.param("distort_verbose", distort_verbose, false);
+
+    if (distort_seed >= 0) {
+      distorter_.reset(
+          new msf_updates::PoseDistorter(meanpos, stddevpos, meanatt, stddevatt,
+                                         distortscale_mean, distortscale_stddev,
+                                         distort_seed));
+    } else {
+      distorter_.reset(
+          new msf_updates::PoseDistorter(meanpos, stddevpos, meanatt, stddevatt,
+                                         distortscale_mean,
+                                         distortscale_stddev));
+    }
+    distorter_->SetVerbose(distort_verbose);
   }
 }
 
@@ -122,10 +166,7 @@ void PoseSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::SetDelay(double delay) {
 }
 
 template<typename MEASUREMENT_TYPE, typename MANAGER_TYPE>
-void PoseSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::ProcessPoseMeasurement(
-    const geometry_msgs::PoseWithCovarianceStampedConstPtr & msg) {
-  received_first_measurement_ = true;
-
+int PoseSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::GetFixedStates() {
   // Get the fixed states.
   int fixedstates = 0;
   static_assert(msf_updates::EKFState::nStateVarsAtCompileTime < 32, "Your state "
@@ -157,6 +198,55 @@ void PoseSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::ProcessPoseMeasurement(
       fixedstates |= 1 << MEASUREMENT_TYPE::AuxState::q_wv;
     }
   }
+  return fixedstates;
+}
+
+template<typename MEASUREMENT_TYPE, typename MANAGER_TYPE>
+void PoseSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::ProcessPoseMeasurement(
+    const geometry_msgs::PoseWithCovarianceStamped& msg,
+    msf_core::MeasurementRateLimiter& rate_limiter) {
+  received_first_measurement_ = true;
+
+  const double timestamp = msg.header.stamp.toSec();
+  if (rate_limiter.AverageDropped()) {
+    const geometry_msgs::Pose& pose = msg.pose.pose;
+    Eigen::Matrix<double, 7, 1> reading;
+    reading << pose.position.x, pose.position.y, pose.position.z,
+        pose.orientation.x, pose.orientation.y, pose.orientation.z,
+        pose.orientation.w;
+    // q and -q are the same rotation, average on one hemisphere.
+    if (pose_averager_.Count() > 0
+        && reading.tail<4>().dot(pose_averager_.Mean().tail<4>()) < 0) {
+      reading.tail<4>() *= -1;
+    }
+    pose_averager_.Add(timestamp, reading);
+  }
+  if (!this->RateLimit(rate_limiter, timestamp)) {
+    return;
+  }
+
+  // Replace the reading by the mean of the readings dropped since the last
+  // update. The covariance is kept, which is conservative.
+  const geometry_msgs::PoseWithCovarianceStamped* reading = &msg;
+  geometry_msgs::PoseWithCovarianceStamped averaged;
+  if (pose_averager_.Count() > 1) {
+    averaged = msg;
+    const Eigen::Matrix<double, 7, 1> mean = pose_averager_.Mean();
+    Eigen::Quaterniond q_mean(mean(6), mean(3), mean(4), mean(5));
+    q_mean.normalize();
+    averaged.header.stamp = ros::Time(pose_averager_.MeanTimestamp());
+    averaged.pose.pose.position.x = mean(0);
+    averaged.pose.pose.position.y = mean(1);
+    averaged.pose.pose.position.z = mean(2);
+    averaged.pose.pose.orientation.w = q_mean.w();
+    averaged.pose.pose.orientation.x = q_mean.x();
+    averaged.pose.pose.orientation.y = q_mean.y();
+    averaged.pose.pose.orientation.z = q_mean.z();
+    reading = &averaged;
+  }
+  pose_averager_.Reset();
+
+  const int fixedstates = GetFixedStates();
 
   shared_ptr < MEASUREMENT_TYPE
       > meas(
@@ -165,7 +255,8 @@ void PoseSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::ProcessPoseMeasurement(
                                provides_absolute_measurements_, this->sensorID,
                                fixedstates, distorter_));
 
-  meas->MakeFromSensorReading(msg, msg->header.stamp.toSec() - delay_);
+  meas->MakeFromSensorReading(*reading,
+                              reading->header.stamp.toSec() - delay_);
 
   z_p_ = meas->z_p_;  //store this for the init procedure
   z_q_ = meas->z_q_;
@@ -177,37 +268,27 @@ void PoseSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::MeasurementCallback(
     const geometry_msgs::PoseWithCovarianceStampedConstPtr & msg) {
 
   this->SequenceWatchDog(msg->header.seq,
-                         subPoseWithCovarianceStamped_.getTopic());
+                         subPoseWithCovarianceStamped_.getTopic(),
+                         msg->header.stamp.toSec(),
+                         ros::Time::now().toSec());
   MSF_INFO_STREAM_ONCE(
       "*** pose sensor got first measurement from topic "
           << this->topic_namespace_ << "/"
           << subPoseWithCovarianceStamped_.getTopic() << " ***");
-  ProcessPoseMeasurement(msg);
+  ProcessPoseMeasurement(*msg, rate_limiter_);
 }
 
 template<typename MEASUREMENT_TYPE, typename MANAGER_TYPE>
 void PoseSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::MeasurementCallback(
     const geometry_msgs::TransformStampedConstPtr & msg) {
-  this->SequenceWatchDog(msg->header.seq, subTransformStamped_.getTopic());
+  this->SequenceWatchDog(msg->header.seq, subTransformStamped_.getTopic(),
+                         msg->header.stamp.toSec(),
+                         ros::Time::now().toSec());
   MSF_INFO_STREAM_ONCE(
       "*** pose sensor got first measurement from topic "
           << this->topic_namespace_ << "/" << subTransformStamped_.getTopic()
           << " ***");
 
-  double time_now = msg->header.stamp.toSec();
-  const double epsilon = 0.001; // Small time correction to avoid rounding errors in the timestamps.
-  if (time_now - timestamp_previous_pose_ <= pose_measurement_minimum_dt_ - epsilon) {
-    MSF_WARN_STREAM_THROTTLE(30, "Pose measurement throttling is on, dropping messages"
-                             "to be below " +
-                             std::to_string(1/pose_measurement_minimum_dt_) + " Hz");
-    return;
-  }
-
-  timestamp_previous_pose_ = time_now;
-
-  geometry_msgs::PoseWithCovarianceStampedPtr pose(
-      new geometry_msgs::PoseWithCovarianceStamped());
-
   if (!use_fixed_covariance_)  // Take covariance from sensor.
   {
     MSF_WARN_STREAM_THROTTLE(
@@ -217,33 +298,36 @@ void PoseSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::MeasurementCallback(
     return;
   }
 
-  // Fixed covariance will be set in measurement class -> MakeFromSensorReadingImpl.
-  pose->header = msg->header;
+  // The reading is only borrowed by the measurement, so it can live on the
+  // stack. The frame id is not used and not copied.
+  geometry_msgs::PoseWithCovarianceStamped pose;
+  pose.header.seq = msg->header.seq;
+  pose.header.stamp = msg->header.stamp;
 
-  pose->pose.pose.position.x = msg->transform.translation.x;
-  pose->pose.pose.position.y = msg->transform.translation.y;
-  pose->pose.pose.position.z = msg->transform.translation.z;
+  // Fixed covariance will be set in measurement class -> MakeFromSensorReadingImpl.
+  pose.pose.pose.position.x = msg->transform.translation.x;
+  pose.pose.pose.position.y = msg->transform.translation.y;
+  pose.pose.pose.position.z = msg->transform.translation.z;
 
-  pose->pose.pose.orientation.w = msg->transform.rotation.w;
-  pose->pose.pose.orientation.x = msg->transform.rotation.x;
-  pose->pose.pose.orientation.y = msg->transform.rotation.y;
-  pose->pose.pose.orientation.z = msg->transform.rotation.z;
+  pose.pose.pose.orientation.w = msg->transform.rotation.w;
+  pose.pose.pose.orientation.x = msg->transform.rotation.x;
+  pose.pose.pose.orientation.y = msg->transform.rotation.y;
+  pose.pose.pose.orientation.z = msg->transform.rotation.z;
 
-  ProcessPoseMeasurement(pose);
+  ProcessPoseMeasurement(pose, rate_limiter_transform_);
 }
 
 template<typename MEASUREMENT_TYPE, typename MANAGER_TYPE>
 void PoseSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::MeasurementCallback(
     const geometry_msgs::PoseStampedConstPtr & msg) {
-  this->SequenceWatchDog(msg->header.seq, subPoseStamped_.getTopic());
+  this->SequenceWatchDog(msg->header.seq, subPoseStamped_.getTopic(),
+                         msg->header.stamp.toSec(),
+                         ros::Time::now().toSec());
   MSF_INFO_STREAM_ONCE(
       "*** pose sensor got first measurement from topic "
           << this->topic_namespace_ << "/" << subPoseStamped_.getTopic()
           << " ***");
 
-  geometry_msgs::PoseWithCovarianceStampedPtr pose(
-      new geometry_msgs::PoseWithCovarianceStamped());
-
   if (!use_fixed_covariance_)  // Take covariance from sensor.
   {
     MSF_WARN_STREAM_THROTTLE(
@@ -254,12 +338,57 @@ void PoseSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::MeasurementCallback(
   }
 
   // Fixed covariance will be set in measurement class -> MakeFromSensorReadingImpl.
+  geometry_msgs::PoseWithCovarianceStamped pose;
+  pose.header.seq = msg->header.seq;
+  pose.header.stamp = msg->header.stamp;
+  pose.pose.pose = msg->pose;
+
+  ProcessPoseMeasurement(pose, rate_limiter_);
+}
+
+template<typename MEASUREMENT_TYPE, typename MANAGER_TYPE>
+void PoseSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::MeasurementCallback(
+    const sensor_fusion_comm::PoseWithCovarianceArrayStampedConstPtr & msg) {
+  this->SequenceWatchDog(msg->header.seq, subPoseArray_.getTopic(),
+                         msg->header.stamp.toSec(),
+                         ros::Time::now().toSec());
+  MSF_INFO_STREAM_ONCE(
+      "*** pose sensor got first measurement from topic "
+          << this->topic_namespace_ << "/" << subPoseArray_.getTopic()
+          << " ***");
+
+  if (!provides_absolute_measurements_) {
+    MSF_WARN_STREAM_THROTTLE(
+        2, "Pose arrays are only supported for absolute measurements. "
+        "Discarding message.");
+    return;
+  }
+  if (msg->poses.empty()) {
+    return;
+  }
+  received_first_measurement_ = true;
+
+  // The rate limiter drops whole frames, they are not averaged.
+  const double timestamp = msg->header.stamp.toSec();
+  if (!this->RateLimit(timestamp)) {
+    return;
+  }
+
+  // All poses of the frame are applied in one update.
+  shared_ptr<batch_measurement_t> meas(
+      new batch_measurement_t(n_zp_, n_zq_, measurement_world_sensor_,
+                              use_fixed_covariance_, this->sensorID,
+                              GetFixedStates()));
 
-  pose->header = msg->header;
+  meas->MakeFromSensorReading(*msg, timestamp - delay_);
+  if (meas->Size() == 0) {
+    return;
+  }
 
-  pose->pose.pose = msg->pose;
+  z_p_ = meas->GetPose(0).z_p_;  // Store this for the init procedure.
+  z_q_ = meas->GetPose(0).z_q_;
 
-  ProcessPoseMeasurement(pose);
+  this->manager_.msf_core_->AddMeasurement(meas);
 }
 }  // namespace msf_pose_sensor
 #endif  // POSE_SENSORHANDLER_HPP_
@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <slynen at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef POSE_BATCH_MEASUREMENT_HPP_
+#define POSE_BATCH_MEASUREMENT_HPP_
+
+#include <vector>
+#include <msf_core/msf_types.h>
+#include <msf_core/msf_measurement.h>
+#include <msf_core/msf_core.h>
+#include <sensor_fusion_comm/PoseWithCovarianceArrayStamped.h>
+
+namespace msf_updates {
+namespace pose_measurement {
+/**
+ * \brief Several poses observed at the same time, e.g. all fiducial markers
+ * detected in one camera frame. The poses are stacked into a single update,
+ * so the core corrects and repropagates once per frame instead of once per
+ * marker. Each pose is interpreted like a PoseMeasurement of type
+ * POSE_MEASUREMENT_TYPE, only absolute measurements are supported.
+ */
+template<typename POSE_MEASUREMENT_TYPE>
+struct PoseBatchMeasurement : public msf_core::MSF_Measurement<
+    sensor_fusion_comm::PoseWithCovarianceArrayStamped, Eigen::MatrixXd,
+    typename POSE_MEASUREMENT_TYPE::EKFState_T> {
+ private:
+  typedef typename POSE_MEASUREMENT_TYPE::EKFState_T EKFState_T;
+  typedef msf_core::MSF_Measurement<
+      sensor_fusion_comm::PoseWithCovarianceArrayStamped, Eigen::MatrixXd,
+      EKFState_T> Measurement_t;
+  typedef typename Measurement_t::Measurement_type measurement_t;
+
+  enum {
+    nErrorStates = msf_core::MSF_Core<EKFState_T>::nErrorStatesAtCompileTime,
+    nPoseMeasurements = 6  ///< Rows per pose, the yaw row is shared.
+  };
+
+  virtual void MakeFromSensorReadingImpl(const measurement_t& msg) {
+    poses_.clear();
+    ids_.clear();
+    poses_.reserve(msg.poses.size());
+    ids_.reserve(msg.poses.size());
+
+    for (size_t i = 0; i < msg.poses.size(); ++i) {
+      const int id = i < msg.ids.size() ? msg.ids[i] : static_cast<int>(i);
+      const boost::array<double, 36>& covariance = msg.poses[i].covariance;
+      if (!fixed_covariance_ && covariance[0] == 0) {
+        MSF_WARN_STREAM_THROTTLE(
+            2, "Pose " << id << " of the batch has no covariance but "
+            "fixed_covariance=false at the same time. Discarding this pose.");
+        continue;
+      }
+      geometry_msgs::PoseWithCovarianceStamped pose;
+      pose.header.seq = msg.header.seq;
+      pose.header.stamp = msg.header.stamp;
+      pose.pose = msg.poses[i];
+
+      POSE_MEASUREMENT_TYPE single(n_zp_, n_zq_, measurement_world_sensor_,
+                                  fixed_covariance_, true, this->sensorID_,
+                                  fixedstates_);
+      single.MakeFromSensorReading(pose, this->time);
+      poses_.push_back(single);
+      ids_.push_back(id);
+    }
+
+    // Block diagonal, the cross-correlations between the poses are unknown.
+    const int n_rows = nPoseMeasurements * poses_.size() + 1;
+    this->R_.setZero(n_rows, n_rows);
+    for (size_t i = 0; i < poses_.size(); ++i) {
+      this->R_.block(nPoseMeasurements * i, nPoseMeasurements * i,
+                     nPoseMeasurements, nPoseMeasurements) = poses_[i].GetR()
+          .template topLeftCorner<nPoseMeasurements, nPoseMeasurements>();
+    }
+    this->R_(n_rows - 1, n_rows - 1) = 1e-6;  // q_wv yaw-measurement noise
+  }
+
+  std::vector<POSE_MEASUREMENT_TYPE,
+      Eigen::aligned_allocator<POSE_MEASUREMENT_TYPE> > poses_;
+  std::vector<int> ids_;
+
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  double n_zp_, n_zq_;  /// Position and attitude measurement noise.
+  bool measurement_world_sensor_;
+  bool fixed_covariance_;
+  int fixedstates_;
+
+  PoseBatchMeasurement(double n_zp, double n_zq, bool measurement_world_sensor,
+                       bool fixed_covariance, int sensorID, int fixedstates)
+      : Measurement_t(true, sensorID),
+        n_zp_(n_zp),
+        n_zq_(n_zq),
+        measurement_world_sensor_(measurement_world_sensor),
+        fixed_covariance_(fixed_covariance),
+        fixedstates_(fixedstates) {
+  }
+  virtual ~PoseBatchMeasurement() {
+  }
+  virtual std::string Type() {
+    return "pose_batch";
+  }
+
+  /// The number of poses which are part of the update.
+  size_t Size() const {
+    return poses_.size();
+  }
+  const POSE_MEASUREMENT_TYPE& GetPose(size_t i) const {
+    return poses_[i];
+  }
+  int GetId(size_t i) const {
+    return ids_[i];
+  }
+
+  /**
+   * The method called by the msf_core to apply the measurement represented by
+   * this object.
+   */
+  virtual void Apply(shared_ptr<EKFState_T> state_nonconst_new,
+                     msf_core::MSF_Core<EKFState_T>& core) {
+    if (poses_.empty()) {
+      return;
+    }
+    // Get a const ref, so we can read core states.
+    const EKFState_T& state = *state_nonconst_new;
+
+    // All poses observe the same state, so H is the same for every pose.
+    Eigen::Matrix<double, nMeasurements, nErrorStates>
+        H_pose;
+    Eigen::Matrix<double, nMeasurements, 1> r_pose;
+    poses_.front().CalculateH(state_nonconst_new, H_pose);
+
+    const int n_rows = this->R_.rows();
+    Eigen::MatrixXd H(n_rows, static_cast<int>(nErrorStates));
+    Eigen::MatrixXd r(n_rows, 1);
+    for (size_t i = 0; i < poses_.size(); ++i) {
+      poses_[i].CalculateResidual(state, r_pose);
+      H.block(nPoseMeasurements * i, 0, nPoseMeasurements, nErrorStates) =
+          H_pose.template topRows<nPoseMeasurements>();
+      r.block(nPoseMeasurements * i, 0, nPoseMeasurements, 1) =
+          r_pose.template head<nPoseMeasurements>();
+    }
+    // Vision world yaw drift, the same for all poses.
+    H.row(n_rows - 1) = H_pose.template bottomRows<1>();
+    r(n_rows - 1, 0) = r_pose(nPoseMeasurements);
+
+    if (!CheckForNumeric(r, "r_old")) {
+      MSF_ERROR_STREAM("r_old: "<<r);
+      MSF_WARN_STREAM(
+          "state: "<<const_cast<EKFState_T&>(state). ToEigenVector().transpose());
+    }
+    if (!CheckForNumeric(H, "H_old")) {
+      MSF_ERROR_STREAM("H_old: "<<H);
+      MSF_WARN_STREAM(
+          "state: "<<const_cast<EKFState_T&>(state). ToEigenVector().transpose());
+    }
+
+    // Call update step in base class.
+    this->CalculateAndApplyCorrection(state_nonconst_new, core, H, r,
+                                      this->R_);
+  }
+};
+}  // namespace pose_measurement
+}  // namespace msf_updates
+#endif  // POSE_BATCH_MEASUREMENT_HPP_
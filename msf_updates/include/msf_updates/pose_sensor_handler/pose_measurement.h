@@ -23,6 +23,7 @@
 #include <msf_core/msf_measurement.h>
 #include <msf_core/msf_core.h>
 #include <msf_updates/PoseDistorter.h>
+#include <msf_updates/pose_sensor_handler/pose_measurement_kernels.h>
 
 namespace msf_updates {
 namespace pose_measurement {
@@ -45,9 +46,9 @@ template<
 struct PoseMeasurement : public PoseMeasurementBase {
  private:
   typedef PoseMeasurementBase Measurement_t;
-  typedef Measurement_t::Measurement_ptr measptr_t;
+  typedef Measurement_t::Measurement_type measurement_t;
 
-  virtual void MakeFromSensorReadingImpl(measptr_t msg) {
+  virtual void MakeFromSensorReadingImpl(const measurement_t& msg) {
     Eigen::Matrix<double, nMeasurements,
         msf_core::MSF_Core<msf_updates::EKFState>::nErrorStatesAtCompileTime> H_old;
     Eigen::Matrix<double, nMeasurements, 1> r_old;
@@ -55,13 +56,13 @@ struct PoseMeasurement : public PoseMeasurementBase {
     H_old.setZero();
 
     // Get measurements.
-    z_p_ = Eigen::Matrix<double, 3, 1>(msg->pose.pose.position.x,
-                                       msg->pose.pose.position.y,
-                                       msg->pose.pose.position.z);
-    z_q_ = Eigen::Quaternion<double>(msg->pose.pose.orientation.w,
-                                     msg->pose.pose.orientation.x,
-                                     msg->pose.pose.orientation.y,
-                                     msg->pose.pose.orientation.z);
+    z_p_ = Eigen::Matrix<double, 3, 1>(msg.pose.pose.position.x,
+                                       msg.pose.pose.position.y,
+                                       msg.pose.pose.position.z);
+    z_q_ = Eigen::Quaternion<double>(msg.pose.pose.orientation.w,
+                                     msg.pose.pose.orientation.x,
+                                     msg.pose.pose.orientation.y,
+                                     msg.pose.pose.orientation.z);
 
     if (distorter_) {
       static double tlast = 0;
@@ -80,9 +81,9 @@ struct PoseMeasurement : public PoseMeasurementBase {
               .finished().asDiagonal();
     } else {  // Take covariance from sensor.
       R_.block<6, 6>(0, 0) = Eigen::Matrix<double, 6, 6>(
-          &msg->pose.covariance[0]);
+          &msg.pose.covariance[0]);
 
-      if (msg->header.seq % 100 == 0) {  // Only do this check from time to time.
+      if (msg.header.seq % 100 == 0) {  // Only do this check from time to time.
         if (R_.block<6, 6>(0, 0).determinant() < -0.001)
           MSF_WARN_STREAM_THROTTLE(
               60,
@@ -162,25 +163,6 @@ struct PoseMeasurement : public PoseMeasurementBase {
 
     H.setZero();
 
-    // Get rotation matrices.
-    Eigen::Matrix<double, 3, 3> C_wv = state.Get<StateQwvIdx>()
-        .toRotationMatrix();
-    Eigen::Matrix<double, 3, 3> C_q = state.Get<StateDefinition_T::q>()
-        .toRotationMatrix();
-
-    Eigen::Matrix<double, 3, 3> C_ci = state.Get<StateQicIdx>()
-        .conjugate().toRotationMatrix();
-
-    // Preprocess for elements in H matrix.
-    Eigen::Matrix<double, 3, 1> vecold;
-
-    vecold = (-state.Get<StatePwvIdx>() + state.Get<StateDefinition_T::p>()
-        + C_q * state.Get<StatePicIdx>()) * state.Get<StateLIdx>();
-    Eigen::Matrix<double, 3, 3> skewold = Skew(vecold);
-
-    Eigen::Matrix<double, 3, 3> pci_sk = Skew(state.Get<StatePicIdx>());
-
-
     // Get indices of states in error vector.
     enum {
       kIdxstartcorr_p = msf_tmp::GetStartIndexInCorrection<StateSequence_T,
@@ -223,49 +205,26 @@ struct PoseMeasurement : public PoseMeasurementBase {
 
 
     // Construct H matrix.
-    // Position:
-    H.block<3, 3>(0, kIdxstartcorr_p) = C_wv
-        * state.Get<StateLIdx>()(0);  // p
-
-    H.block<3, 3>(0, kIdxstartcorr_q) = -C_wv * C_q * pci_sk
-        * state.Get<StateLIdx>()(0);  // q
-
-    H.block<3, 1>(0, kIdxstartcorr_L) =
-        scalefix ?
-            Eigen::Matrix<double, 3, 1>::Zero() :
-            (C_wv * C_q * state.Get<StatePicIdx>() + C_wv
-                    * (-state.Get<StatePwvIdx>()
-                        + state.Get<StateDefinition_T::p>())).eval();  // L
-
-    H.block<3, 3>(0, kIdxstartcorr_qwv) =
-        driftwvattfix ?
-            Eigen::Matrix<double, 3, 3>::Zero() : (-C_wv * skewold).eval();  // q_wv
-
-    H.block<3, 3>(0, kIdxstartcorr_pic) =
-        calibposfix ?
-            Eigen::Matrix<double, 3, 3>::Zero() :
-            (C_wv * C_q * state.Get<StateLIdx>()(0)).eval();  //p_ic
-
-
-    // TODO (slynen): Check scale commenting
-    H.block<3, 3>(0, kIdxstartcorr_pwv) =
-        driftwvposfix ?
-            Eigen::Matrix<double, 3, 3>::Zero() :
-            (-Eigen::Matrix<double, 3, 3>::Identity()
-            /* * state.Get<StateLIdx>()(0)*/).eval();  //p_wv
-
-    // Attitude.
-    H.block<3, 3>(3, kIdxstartcorr_q) = C_ci;  // q
-
-    H.block<3, 3>(3, kIdxstartcorr_qwv) =
-        driftwvattfix ?
-            Eigen::Matrix<double, 3, 3>::Zero() :
-            (C_ci * C_q.transpose()).eval();  // q_wv
-
-    H.block<3, 3>(3, kIdxstartcorr_qic) =
-        calibattfix ?
-            Eigen::Matrix<double, 3, 3>::Zero() :
-            Eigen::Matrix<double, 3, 3>::Identity().eval();  //q_ic
+    PoseJacobian(state.GetRotationMatrix<StateDefinition_T::q>(),
+                 state.GetRotationMatrix<StateQwvIdx>(),
+                 state.GetRotationMatrix<StateQicIdx>(),
+                 state.Get<StateDefinition_T::p>(), state.Get<StatePwvIdx>(),
+                 state.Get<StatePicIdx>(), state.Get<StateLIdx>()(0),
+                 kIdxstartcorr_p, kIdxstartcorr_q, kIdxstartcorr_L,
+                 kIdxstartcorr_qwv, kIdxstartcorr_pic, kIdxstartcorr_pwv,
+                 kIdxstartcorr_qic, H);
+
+    // Fixed states are not observed.
+    if (scalefix)
+      H.block<3, 1>(0, kIdxstartcorr_L).setZero();
+    if (driftwvattfix)
+      H.block<6, 3>(0, kIdxstartcorr_qwv).setZero();
+    if (calibposfix)
+      H.block<3, 3>(0, kIdxstartcorr_pic).setZero();
+    if (driftwvposfix)
+      H.block<3, 3>(0, kIdxstartcorr_pwv).setZero();
+    if (calibattfix)
+      H.block<3, 3>(3, kIdxstartcorr_qic).setZero();
 
     // This line breaks the filter if a position sensor in the global frame is
     // available or if we want to set a global yaw rotation.
@@ -274,6 +233,42 @@ struct PoseMeasurement : public PoseMeasurementBase {
 
   }
 
+  /**
+   * \brief The position the measurement expects in the given state.
+   */
+  void PredictPosition(const EKFState_T& state,
+                       Eigen::Matrix<double, 3, 1>& z_p) const {
+    PosePositionPrediction(state.GetRotationMatrix<StateDefinition_T::q>(),
+                           state.GetRotationMatrix<StateQwvIdx>(),
+                           state.Get<StateDefinition_T::p>(),
+                           state.Get<StatePwvIdx>(), state.Get<StatePicIdx>(),
+                           state.Get<StateLIdx>()(0), z_p);
+  }
+
+  /**
+   * \brief Residual of the absolute measurement against the given state.
+   */
+  void CalculateResidual(const EKFState_T& state,
+                         Eigen::Matrix<double, nMeasurements, 1>& r) const {
+    // Construct residuals.
+    // Position.
+    Eigen::Matrix<double, 3, 1> z_p;
+    PredictPosition(state, z_p);
+    r.block<3, 1>(0, 0) = z_p_ - z_p;
+
+    // Attitude.
+    Eigen::Quaternion<double> q_err;
+    q_err = (state.Get<StateQwvIdx>()
+        * state.Get<StateDefinition_T::q>()
+        * state.Get<StateQicIdx>()).conjugate() * z_q_;
+    r.block<3, 1>(3, 0) = q_err.vec() / q_err.w() * 2;
+    // Vision world yaw drift.
+    q_err = state.Get<StateQwvIdx>();
+
+    r(6, 0) = -2 * (q_err.w() * q_err.z() + q_err.x() * q_err.y())
+        / (1 - 2 * (q_err.y() * q_err.y() + q_err.z() * q_err.z()));
+  }
+
   /**
    * The method called by the msf_core to apply the measurement represented by
    * this object
@@ -292,33 +287,7 @@ struct PoseMeasurement : public PoseMeasurementBase {
 
       CalculateH(state_nonconst_new, H_new);
 
-      // Get rotation matrices.
-      Eigen::Matrix<double, 3, 3> C_wv = state.Get<StateQwvIdx>()
-
-          .conjugate().toRotationMatrix();
-      Eigen::Matrix<double, 3, 3> C_q = state.Get<StateDefinition_T::q>()
-          .conjugate().toRotationMatrix();
-
-      // Construct residuals.
-      // Position.
-      r_old.block<3, 1>(0, 0) = z_p_
-          - (C_wv.transpose()
-              * (-state.Get<StatePwvIdx>()
-                  + state.Get<StateDefinition_T::p>()
-                  + C_q.transpose() * state.Get<StatePicIdx>()))
-              * state.Get<StateLIdx>();
-
-      // Attitude.
-      Eigen::Quaternion<double> q_err;
-      q_err = (state.Get<StateQwvIdx>()
-          * state.Get<StateDefinition_T::q>()
-          * state.Get<StateQicIdx>()).conjugate() * z_q_;
-      r_old.block<3, 1>(3, 0) = q_err.vec() / q_err.w() * 2;
-      // Vision world yaw drift.
-      q_err = state.Get<StateQwvIdx>();
-
-      r_old(6, 0) = -2 * (q_err.w() * q_err.z() + q_err.x() * q_err.y())
-          / (1 - 2 * (q_err.y() * q_err.y() + q_err.z() * q_err.z()));
+      CalculateResidual(state, r_old);
 
       if (!CheckForNumeric(r_old, "r_old")) {
         MSF_ERROR_STREAM("r_old: "<<r_old);
@@ -387,27 +356,12 @@ struct PoseMeasurement : public PoseMeasurementBase {
       CalculateH(state_nonconst_new, H_new);
 
       //TODO (slynen): check that both measurements have the same states fixed!
-      Eigen::Matrix<double, 3, 3> C_wv_old, C_wv_new;
-      Eigen::Matrix<double, 3, 3> C_q_old, C_q_new;
-
-      C_wv_new = state_new.Get<StateQwvIdx>().conjugate().toRotationMatrix();
-      C_q_new = state_new.Get<StateDefinition_T::q>().conjugate()
-          .toRotationMatrix();
-
-      C_wv_old = state_old.Get<StateQwvIdx>().conjugate().toRotationMatrix();
-      C_q_old = state_old.Get<StateDefinition_T::q>().conjugate()
-          .toRotationMatrix();
-
       // Construct residuals.
       // Position:
-      Eigen::Matrix<double, 3, 1> diffprobpos = (C_wv_new.transpose()
-          * (-state_new.Get<StatePwvIdx>() + state_new.Get<StateDefinition_T::p>()
-              + C_q_new.transpose() * state_new.Get<StatePicIdx>()))
-          * state_new.Get<StateLIdx>() - (C_wv_old.transpose()
-          * (-state_old.Get<StatePwvIdx>() + state_old.Get<StateDefinition_T::p>()
-              + C_q_old.transpose() * state_old.Get<StatePicIdx>()))
-              * state_old.Get<StateLIdx>();
-
+      Eigen::Matrix<double, 3, 1> z_p_new, z_p_old;
+      PredictPosition(state_new, z_p_new);
+      PredictPosition(state_old, z_p_old);
+      Eigen::Matrix<double, 3, 1> diffprobpos = z_p_new - z_p_old;
 
       Eigen::Matrix<double, 3, 1> diffmeaspos = z_p_ - prevmeas->z_p_;
 
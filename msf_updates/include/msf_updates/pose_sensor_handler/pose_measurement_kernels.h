@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <slynen at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Generated by msf_updates/scripts/generate_measurement_kernels.py.
+// Do not edit, change the script and run it again.
+#ifndef POSE_MEASUREMENT_KERNELS_H_
+#define POSE_MEASUREMENT_KERNELS_H_
+
+#include <cmath>
+
+#include <Eigen/Dense>
+
+namespace msf_updates {
+namespace pose_measurement {
+/*
+ * Measurement Jacobian and prediction of the pose sensor.
+ */
+
+/**
+ * \brief H of the pose measurement: the rows of the position, then the ones of
+ * the attitude. C_q, C_wv and C_ic are the rotation matrices of q, q_wv and q_ic.
+ */
+template<typename Derived>
+inline void PoseJacobian(const Eigen::Matrix<double, 3, 3>& C_q,
+                         const Eigen::Matrix<double, 3, 3>& C_wv,
+                         const Eigen::Matrix<double, 3, 3>& C_ic,
+                         const Eigen::Matrix<double, 3, 1>& p,
+                         const Eigen::Matrix<double, 3, 1>& p_wv,
+                         const Eigen::Matrix<double, 3, 1>& p_ic,
+                         double L,
+                         int idxstartcorr_p,
+                         int idxstartcorr_q,
+                         int idxstartcorr_L,
+                         int idxstartcorr_q_wv,
+                         int idxstartcorr_p_ic,
+                         int idxstartcorr_p_wv,
+                         int idxstartcorr_q_ic,
+                         Eigen::MatrixBase<Derived>& H) {
+  const double C_q_00 = C_q(0, 0);
+  const double C_q_01 = C_q(0, 1);
+  const double C_q_02 = C_q(0, 2);
+  const double C_q_10 = C_q(1, 0);
+  const double C_q_11 = C_q(1, 1);
+  const double C_q_12 = C_q(1, 2);
+  const double C_q_20 = C_q(2, 0);
+  const double C_q_21 = C_q(2, 1);
+  const double C_q_22 = C_q(2, 2);
+  const double C_wv_00 = C_wv(0, 0);
+  const double C_wv_01 = C_wv(0, 1);
+  const double C_wv_02 = C_wv(0, 2);
+  const double C_wv_10 = C_wv(1, 0);
+  const double C_wv_11 = C_wv(1, 1);
+  const double C_wv_12 = C_wv(1, 2);
+  const double C_wv_20 = C_wv(2, 0);
+  const double C_wv_21 = C_wv(2, 1);
+  const double C_wv_22 = C_wv(2, 2);
+  const double C_ic_00 = C_ic(0, 0);
+  const double C_ic_01 = C_ic(0, 1);
+  const double C_ic_02 = C_ic(0, 2);
+  const double C_ic_10 = C_ic(1, 0);
+  const double C_ic_11 = C_ic(1, 1);
+  const double C_ic_12 = C_ic(1, 2);
+  const double C_ic_20 = C_ic(2, 0);
+  const double C_ic_21 = C_ic(2, 1);
+  const double C_ic_22 = C_ic(2, 2);
+  const double p_0 = p(0);
+  const double p_1 = p(1);
+  const double p_2 = p(2);
+  const double p_wv_0 = p_wv(0);
+  const double p_wv_1 = p_wv(1);
+  const double p_wv_2 = p_wv(2);
+  const double p_ic_0 = p_ic(0);
+  const double p_ic_1 = p_ic(1);
+  const double p_ic_2 = p_ic(2);
+
+  const double t0 = C_q_01 * p_ic_2 - C_q_02 * p_ic_1;
+  const double t1 = C_q_11 * p_ic_2 - C_q_12 * p_ic_1;
+  const double t2 = C_q_21 * p_ic_2 - C_q_22 * p_ic_1;
+  const double t3 = C_q_00 * p_ic_2 - C_q_02 * p_ic_0;
+  const double t4 = C_q_10 * p_ic_2 - C_q_12 * p_ic_0;
+  const double t5 = C_q_20 * p_ic_2 - C_q_22 * p_ic_0;
+  const double t6 = C_q_00 * p_ic_1 - C_q_01 * p_ic_0;
+  const double t7 = C_q_10 * p_ic_1 - C_q_11 * p_ic_0;
+  const double t8 = C_q_20 * p_ic_1 - C_q_21 * p_ic_0;
+  const double t9 = C_q_00 * p_ic_0 + C_q_01 * p_ic_1 + C_q_02 * p_ic_2 + p_0 - p_wv_0;
+  const double t10 = C_q_10 * p_ic_0 + C_q_11 * p_ic_1 + C_q_12 * p_ic_2 + p_1 - p_wv_1;
+  const double t11 = C_q_20 * p_ic_0 + C_q_21 * p_ic_1 + C_q_22 * p_ic_2 + p_2 - p_wv_2;
+
+  H(0, idxstartcorr_p + 0) = C_wv_00 * L;
+  H(0, idxstartcorr_p + 1) = C_wv_01 * L;
+  H(0, idxstartcorr_p + 2) = C_wv_02 * L;
+  H(1, idxstartcorr_p + 0) = C_wv_10 * L;
+  H(1, idxstartcorr_p + 1) = C_wv_11 * L;
+  H(1, idxstartcorr_p + 2) = C_wv_12 * L;
+  H(2, idxstartcorr_p + 0) = C_wv_20 * L;
+  H(2, idxstartcorr_p + 1) = C_wv_21 * L;
+  H(2, idxstartcorr_p + 2) = C_wv_22 * L;
+  H(0, idxstartcorr_q + 0) = -L * (C_wv_00 * t0 + C_wv_01 * t1 + C_wv_02 * t2);
+  H(0, idxstartcorr_q + 1) = L * (C_wv_00 * t3 + C_wv_01 * t4 + C_wv_02 * t5);
+  H(0, idxstartcorr_q + 2) = -L * (C_wv_00 * t6 + C_wv_01 * t7 + C_wv_02 * t8);
+  H(1, idxstartcorr_q + 0) = -L * (C_wv_10 * t0 + C_wv_11 * t1 + C_wv_12 * t2);
+  H(1, idxstartcorr_q + 1) = L * (C_wv_10 * t3 + C_wv_11 * t4 + C_wv_12 * t5);
+  H(1, idxstartcorr_q + 2) = -L * (C_wv_10 * t6 + C_wv_11 * t7 + C_wv_12 * t8);
+  H(2, idxstartcorr_q + 0) = -L * (C_wv_20 * t0 + C_wv_21 * t1 + C_wv_22 * t2);
+  H(2, idxstartcorr_q + 1) = L * (C_wv_20 * t3 + C_wv_21 * t4 + C_wv_22 * t5);
+  H(2, idxstartcorr_q + 2) = -L * (C_wv_20 * t6 + C_wv_21 * t7 + C_wv_22 * t8);
+  H(0, idxstartcorr_L + 0) = C_wv_00 * t9 + C_wv_01 * t10 + C_wv_02 * t11;
+  H(1, idxstartcorr_L + 0) = C_wv_10 * t9 + C_wv_11 * t10 + C_wv_12 * t11;
+  H(2, idxstartcorr_L + 0) = C_wv_20 * t9 + C_wv_21 * t10 + C_wv_22 * t11;
+  H(0, idxstartcorr_q_wv + 0) = -L * (C_wv_01 * t11 - C_wv_02 * t10);
+  H(0, idxstartcorr_q_wv + 1) = L * (C_wv_00 * t11 - C_wv_02 * t9);
+  H(0, idxstartcorr_q_wv + 2) = -L * (C_wv_00 * t10 - C_wv_01 * t9);
+  H(1, idxstartcorr_q_wv + 0) = -L * (C_wv_11 * t11 - C_wv_12 * t10);
+  H(1, idxstartcorr_q_wv + 1) = L * (C_wv_10 * t11 - C_wv_12 * t9);
+  H(1, idxstartcorr_q_wv + 2) = -L * (C_wv_10 * t10 - C_wv_11 * t9);
+  H(2, idxstartcorr_q_wv + 0) = -L * (C_wv_21 * t11 - C_wv_22 * t10);
+  H(2, idxstartcorr_q_wv + 1) = L * (C_wv_20 * t11 - C_wv_22 * t9);
+  H(2, idxstartcorr_q_wv + 2) = -L * (C_wv_20 * t10 - C_wv_21 * t9);
+  H(0, idxstartcorr_p_ic + 0) = L * (C_q_00 * C_wv_00 + C_q_10 * C_wv_01 + C_q_20 * C_wv_02);
+  H(0, idxstartcorr_p_ic + 1) = L * (C_q_01 * C_wv_00 + C_q_11 * C_wv_01 + C_q_21 * C_wv_02);
+  H(0, idxstartcorr_p_ic + 2) = L * (C_q_02 * C_wv_00 + C_q_12 * C_wv_01 + C_q_22 * C_wv_02);
+  H(1, idxstartcorr_p_ic + 0) = L * (C_q_00 * C_wv_10 + C_q_10 * C_wv_11 + C_q_20 * C_wv_12);
+  H(1, idxstartcorr_p_ic + 1) = L * (C_q_01 * C_wv_10 + C_q_11 * C_wv_11 + C_q_21 * C_wv_12);
+  H(1, idxstartcorr_p_ic + 2) = L * (C_q_02 * C_wv_10 + C_q_12 * C_wv_11 + C_q_22 * C_wv_12);
+  H(2, idxstartcorr_p_ic + 0) = L * (C_q_00 * C_wv_20 + C_q_10 * C_wv_21 + C_q_20 * C_wv_22);
+  H(2, idxstartcorr_p_ic + 1) = L * (C_q_01 * C_wv_20 + C_q_11 * C_wv_21 + C_q_21 * C_wv_22);
+  H(2, idxstartcorr_p_ic + 2) = L * (C_q_02 * C_wv_20 + C_q_12 * C_wv_21 + C_q_22 * C_wv_22);
+  H(0, idxstartcorr_p_wv + 0) = -1.0;
+  H(0, idxstartcorr_p_wv + 1) = 0.0;
+  H(0, idxstartcorr_p_wv + 2) = 0.0;
+  H(1, idxstartcorr_p_wv + 0) = 0.0;
+  H(1, idxstartcorr_p_wv + 1) = -1.0;
+  H(1, idxstartcorr_p_wv + 2) = 0.0;
+  H(2, idxstartcorr_p_wv + 0) = 0.0;
+  H(2, idxstartcorr_p_wv + 1) = 0.0;
+  H(2, idxstartcorr_p_wv + 2) = -1.0;
+  H(3, idxstartcorr_q + 0) = C_ic_00;
+  H(3, idxstartcorr_q + 1) = C_ic_10;
+  H(3, idxstartcorr_q + 2) = C_ic_20;
+  H(4, idxstartcorr_q + 0) = C_ic_01;
+  H(4, idxstartcorr_q + 1) = C_ic_11;
+  H(4, idxstartcorr_q + 2) = C_ic_21;
+  H(5, idxstartcorr_q + 0) = C_ic_02;
+  H(5, idxstartcorr_q + 1) = C_ic_12;
+  H(5, idxstartcorr_q + 2) = C_ic_22;
+  H(3, idxstartcorr_q_wv + 0) = C_ic_00 * C_q_00 + C_ic_10 * C_q_01 + C_ic_20 * C_q_02;
+  H(3, idxstartcorr_q_wv + 1) = C_ic_00 * C_q_10 + C_ic_10 * C_q_11 + C_ic_20 * C_q_12;
+  H(3, idxstartcorr_q_wv + 2) = C_ic_00 * C_q_20 + C_ic_10 * C_q_21 + C_ic_20 * C_q_22;
+  H(4, idxstartcorr_q_wv + 0) = C_ic_01 * C_q_00 + C_ic_11 * C_q_01 + C_ic_21 * C_q_02;
+  H(4, idxstartcorr_q_wv + 1) = C_ic_01 * C_q_10 + C_ic_11 * C_q_11 + C_ic_21 * C_q_12;
+  H(4, idxstartcorr_q_wv + 2) = C_ic_01 * C_q_20 + C_ic_11 * C_q_21 + C_ic_21 * C_q_22;
+  H(5, idxstartcorr_q_wv + 0) = C_ic_02 * C_q_00 + C_ic_12 * C_q_01 + C_ic_22 * C_q_02;
+  H(5, idxstartcorr_q_wv + 1) = C_ic_02 * C_q_10 + C_ic_12 * C_q_11 + C_ic_22 * C_q_12;
+  H(5, idxstartcorr_q_wv + 2) = C_ic_02 * C_q_20 + C_ic_12 * C_q_21 + C_ic_22 * C_q_22;
+  H(3, idxstartcorr_q_ic + 0) = 1.0;
+  H(3, idxstartcorr_q_ic + 1) = 0.0;
+  H(3, idxstartcorr_q_ic + 2) = 0.0;
+  H(4, idxstartcorr_q_ic + 0) = 0.0;
+  H(4, idxstartcorr_q_ic + 1) = 1.0;
+  H(4, idxstartcorr_q_ic + 2) = 0.0;
+  H(5, idxstartcorr_q_ic + 0) = 0.0;
+  H(5, idxstartcorr_q_ic + 1) = 0.0;
+  H(5, idxstartcorr_q_ic + 2) = 1.0;
+}
+
+/**
+ * \brief Position the pose measurement expects: C_wv * (p - p_wv + C_q * p_ic) * L.
+ */
+inline void PosePositionPrediction(const Eigen::Matrix<double, 3, 3>& C_q,
+                                   const Eigen::Matrix<double, 3, 3>& C_wv,
+                                   const Eigen::Matrix<double, 3, 1>& p,
+                                   const Eigen::Matrix<double, 3, 1>& p_wv,
+                                   const Eigen::Matrix<double, 3, 1>& p_ic,
+                                   double L,
+                                   Eigen::Matrix<double, 3, 1>& z_p) {
+  const double C_q_00 = C_q(0, 0);
+  const double C_q_01 = C_q(0, 1);
+  const double C_q_02 = C_q(0, 2);
+  const double C_q_10 = C_q(1, 0);
+  const double C_q_11 = C_q(1, 1);
+  const double C_q_12 = C_q(1, 2);
+  const double C_q_20 = C_q(2, 0);
+  const double C_q_21 = C_q(2, 1);
+  const double C_q_22 = C_q(2, 2);
+  const double C_wv_00 = C_wv(0, 0);
+  const double C_wv_01 = C_wv(0, 1);
+  const double C_wv_02 = C_wv(0, 2);
+  const double C_wv_10 = C_wv(1, 0);
+  const double C_wv_11 = C_wv(1, 1);
+  const double C_wv_12 = C_wv(1, 2);
+  const double C_wv_20 = C_wv(2, 0);
+  const double C_wv_21 = C_wv(2, 1);
+  const double C_wv_22 = C_wv(2, 2);
+  const double p_0 = p(0);
+  const double p_1 = p(1);
+  const double p_2 = p(2);
+  const double p_wv_0 = p_wv(0);
+  const double p_wv_1 = p_wv(1);
+  const double p_wv_2 = p_wv(2);
+  const double p_ic_0 = p_ic(0);
+  const double p_ic_1 = p_ic(1);
+  const double p_ic_2 = p_ic(2);
+
+  const double t0 = C_q_00 * p_ic_0 + C_q_01 * p_ic_1 + C_q_02 * p_ic_2 + p_0 - p_wv_0;
+  const double t1 = C_q_10 * p_ic_0 + C_q_11 * p_ic_1 + C_q_12 * p_ic_2 + p_1 - p_wv_1;
+  const double t2 = C_q_20 * p_ic_0 + C_q_21 * p_ic_1 + C_q_22 * p_ic_2 + p_2 - p_wv_2;
+
+  z_p(0) = L * (C_wv_00 * t0 + C_wv_01 * t1 + C_wv_02 * t2);
+  z_p(1) = L * (C_wv_10 * t0 + C_wv_11 * t1 + C_wv_12 * t2);
+  z_p(2) = L * (C_wv_20 * t0 + C_wv_21 * t1 + C_wv_22 * t2);
+}
+}  // namespace pose_measurement
+}  // namespace msf_updates
+#endif  // POSE_MEASUREMENT_KERNELS_H_
@@ -24,6 +24,7 @@
 #include <geometry_msgs/TransformStamped.h>
 #include <geometry_msgs/PoseStamped.h>
 #include <msf_updates/PoseDistorter.h>
+#include <msf_updates/pose_sensor_handler/pose_batch_measurement.h>
 
 namespace msf_pose_sensor {
 
@@ -41,6 +42,7 @@ class PoseSensorHandler : public msf_core::SensorHandler<
   ros::Subscriber subPoseWithCovarianceStamped_;
   ros::Subscriber subTransformStamped_;
   ros::Subscriber subPoseStamped_;
+  ros::Subscriber subPoseArray_;
 
   bool measurement_world_sensor_;  ///< Defines if the pose of the sensor is
                                    // measured in world coordinates (true, default)
@@ -49,19 +51,29 @@ class PoseSensorHandler : public msf_core::SensorHandler<
   bool provides_absolute_measurements_;  ///<Does this sensor measure relative or
                                          // absolute values
 
-  double pose_measurement_minimum_dt_; ///< Minimum time between two pose measurements in seconds.
-                                       // If more pose measurements are received they are dropped.
-
-  double timestamp_previous_pose_;  ///< Timestamp of previous pose message to subsample messages.
+  /// Mean of the readings dropped by the rate limiter, position followed by
+  /// the quaternion coefficients x y z w.
+  msf_core::ReadingAverager<7> pose_averager_;
+  /// Limits the transform input (e.g. Vicon) to 20 Hz unless pose_max_rate is
+  /// set. The other inputs use rate_limiter_.
+  msf_core::MeasurementRateLimiter rate_limiter_transform_;
 
   msf_updates::PoseDistorter::Ptr distorter_;
 
+  typedef msf_updates::pose_measurement::PoseBatchMeasurement<MEASUREMENT_TYPE>
+      batch_measurement_t;
+
+  /// Bit mask of the states which are fixed by dynamic reconfigure.
+  int GetFixedStates();
   void ProcessPoseMeasurement(
-      const geometry_msgs::PoseWithCovarianceStampedConstPtr & msg);
+      const geometry_msgs::PoseWithCovarianceStamped& msg,
+      msf_core::MeasurementRateLimiter& rate_limiter);
   void MeasurementCallback(
       const geometry_msgs::PoseWithCovarianceStampedConstPtr & msg);
   void MeasurementCallback(const geometry_msgs::PoseStampedConstPtr & msg);
   void MeasurementCallback(const geometry_msgs::TransformStampedConstPtr & msg);
+  void MeasurementCallback(
+      const sensor_fusion_comm::PoseWithCovarianceArrayStampedConstPtr & msg);
 
  public:
   typedef MEASUREMENT_TYPE measurement_t;
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <slynen at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef POSE_STATES_H_
+#define POSE_STATES_H_
+
+#include <Eigen/Dense>
+#include <boost/mpl/vector.hpp>
+#include <msf_core/msf_fwds.h>
+
+namespace msf_updates {
+namespace pose_measurement {
+/**
+ * \brief The calibration states of a pose sensor, see msf_core::ComposeStates.
+ */
+template<int FirstName>
+struct PoseSensorStatePack {
+  enum {
+    L = FirstName,
+    q_wv,
+    p_wv,
+    q_ic,
+    p_ic,
+    nextName
+  };
+  typedef boost::mpl::vector<
+      /// Visual scale.
+      msf_core::StateVar_T<Eigen::Matrix<double, 1, 1>, L, msf_core::Auxiliary>,
+      /// Rotation from the world frame to the frame in which the pose is
+      /// measured expressed in the world frame.
+      msf_core::StateVar_T<Eigen::Quaternion<double>, q_wv,
+          msf_core::AuxiliaryNonTemporalDrifting>,
+      /// Translation from the world frame to the frame in which the pose is
+      /// measured expressed in the world frame.
+      msf_core::StateVar_T<Eigen::Matrix<double, 3, 1>, p_wv>,
+      /// Rotation from the IMU frame to the camera frame expressed in the IMU
+      /// frame.
+      msf_core::StateVar_T<Eigen::Quaternion<double>, q_ic>,
+      /// Translation from the IMU frame to the camera frame expressed in the
+      /// IMU frame.
+      msf_core::StateVar_T<Eigen::Matrix<double, 3, 1>, p_ic>
+  > StateVars_T;
+};
+}  // namespace pose_measurement
+}  // namespace msf_updates
+#endif  // POSE_STATES_H_
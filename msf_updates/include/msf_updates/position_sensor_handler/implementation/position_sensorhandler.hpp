@@ -35,6 +35,34 @@ PositionSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::PositionSensorHandler(
   pnh.param("position_use_fixed_covariance", use_fixed_covariance_, false);
   pnh.param("position_absolute_measurements", provides_absolute_measurements_,
             false);
+  pnh.param("position_gps_local_approximation_radius",
+            gps_local_approximation_radius_, 0.0);
+  if (gps_local_approximation_radius_ > 0) {
+    gpsConversion_.SetLocalApproximationRadius(gps_local_approximation_radius_);
+  }
+
+  // Maximum rate of position updates [Hz], zero processes every reading. The
+  // transform input (e.g. Vicon) is limited to 20 Hz unless it is set.
+  double max_rate = 0;
+  double max_rate_transform = 20;
+  if (pnh.getParam("position_max_rate", max_rate))
+    max_rate_transform = max_rate;
+  bool average_throttled;
+  pnh.param("position_average_throttled", average_throttled, false);
+  rate_limiter_.SetMaxRate(max_rate);
+  rate_limiter_.SetAverageDropped(average_throttled);
+  rate_limiter_transform_.SetMaxRate(max_rate_transform);
+  rate_limiter_transform_.SetAverageDropped(average_throttled);
+  // Low priority sensors are decimated first if the core can not keep up.
+  pnh.param("position_low_priority", low_priority_, false);
+  MSF_INFO_STREAM_COND(max_rate > 0, "Position sensor is limited to "
+                       << max_rate << " Hz"
+                       << (average_throttled ? ", averaging the dropped "
+                           "readings" : ""));
+  MSF_INFO_STREAM_COND(max_rate_transform != max_rate
+                       && max_rate_transform > 0,
+                       "Position sensor transform input is limited to "
+                       << max_rate_transform << " Hz");
 
   MSF_INFO_STREAM_COND(use_fixed_covariance_, "Position sensor is using fixed "
                        "covariance");
@@ -57,6 +85,7 @@ PositionSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::PositionSensorHandler(
   subNavSatFix_ =
       nh.subscribe<sensor_msgs::NavSatFix>
   ("navsatfix_input", 20, &PositionSensorHandler::MeasurementCallback, this);
+  this->SetIngestionQueueSize(20);
 
   z_p_.setZero();
 
@@ -82,7 +111,8 @@ void PositionSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::AdjustGPSZReference(
 
 template<typename MEASUREMENT_TYPE, typename MANAGER_TYPE>
 void PositionSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::ProcessPositionMeasurement(
-    const sensor_fusion_comm::PointWithCovarianceStampedConstPtr& msg) {
+    const sensor_fusion_comm::PointWithCovarianceStamped& msg,
+    msf_core::MeasurementRateLimiter& rate_limiter) {
   received_first_measurement_ = true;
 
   // Get the fixed states.
@@ -92,7 +122,7 @@ void PositionSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::ProcessPositionMeasu
       "larger variable to mark the fixed_states");
   // Do not exceed the 32 bits of int.
 
-  if (!use_fixed_covariance_ && msg->covariance[0] == 0)  // Take covariance from sensor.
+  if (!use_fixed_covariance_ && msg.covariance[0] == 0)  // Take covariance from sensor.
       {
     MSF_WARN_STREAM_THROTTLE(
         2, "Provided message type without covariance but set "
@@ -100,6 +130,31 @@ void PositionSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::ProcessPositionMeasu
     return;
   }
 
+  const double timestamp = msg.header.stamp.toSec();
+  if (rate_limiter.AverageDropped()) {
+    position_averager_.Add(
+        timestamp,
+        msf_core::Vector3(msg.point.x, msg.point.y, msg.point.z));
+  }
+  if (!this->RateLimit(rate_limiter, timestamp)) {
+    return;
+  }
+
+  // Replace the reading by the mean of the readings dropped since the last
+  // update. The covariance is kept, which is conservative.
+  const sensor_fusion_comm::PointWithCovarianceStamped* reading = &msg;
+  sensor_fusion_comm::PointWithCovarianceStamped averaged;
+  if (position_averager_.Count() > 1) {
+    averaged = msg;
+    const msf_core::Vector3 mean = position_averager_.Mean();
+    averaged.header.stamp = ros::Time(position_averager_.MeanTimestamp());
+    averaged.point.x = mean.x();
+    averaged.point.y = mean.y();
+    averaged.point.z = mean.z();
+    reading = &averaged;
+  }
+  position_averager_.Reset();
+
   // Get all the fixed states and set flag bits.
   MANAGER_TYPE* mngr = dynamic_cast<MANAGER_TYPE*>(&manager_);
 
@@ -115,7 +170,8 @@ void PositionSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::ProcessPositionMeasu
                                provides_absolute_measurements_, this->sensorID,
                                fixedstates));
 
-  meas->MakeFromSensorReading(msg, msg->header.stamp.toSec() - delay_);
+  meas->MakeFromSensorReading(*reading,
+                              reading->header.stamp.toSec() - delay_);
 
   z_p_ = meas->z_p_;  // Store this for the init procedure.
 
@@ -125,53 +181,55 @@ void PositionSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::ProcessPositionMeasu
 template<typename MEASUREMENT_TYPE, typename MANAGER_TYPE>
 void PositionSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::MeasurementCallback(
     const geometry_msgs::PointStampedConstPtr & msg) {
-  this->SequenceWatchDog(msg->header.seq, subPointStamped_.getTopic());
+  this->SequenceWatchDog(msg->header.seq, subPointStamped_.getTopic(),
+                         msg->header.stamp.toSec(),
+                         ros::Time::now().toSec());
 
   MSF_INFO_STREAM_ONCE(
       "*** position sensor got first measurement from topic "
           << this->topic_namespace_ << "/" << subPointStamped_.getTopic()
           << " ***");
 
-  sensor_fusion_comm::PointWithCovarianceStampedPtr pointwCov(
-      new sensor_fusion_comm::PointWithCovarianceStamped);
-  pointwCov->header = msg->header;
-  pointwCov->point = msg->point;
+  // The reading is only borrowed by the measurement, so it can live on the
+  // stack. The frame id is not used and not copied.
+  sensor_fusion_comm::PointWithCovarianceStamped pointwCov;
+  pointwCov.header.seq = msg->header.seq;
+  pointwCov.header.stamp = msg->header.stamp;
+  pointwCov.point = msg->point;
 
-  ProcessPositionMeasurement(pointwCov);
+  ProcessPositionMeasurement(pointwCov, rate_limiter_);
 }
 
 template<typename MEASUREMENT_TYPE, typename MANAGER_TYPE>
 void PositionSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::MeasurementCallback(
     const geometry_msgs::TransformStampedConstPtr & msg) {
-  this->SequenceWatchDog(msg->header.seq, subTransformStamped_.getTopic());
+  this->SequenceWatchDog(msg->header.seq, subTransformStamped_.getTopic(),
+                         msg->header.stamp.toSec(),
+                         ros::Time::now().toSec());
 
   MSF_INFO_STREAM_ONCE(
       "*** position sensor got first measurement from topic "
           << this->topic_namespace_ << "/" << subTransformStamped_.getTopic()
           << " ***");
 
-  if (msg->header.seq % 5 != 0) {  //slow down vicon
-    MSF_WARN_STREAM_ONCE("Measurement throttling is on, dropping every but the "
-                         "5th message");
-    return;
-  }
-
-  sensor_fusion_comm::PointWithCovarianceStampedPtr pointwCov(
-      new sensor_fusion_comm::PointWithCovarianceStamped);
-  pointwCov->header = msg->header;
+  sensor_fusion_comm::PointWithCovarianceStamped pointwCov;
+  pointwCov.header.seq = msg->header.seq;
+  pointwCov.header.stamp = msg->header.stamp;
 
   // Fixed covariance will be set in measurement class -> MakeFromSensorReadingImpl.
-  pointwCov->point.x = msg->transform.translation.x;
-  pointwCov->point.y = msg->transform.translation.y;
-  pointwCov->point.z = msg->transform.translation.z;
+  pointwCov.point.x = msg->transform.translation.x;
+  pointwCov.point.y = msg->transform.translation.y;
+  pointwCov.point.z = msg->transform.translation.z;
 
-  ProcessPositionMeasurement(pointwCov);
+  ProcessPositionMeasurement(pointwCov, rate_limiter_transform_);
 }
 
 template<typename MEASUREMENT_TYPE, typename MANAGER_TYPE>
 void PositionSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::MeasurementCallback(
     const sensor_msgs::NavSatFixConstPtr& msg) {
-  this->SequenceWatchDog(msg->header.seq, subNavSatFix_.getTopic());
+  this->SequenceWatchDog(msg->header.seq, subNavSatFix_.getTopic(),
+                         msg->header.stamp.toSec(),
+                         ros::Time::now().toSec());
 
   MSF_INFO_STREAM_ONCE(
       "*** position sensor got first measurement from topic "
@@ -189,33 +247,42 @@ void PositionSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::MeasurementCallback(
     referenceinit = true;
   }
 
-  msf_core::Vector3 ecef = gpsConversion_.WGS84ToECEF(msg->latitude,
-                                                      msg->longitude,
-                                                      msg->altitude);
-  msf_core::Vector3 enu = gpsConversion_.ECEFToENU(ecef);
+  msf_core::Vector3 enu;
+  if (gps_local_approximation_radius_ > 0) {
+    enu = gpsConversion_.WGS84ToENULocal(msg->latitude, msg->longitude,
+                                         msg->altitude);
+    // Outside the operating area the approximation error is not bounded.
+    if (enu.head<2>().norm() > gps_local_approximation_radius_) {
+      enu = gpsConversion_.WGS84ToENU(msg->latitude, msg->longitude,
+                                      msg->altitude);
+    }
+  } else {
+    enu = gpsConversion_.WGS84ToENU(msg->latitude, msg->longitude,
+                                    msg->altitude);
+  }
 
-  sensor_fusion_comm::PointWithCovarianceStampedPtr pointwCov(
-      new sensor_fusion_comm::PointWithCovarianceStamped);
-  pointwCov->header = msg->header;
+  sensor_fusion_comm::PointWithCovarianceStamped pointwCov;
+  pointwCov.header.seq = msg->header.seq;
+  pointwCov.header.stamp = msg->header.stamp;
 
   // Store the ENU data in the position fields.
-  pointwCov->point.x = enu[0];
-  pointwCov->point.y = enu[1];
-  pointwCov->point.z = enu[2];
+  pointwCov.point.x = enu[0];
+  pointwCov.point.y = enu[1];
+  pointwCov.point.z = enu[2];
 
   // Get the covariance TODO (slynen): handle the cases differently!
   if (msg->position_covariance_type
       == sensor_msgs::NavSatFix::COVARIANCE_TYPE_KNOWN) {
-    pointwCov->covariance = msg->position_covariance;
+    pointwCov.covariance = msg->position_covariance;
   } else if (msg->position_covariance_type
       == sensor_msgs::NavSatFix::COVARIANCE_TYPE_DIAGONAL_KNOWN) {
-    pointwCov->covariance = msg->position_covariance;
+    pointwCov.covariance = msg->position_covariance;
   } else if (msg->position_covariance_type
       == sensor_msgs::NavSatFix::COVARIANCE_TYPE_APPROXIMATED) {  // From DOP.
-    pointwCov->covariance = msg->position_covariance;
+    pointwCov.covariance = msg->position_covariance;
   }
 
-  ProcessPositionMeasurement(pointwCov);
+  ProcessPositionMeasurement(pointwCov, rate_limiter_);
 }
 }  // namespace msf_position_sensor
 #endif  // POSITION_SENSORHANDLER_HPP_
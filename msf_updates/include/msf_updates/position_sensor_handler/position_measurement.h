@@ -22,6 +22,7 @@
 #include <msf_core/msf_measurement.h>
 #include <msf_core/msf_core.h>
 #include <msf_core/eigen_utils.h>
+#include <msf_updates/position_sensor_handler/position_measurement_kernels.h>
 #include <sensor_fusion_comm/PointWithCovarianceStamped.h>
 
 namespace msf_updates {
@@ -39,9 +40,9 @@ typedef msf_core::MSF_Measurement<
 struct PositionMeasurement : public PositionMeasurementBase {
  private:
   typedef PositionMeasurementBase Measurement_t;
-  typedef Measurement_t::Measurement_ptr measptr_t;
+  typedef Measurement_t::Measurement_type measurement_t;
 
-  virtual void MakeFromSensorReadingImpl(measptr_t msg) {
+  virtual void MakeFromSensorReadingImpl(const measurement_t& msg) {
 
     Eigen::Matrix<double, nMeasurements,
         msf_core::MSF_Core<msf_updates::EKFState>::nErrorStatesAtCompileTime> H_old;
@@ -50,8 +51,8 @@ struct PositionMeasurement : public PositionMeasurementBase {
     H_old.setZero();
 
     // Get measurement.
-    z_p_ = Eigen::Matrix<double, 3, 1>(msg->point.x, msg->point.y,
-                                       msg->point.z);
+    z_p_ = Eigen::Matrix<double, 3, 1>(msg.point.x, msg.point.y,
+                                       msg.point.z);
 
     if (fixed_covariance_)  //  take fix covariance from reconfigure GUI
     {
@@ -62,9 +63,9 @@ struct PositionMeasurement : public PositionMeasurementBase {
 
     } else {  // Tke covariance from sensor.
 
-      R_.block<3, 3>(0, 0) = msf_core::Matrix3(&msg->covariance[0]);
+      R_.block<3, 3>(0, 0) = msf_core::Matrix3(&msg.covariance[0]);
 
-      if (msg->header.seq % 100 == 0) {  // Only do this check from time to time.
+      if (msg.header.seq % 100 == 0) {  // Only do this check from time to time.
         if (R_.block<3, 3>(0, 0).determinant() < -0.01)
           MSF_WARN_STREAM_THROTTLE(
               60, "The covariance matrix you provided for "
@@ -104,14 +105,6 @@ struct PositionMeasurement : public PositionMeasurementBase {
 
     H.setZero();
 
-    // Get rotation matrices.
-    Eigen::Matrix<double, 3, 3> C_q = state.Get<StateDefinition_T::q>()
-        .conjugate().toRotationMatrix();
-
-    // Preprocess for elements in H matrix.
-    Eigen::Matrix<double, 3, 3> p_prism_imu_sk = Skew(
-        state.Get<StateDefinition_T::p_ip>());
-
     // Get indices of states in error vector.
     enum {
       idxstartcorr_p_ = msf_tmp::GetStartIndexInCorrection<StateSequence_T,
@@ -131,15 +124,13 @@ struct PositionMeasurement : public PositionMeasurementBase {
       state_in->ClearCrossCov<StateDefinition_T::p_ip>();
 
     // Construct H matrix:
-    // Position:
-    H.block<3, 3>(0, idxstartcorr_p_) = Eigen::Matrix<double, 3, 3>::Identity();  // p
-
-    H.block<3, 3>(0, idxstartcorr_q_) = -C_q.transpose() * p_prism_imu_sk;  // q
-
-    H.block<3, 3>(0, idxstartcorr_p_pi_) =
-        fixed_p_pos_imu ?
-            Eigen::Matrix<double, 3, 3>::Zero() : (C_q.transpose()).eval();  //p_pos_imu_
+    PositionJacobian(state.GetRotationMatrix<StateDefinition_T::q>(),
+                     state.Get<StateDefinition_T::p>(),
+                     state.Get<StateDefinition_T::p_ip>(), idxstartcorr_p_,
+                     idxstartcorr_q_, idxstartcorr_p_pi_, H);
 
+    if (fixed_p_pos_imu)
+      H.block<3, 3>(0, idxstartcorr_p_pi_).setZero();
   }
 
   /**
@@ -159,15 +150,13 @@ struct PositionMeasurement : public PositionMeasurementBase {
 
       CalculateH(state_nonconst_new, H_new);
 
-      // Get rotation matrices.
-      Eigen::Matrix<double, 3, 3> C_q = state.Get<StateDefinition_T::q>()
-          .conjugate().toRotationMatrix();
-
       // Construct residuals:
       // Position
-      r_old.block<3, 1>(0, 0) = z_p_
-          - (state.Get<StateDefinition_T::p>()
-              + C_q.transpose() * state.Get<StateDefinition_T::p_ip>());
+      Eigen::Matrix<double, 3, 1> z_p;
+      PositionPrediction(state.GetRotationMatrix<StateDefinition_T::q>(),
+                         state.Get<StateDefinition_T::p>(),
+                         state.Get<StateDefinition_T::p_ip>(), z_p);
+      r_old.block<3, 1>(0, 0) = z_p_ - z_p;
 
       if (!CheckForNumeric(r_old, "r_old")) {
         MSF_ERROR_STREAM("r_old: "<<r_old);
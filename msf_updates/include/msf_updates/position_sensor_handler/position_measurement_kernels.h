@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <slynen at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Generated by msf_updates/scripts/generate_measurement_kernels.py.
+// Do not edit, change the script and run it again.
+#ifndef POSITION_MEASUREMENT_KERNELS_H_
+#define POSITION_MEASUREMENT_KERNELS_H_
+
+#include <cmath>
+
+#include <Eigen/Dense>
+
+namespace msf_updates {
+namespace position_measurement {
+/*
+ * Measurement Jacobian and prediction of the position sensor.
+ */
+
+/**
+ * \brief H of the position measurement. C_q is the rotation matrix of q.
+ */
+template<typename Derived>
+inline void PositionJacobian(const Eigen::Matrix<double, 3, 3>& C_q,
+                             const Eigen::Matrix<double, 3, 1>& p,
+                             const Eigen::Matrix<double, 3, 1>& p_ip,
+                             int idxstartcorr_p,
+                             int idxstartcorr_q,
+                             int idxstartcorr_p_ip,
+                             Eigen::MatrixBase<Derived>& H) {
+  const double C_q_00 = C_q(0, 0);
+  const double C_q_01 = C_q(0, 1);
+  const double C_q_02 = C_q(0, 2);
+  const double C_q_10 = C_q(1, 0);
+  const double C_q_11 = C_q(1, 1);
+  const double C_q_12 = C_q(1, 2);
+  const double C_q_20 = C_q(2, 0);
+  const double C_q_21 = C_q(2, 1);
+  const double C_q_22 = C_q(2, 2);
+  const double p_ip_0 = p_ip(0);
+  const double p_ip_1 = p_ip(1);
+  const double p_ip_2 = p_ip(2);
+
+  H(0, idxstartcorr_p + 0) = 1.0;
+  H(0, idxstartcorr_p + 1) = 0.0;
+  H(0, idxstartcorr_p + 2) = 0.0;
+  H(1, idxstartcorr_p + 0) = 0.0;
+  H(1, idxstartcorr_p + 1) = 1.0;
+  H(1, idxstartcorr_p + 2) = 0.0;
+  H(2, idxstartcorr_p + 0) = 0.0;
+  H(2, idxstartcorr_p + 1) = 0.0;
+  H(2, idxstartcorr_p + 2) = 1.0;
+  H(0, idxstartcorr_q + 0) = -C_q_01 * p_ip_2 + C_q_02 * p_ip_1;
+  H(0, idxstartcorr_q + 1) = C_q_00 * p_ip_2 - C_q_02 * p_ip_0;
+  H(0, idxstartcorr_q + 2) = -C_q_00 * p_ip_1 + C_q_01 * p_ip_0;
+  H(1, idxstartcorr_q + 0) = -C_q_11 * p_ip_2 + C_q_12 * p_ip_1;
+  H(1, idxstartcorr_q + 1) = C_q_10 * p_ip_2 - C_q_12 * p_ip_0;
+  H(1, idxstartcorr_q + 2) = -C_q_10 * p_ip_1 + C_q_11 * p_ip_0;
+  H(2, idxstartcorr_q + 0) = -C_q_21 * p_ip_2 + C_q_22 * p_ip_1;
+  H(2, idxstartcorr_q + 1) = C_q_20 * p_ip_2 - C_q_22 * p_ip_0;
+  H(2, idxstartcorr_q + 2) = -C_q_20 * p_ip_1 + C_q_21 * p_ip_0;
+  H(0, idxstartcorr_p_ip + 0) = C_q_00;
+  H(0, idxstartcorr_p_ip + 1) = C_q_01;
+  H(0, idxstartcorr_p_ip + 2) = C_q_02;
+  H(1, idxstartcorr_p_ip + 0) = C_q_10;
+  H(1, idxstartcorr_p_ip + 1) = C_q_11;
+  H(1, idxstartcorr_p_ip + 2) = C_q_12;
+  H(2, idxstartcorr_p_ip + 0) = C_q_20;
+  H(2, idxstartcorr_p_ip + 1) = C_q_21;
+  H(2, idxstartcorr_p_ip + 2) = C_q_22;
+}
+
+/**
+ * \brief Position the position measurement expects: p + C_q * p_ip.
+ */
+inline void PositionPrediction(const Eigen::Matrix<double, 3, 3>& C_q,
+                               const Eigen::Matrix<double, 3, 1>& p,
+                               const Eigen::Matrix<double, 3, 1>& p_ip,
+                               Eigen::Matrix<double, 3, 1>& z_p) {
+  const double C_q_00 = C_q(0, 0);
+  const double C_q_01 = C_q(0, 1);
+  const double C_q_02 = C_q(0, 2);
+  const double C_q_10 = C_q(1, 0);
+  const double C_q_11 = C_q(1, 1);
+  const double C_q_12 = C_q(1, 2);
+  const double C_q_20 = C_q(2, 0);
+  const double C_q_21 = C_q(2, 1);
+  const double C_q_22 = C_q(2, 2);
+  const double p_0 = p(0);
+  const double p_1 = p(1);
+  const double p_2 = p(2);
+  const double p_ip_0 = p_ip(0);
+  const double p_ip_1 = p_ip(1);
+  const double p_ip_2 = p_ip(2);
+
+  z_p(0) = C_q_00 * p_ip_0 + C_q_01 * p_ip_1 + C_q_02 * p_ip_2 + p_0;
+  z_p(1) = C_q_10 * p_ip_0 + C_q_11 * p_ip_1 + C_q_12 * p_ip_2 + p_1;
+  z_p(2) = C_q_20 * p_ip_0 + C_q_21 * p_ip_1 + C_q_22 * p_ip_2 + p_2;
+}
+}  // namespace position_measurement
+}  // namespace msf_updates
+#endif  // POSITION_MEASUREMENT_KERNELS_H_
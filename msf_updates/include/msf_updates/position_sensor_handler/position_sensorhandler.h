@@ -42,12 +42,21 @@ class PositionSensorHandler : public msf_core::SensorHandler<
   ros::Subscriber subTransformStamped_;
   ros::Subscriber subNavSatFix_;
   msf_core::GPSConversion gpsConversion_;
+  /// Radius around the GPS reference in which the local tangent plane
+  /// approximation is used, zero to always use the exact conversion.
+  double gps_local_approximation_radius_;
+  /// Mean of the readings dropped by the rate limiter.
+  msf_core::ReadingAverager<3> position_averager_;
+  /// Limits the transform input (e.g. Vicon) to 20 Hz unless
+  /// position_max_rate is set. The other inputs use rate_limiter_.
+  msf_core::MeasurementRateLimiter rate_limiter_transform_;
 
   bool use_fixed_covariance_;  ///< Use fixed covariance set by dynamic reconfigure.
   bool provides_absolute_measurements_;  ///< Does this sensor measure relative or absolute values.
 
   void ProcessPositionMeasurement(
-      const sensor_fusion_comm::PointWithCovarianceStampedConstPtr& msg);
+      const sensor_fusion_comm::PointWithCovarianceStamped& msg,
+      msf_core::MeasurementRateLimiter& rate_limiter);
   void MeasurementCallback(const geometry_msgs::PointStampedConstPtr & msg);
   void MeasurementCallback(const geometry_msgs::TransformStampedConstPtr & msg);
   void MeasurementCallback(const sensor_msgs::NavSatFixConstPtr& msg);
@@ -32,9 +32,22 @@ PressureSensorHandler::PressureSensorHandler(
   subPressure_ =
       nh.subscribe<geometry_msgs::PointStamped>
       ("pressure_height", 20, &PressureSensorHandler::MeasurementCallback, this);
+  this->SetIngestionQueueSize(20);
 
-  memset(heightbuff, 0, sizeof(double) * heightbuffsize);
-
+  // Maximum rate of pressure updates [Hz], zero processes every reading. The
+  // default keeps every 10th reading of the autopilot at its usual 100 Hz.
+  double max_rate;
+  pnh.param("pressure_max_rate", max_rate, 10.0);
+  bool average_throttled;
+  pnh.param("pressure_average_throttled", average_throttled, false);
+  rate_limiter_.SetMaxRate(max_rate);
+  rate_limiter_.SetAverageDropped(average_throttled);
+  // Low priority sensors are decimated first if the core can not keep up.
+  pnh.param("pressure_low_priority", low_priority_, false);
+  MSF_INFO_STREAM_COND(max_rate > 0, "Pressure sensor is limited to "
+                       << max_rate << " Hz"
+                       << (average_throttled ? ", averaging the dropped "
+                           "readings" : ""));
 }
 
 void PressureSensorHandler::SetNoises(double n_zp) {
@@ -46,31 +59,45 @@ void PressureSensorHandler::MeasurementCallback(
 
   received_first_measurement_ = true;
 
-  this->SequenceWatchDog(msg->header.seq, subPressure_.getTopic());
+  this->SequenceWatchDog(msg->header.seq, subPressure_.getTopic(),
+                         msg->header.stamp.toSec(),
+                         ros::Time::now().toSec());
   MSF_INFO_STREAM_ONCE(
       "*** pressure sensor got first measurement from topic "
           << this->topic_namespace_ << "/" << subPressure_.getTopic()
           << " ***");
 
-  bool throttle = true;
-  if (throttle && msg->header.seq % 10 != 0) {
+  const double timestamp = msg->header.stamp.toSec();
+  if (rate_limiter_.AverageDropped()) {
+    pressure_averager_.Add(timestamp,
+                           Eigen::Matrix<double, 1, 1>::Constant(msg->point.z));
+  }
+  if (!this->RateLimit(timestamp)) {
     return;
   }
 
+  // Replace the reading by the mean of the readings dropped since the last
+  // update.
+  const geometry_msgs::PointStamped* reading = msg.get();
+  geometry_msgs::PointStamped averaged;
+  if (pressure_averager_.Count() > 1) {
+    averaged = *msg;
+    averaged.header.stamp = ros::Time(pressure_averager_.MeanTimestamp());
+    averaged.point.z = pressure_averager_.Mean()(0);
+    reading = &averaged;
+  }
+  pressure_averager_.Reset();
+
   shared_ptr<pressure_measurement::PressureMeasurement> meas(
       new pressure_measurement::PressureMeasurement(n_zp_, true,
                                                     this->sensorID));
-  meas->MakeFromSensorReading(msg, msg->header.stamp.toSec());
+  meas->MakeFromSensorReading(*reading, reading->header.stamp.toSec());
 
   z_p_ = meas->z_p_;  // Store this for the init procedure.
 
   // Make averaged measurement.
-  memcpy(heightbuff, heightbuff + 1, sizeof(double) * (heightbuffsize - 1));
-  heightbuff[heightbuffsize - 1] = meas->z_p_(0);
-  double sum = 0;
-  for (int k = 0; k < heightbuffsize; ++k)
-    sum += heightbuff[k];
-  z_average_p(0) = sum / heightbuffsize;
+  height_average_.Add(meas->z_p_(0));
+  z_average_p(0) = height_average_.Mean();
 
   this->manager_.msf_core_->AddMeasurement(meas);
 }
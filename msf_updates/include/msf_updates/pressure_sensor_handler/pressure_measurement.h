@@ -29,22 +29,16 @@ enum {
 /**
  * \brief A measurement as provided by a pressure sensor.
  */
-typedef msf_core::MSF_Measurement<geometry_msgs::PointStamped,
-    Eigen::Matrix<double, nMeasurements, nMeasurements>, msf_updates::EKFState> PressureMeasurementBase;
+typedef msf_core::MSF_ScalarMeasurement<geometry_msgs::PointStamped,
+    msf_updates::EKFState, 2> PressureMeasurementBase;
 struct PressureMeasurement : public PressureMeasurementBase {
  private:
   typedef PressureMeasurementBase Measurement_t;
-  typedef Measurement_t::Measurement_ptr measptr_t;
-
-  virtual void MakeFromSensorReadingImpl(measptr_t msg) {
-    Eigen::Matrix<double, nMeasurements,
-        msf_core::MSF_Core<msf_updates::EKFState>::nErrorStatesAtCompileTime> H_old;
-    Eigen::Matrix<double, nMeasurements, 1> r_old;
-
-    H_old.setZero();
+  typedef Measurement_t::Measurement_type measurement_t;
 
+  virtual void MakeFromSensorReadingImpl(const measurement_t& msg) {
     // Get measurements.
-    z_p_ = Eigen::Matrix<double, 1, 1>::Constant(msg->point.z);
+    z_p_ = Eigen::Matrix<double, 1, 1>::Constant(msg.point.z);
 
     const double s_zp = n_zp_ * n_zp_;
     R_ = (Eigen::Matrix<double, nMeasurements, 1>() << s_zp).finished()
@@ -66,24 +60,11 @@ struct PressureMeasurement : public PressureMeasurementBase {
     return "pressure";
   }
   /**
-   * The method called by the msf_core to apply the measurement represented by
-   * this object.
+   * The method called by the msf_core to get the residual and the non-zero
+   * entries of H for the scalar update.
    */
-  virtual void Apply(shared_ptr<EKFState_T> non_const_state,
-                     msf_core::MSF_Core<EKFState_T>& core) {
-    // Init variables.
-    Eigen::Matrix<double, nMeasurements,
-        msf_core::MSF_Core<EKFState_T>::nErrorStatesAtCompileTime> H_old;
-    Eigen::Matrix<double, nMeasurements, 1> r_old;
-
-    H_old.setZero();
-
-    if (non_const_state->time == msf_core::constants::INVALID_TIME) {
-      MSF_WARN_STREAM(
-          "Apply pressure update was called with an invalid state.");
-      return;  // Early abort.
-    }
-
+  virtual void CalculateScalarH(shared_ptr<EKFState_T> non_const_state,
+                                SparseH_T& H, double& residual) {
     const EKFState_T& state = *non_const_state;
 
     enum {
@@ -100,17 +81,14 @@ struct PressureMeasurement : public PressureMeasurementBase {
 
     // Construct H matrix.
     // Position:
-    H_old.block<1, 1>(0, idx_p + 2)(0) = 1;  // p_z
+    H.Add(idx_p + 2, 1);  // p_z
     // Pressure bias.
-    H_old.block<1, 1>(0, idx_b_p)(0) = -1;  //p_b
+    H.Add(idx_b_p, -1);  //p_b
 
     // Construct residuals.
     // Height.
-    r_old.block<1, 1>(0, 0) = (z_p_ + state.Get<StateDefinition_T::b_p>())
-        - state.Get<StateDefinition_T::p>().block<1, 1>(2, 0);
-
-    // Call update step in base class.
-    this->CalculateAndApplyCorrection(non_const_state, core, H_old, r_old, R_);
+    residual = z_p_(0) + state.Get<StateDefinition_T::b_p>()(0)
+        - state.Get<StateDefinition_T::p>()(2);
   }
 };
 }  // namespace pressure_measurement
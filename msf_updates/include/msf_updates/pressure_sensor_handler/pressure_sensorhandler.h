@@ -21,6 +21,7 @@
 
 #include <geometry_msgs/PointStamped.h>
 #include <msf_core/msf_sensormanagerROS.h>
+#include <msf_core/msf_tools.h>
 
 #include <msf_updates/pressure_sensor_handler/pressure_measurement.h>
 
@@ -34,7 +35,9 @@ class PressureSensorHandler : public msf_core::SensorHandler<
   Eigen::Matrix<double, 1, 1> z_p_;  ///< Pressure measurement.
   double n_zp_;  ///< Pressure measurement noise.
   Eigen::Matrix<double, 1, 1> z_average_p;  ///<Averaged pressure measurement.
-  double heightbuff[heightbuffsize];
+  msf_core::MovingAverage<heightbuffsize> height_average_;
+  /// Mean of the readings dropped by the rate limiter.
+  msf_core::ReadingAverager<1> pressure_averager_;
   ros::Subscriber subPressure_;
   void MeasurementCallback(const geometry_msgs::PointStampedConstPtr & msg);
  public:
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <slynen at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef PRESSURE_STATES_H_
+#define PRESSURE_STATES_H_
+
+#include <Eigen/Dense>
+#include <boost/mpl/vector.hpp>
+#include <msf_core/msf_fwds.h>
+
+namespace pressure_measurement {
+/**
+ * \brief The calibration states of a pressure sensor, see
+ * msf_core::ComposeStates.
+ */
+template<int FirstName>
+struct PressureSensorStatePack {
+  enum {
+    b_p = FirstName,
+    nextName
+  };
+  typedef boost::mpl::vector<
+      /// Pressure sensor bias.
+      msf_core::StateVar_T<Eigen::Matrix<double, 1, 1>, b_p>
+  > StateVars_T;
+};
+}  // namespace pressure_measurement
+#endif  // PRESSURE_STATES_H_
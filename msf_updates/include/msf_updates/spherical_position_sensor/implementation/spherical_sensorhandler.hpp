@@ -50,6 +50,7 @@ AngleSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::AngleSensorHandler(
 
   subPointStamped_ = nh.subscribe<geometry_msgs::PointStamped>
       ("angle_input", 20, &AngleSensorHandler::MeasurementCallback, this);
+  this->SetIngestionQueueSize(20);
 
   z_a_.setZero();
 
@@ -72,7 +73,9 @@ void AngleSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::MeasurementCallback(
     const geometry_msgs::PointStampedConstPtr & msg) {
   received_first_measurement_ = true;
 
-  this->SequenceWatchDog(msg->header.seq, subPointStamped_.getTopic());
+  this->SequenceWatchDog(msg->header.seq, subPointStamped_.getTopic(),
+                         msg->header.stamp.toSec(),
+                         ros::Time::now().toSec());
 
   ROS_INFO_STREAM_ONCE(
       "*** Angle sensor got first measurement from topic "
@@ -114,7 +117,11 @@ void AngleSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::MeasurementCallback(
 
   z_a_ = meas->z_a_;  //store this for the init procedure
 
-  this->manager_.msf_core_->AddMeasurement(meas);
+  if (pairing_) {
+    pairing_->AddMeasurement(meas, msg->header.stamp.toSec());
+  } else {
+    this->manager_.msf_core_->AddMeasurement(meas);
+  }
 }
 
 // Distance sensor implementation:
@@ -145,6 +152,7 @@ DistanceSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::DistanceSensorHandler(
   subPointStamped_ =
       nh.subscribe<geometry_msgs::PointStamped>
       ("distance_input", 20, &DistanceSensorHandler::MeasurementCallback, this);
+  this->SetIngestionQueueSize(20);
 
   z_d_.setZero();
 
@@ -167,7 +175,9 @@ void DistanceSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::MeasurementCallback(
     const geometry_msgs::PointStampedConstPtr & msg) {
   received_first_measurement_ = true;
 
-  this->SequenceWatchDog(msg->header.seq, subPointStamped_.getTopic());
+  this->SequenceWatchDog(msg->header.seq, subPointStamped_.getTopic(),
+                         msg->header.stamp.toSec(),
+                         ros::Time::now().toSec());
 
   ROS_INFO_STREAM_ONCE(
       "*** Distance sensor got first measurement from topic "
@@ -206,7 +216,11 @@ void DistanceSensorHandler<MEASUREMENT_TYPE, MANAGER_TYPE>::MeasurementCallback(
 
   z_d_ = meas->z_d_;  //store this for the init procedure
 
-  this->manager_.msf_core_->AddMeasurement(meas);
+  if (pairing_) {
+    pairing_->AddMeasurement(meas, msg->header.stamp.toSec());
+  } else {
+    this->manager_.msf_core_->AddMeasurement(meas);
+  }
 }
 }  // namespace msf_spherical_position
 #endif  // SPHERICAL_SENSORHANDLER_HPP_
@@ -25,12 +25,14 @@
 #include <msf_core/msf_measurement.h>
 #include <msf_core/msf_core.h>
 #include <msf_core/eigen_utils.h>
+#include <msf_updates/spherical_position_sensor/spherical_measurement_kernels.h>
 #include <geometry_msgs/PointStamped.h>
 
 namespace msf_spherical_position {
 enum {
   N_ANGLE_MEASUREMENTS = 2,
-  N_DISTANCE_MEASUREMENTS = 1
+  N_DISTANCE_MEASUREMENTS = 1,
+  N_SPHERICAL_MEASUREMENTS = N_ANGLE_MEASUREMENTS + N_DISTANCE_MEASUREMENTS
 };
 
 /**
@@ -42,9 +44,9 @@ typedef msf_core::MSF_Measurement<geometry_msgs::PointStamped,
 struct AngleMeasurement : public AngleMeasurementBase {
  private:
   typedef AngleMeasurementBase Measurement_t;
-  typedef Measurement_t::Measurement_ptr measptr_t;
+  typedef Measurement_t::Measurement_type measurement_t;
 
-  virtual void MakeFromSensorReadingImpl(measptr_t msg) {
+  virtual void MakeFromSensorReadingImpl(const measurement_t& msg) {
 
     Eigen::Matrix<double, N_ANGLE_MEASUREMENTS,
         msf_core::MSF_Core<msf_updates::EKFState>::nErrorStatesAtCompileTime> H_old;
@@ -53,7 +55,7 @@ struct AngleMeasurement : public AngleMeasurementBase {
     H_old.setZero();
 
     // Get measurement.
-    z_a_ << msg->point.x, msg->point.y;
+    z_a_ << msg.point.x, msg.point.y;
 
     if (fixed_covariance_) {   //  Take fix covariance from reconfigure GUI.
       const double s_zp = n_za_ * n_za_;
@@ -119,129 +121,44 @@ struct AngleMeasurement : public AngleMeasurementBase {
     if (fixed_p_pos_imu)
       state_in->ClearCrossCov<StateDefinition_T::p_ip>();
 
-    Eigen::Matrix<double, 3, 3> C_q = state.Get<StateDefinition_T::q>()
-        .conjugate().toRotationMatrix();
-    Eigen::Matrix<double, 3, 1> p_ = state.Get<StateDefinition_T::p>();
-    Eigen::Matrix<double, 3, 1> p_ip = state.Get<StateDefinition_T::p_ip>();
-    Eigen::Matrix<double, 2, 3> dz_dp;
-    dz_dp(0, 0) = (p_(0, 0) * p_(2, 0) * 1.0
-        / sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0)))
-        / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0));
-    dz_dp(0, 1) = (p_(1, 0) * p_(2, 0) * 1.0
-        / sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0)))
-        / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0));
-    dz_dp(0, 2) = -sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0))
-        / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0));
-    dz_dp(1, 0) = -p_(1, 0) / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0));
-    dz_dp(1, 1) = p_(0, 0) / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0));
-    dz_dp(1, 2) = 0;
-    Eigen::Matrix<double, 2, 3> dz_dq;
-    dz_dq(0, 0) = 1.0
-        / sqrt(
-            1.0
-                / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0)
-                    + p_(2, 0) * p_(2, 0))) * 1.0
-        / sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0)) * 1.0
-        / pow(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0),
-              3.0 / 2.0)
-        * (C_q(2, 1) * p_ip(2, 0) * (p_(0, 0) * p_(0, 0))
-            - C_q(2, 2) * p_ip(1, 0) * (p_(0, 0) * p_(0, 0))
-            + C_q(2, 1) * p_ip(2, 0) * (p_(1, 0) * p_(1, 0))
-            - C_q(2, 2) * p_ip(1, 0) * (p_(1, 0) * p_(1, 0))
-            - C_q(0, 1) * p_ip(2, 0) * p_(0, 0) * p_(2, 0)
-            + C_q(0, 2) * p_ip(1, 0) * p_(0, 0) * p_(2, 0)
-            - C_q(1, 1) * p_ip(2, 0) * p_(1, 0) * p_(2, 0)
-            + C_q(1, 2) * p_ip(1, 0) * p_(1, 0) * p_(2, 0));
-    dz_dq(0, 1) = -1.0
-        / sqrt(
-            -(p_(2, 0) * p_(2, 0))
-                / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0)
-                    + p_(2, 0) * p_(2, 0)) + 1.0) * 1.0
-        / pow(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0),
-              3.0 / 2.0)
-        * (C_q(2, 0) * p_ip(2, 0) * (p_(0, 0) * p_(0, 0))
-            - C_q(2, 2) * p_ip(0, 0) * (p_(0, 0) * p_(0, 0))
-            + C_q(2, 0) * p_ip(2, 0) * (p_(1, 0) * p_(1, 0))
-            - C_q(2, 2) * p_ip(0, 0) * (p_(1, 0) * p_(1, 0))
-            - C_q(0, 0) * p_ip(2, 0) * p_(0, 0) * p_(2, 0)
-            + C_q(0, 2) * p_ip(0, 0) * p_(0, 0) * p_(2, 0)
-            - C_q(1, 0) * p_ip(2, 0) * p_(1, 0) * p_(2, 0)
-            + C_q(1, 2) * p_ip(0, 0) * p_(1, 0) * p_(2, 0));
-    dz_dq(0, 2) = 1.0
-        / sqrt(
-            1.0
-                / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0)
-                    + p_(2, 0) * p_(2, 0))) * 1.0
-        / sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0)) * 1.0
-        / pow(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0),
-              3.0 / 2.0)
-        * (C_q(2, 0) * p_ip(1, 0) * (p_(0, 0) * p_(0, 0))
-            - C_q(2, 1) * p_ip(0, 0) * (p_(0, 0) * p_(0, 0))
-            + C_q(2, 0) * p_ip(1, 0) * (p_(1, 0) * p_(1, 0))
-            - C_q(2, 1) * p_ip(0, 0) * (p_(1, 0) * p_(1, 0))
-            - C_q(0, 0) * p_ip(1, 0) * p_(0, 0) * p_(2, 0)
-            + C_q(0, 1) * p_ip(0, 0) * p_(0, 0) * p_(2, 0)
-            - C_q(1, 0) * p_ip(1, 0) * p_(1, 0) * p_(2, 0)
-            + C_q(1, 1) * p_ip(0, 0) * p_(1, 0) * p_(2, 0));
-    dz_dq(1, 0) = (p_(1, 0) * (C_q(0, 1) * p_ip(2, 0) - C_q(0, 2) * p_ip(1, 0))
-        - p_(0, 0) * (C_q(1, 1) * p_ip(2, 0) - C_q(1, 2) * p_ip(1, 0)))
-        / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0));
-    dz_dq(1, 1) = -(p_(1, 0) * (C_q(0, 0) * p_ip(2, 0) - C_q(0, 2) * p_ip(0, 0))
-        - p_(0, 0) * (C_q(1, 0) * p_ip(2, 0) - C_q(1, 2) * p_ip(0, 0)))
-        / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0));
-    dz_dq(1, 2) = (p_(1, 0) * (C_q(0, 0) * p_ip(1, 0) - C_q(0, 1) * p_ip(0, 0))
-        - p_(0, 0) * (C_q(1, 0) * p_ip(1, 0) - C_q(1, 1) * p_ip(0, 0)))
-        / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0));
-    Eigen::Matrix<double, 2, 3> dz_dp_ip;
-    dz_dp_ip(0, 0) =
-        -1.0
-            / sqrt(
-                -(p_(2, 0) * p_(2, 0))
-                    / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0)
-                        + p_(2, 0) * p_(2, 0)) + 1.0) * 1.0
-            / pow(
-                p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0),
-                3.0 / 2.0)
-            * (C_q(2, 0) * (p_(0, 0) * p_(0, 0))
-                + C_q(2, 0) * (p_(1, 0) * p_(1, 0))
-                - C_q(0, 0) * p_(0, 0) * p_(2, 0)
-                - C_q(1, 0) * p_(1, 0) * p_(2, 0));
-    dz_dp_ip(0, 1) =
-        -1.0
-            / sqrt(
-                -(p_(2, 0) * p_(2, 0))
-                    / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0)
-                        + p_(2, 0) * p_(2, 0)) + 1.0) * 1.0
-            / pow(
-                p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0),
-                3.0 / 2.0)
-            * (C_q(2, 1) * (p_(0, 0) * p_(0, 0))
-                + C_q(2, 1) * (p_(1, 0) * p_(1, 0))
-                - C_q(0, 1) * p_(0, 0) * p_(2, 0)
-                - C_q(1, 1) * p_(1, 0) * p_(2, 0));
-    dz_dp_ip(0, 2) =
-        -1.0
-            / sqrt(
-                -(p_(2, 0) * p_(2, 0))
-                    / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0)
-                        + p_(2, 0) * p_(2, 0)) + 1.0) * 1.0
-            / pow(
-                p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0),
-                3.0 / 2.0)
-            * (C_q(2, 2) * (p_(0, 0) * p_(0, 0))
-                + C_q(2, 2) * (p_(1, 0) * p_(1, 0))
-                - C_q(0, 2) * p_(0, 0) * p_(2, 0)
-                - C_q(1, 2) * p_(1, 0) * p_(2, 0));
-    dz_dp_ip(1, 0) = -(C_q(0, 0) * p_(1, 0) - C_q(1, 0) * p_(0, 0))
-        / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0));
-    dz_dp_ip(1, 1) = -(C_q(0, 1) * p_(1, 0) - C_q(1, 1) * p_(0, 0))
-        / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0));
-    dz_dp_ip(1, 2) = -(C_q(0, 2) * p_(1, 0) - C_q(1, 2) * p_(0, 0))
-        / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0));
-    H.block<2, 3>(0, idxstartcorr_p_) = dz_dp;
-    H.block<2, 3>(0, idxstartcorr_q_) = dz_dq;
-    H.block<2, 3>(0, idxstartcorr_p_pi_) = dz_dp_ip;
+    AngleJacobian(state.GetRotationMatrix<StateDefinition_T::q>(),
+                  state.Get<StateDefinition_T::p>(),
+                  state.Get<StateDefinition_T::p_ip>(), idxstartcorr_p_,
+                  idxstartcorr_q_, idxstartcorr_p_pi_, H);
+  }
+
+  /**
+   * \brief Residual of the absolute measurement against the given state.
+   */
+  void CalculateResidual(const EKFState_T& state,
+                         Eigen::Matrix<double, N_ANGLE_MEASUREMENTS, 1>& r) const {
+    // Construct residuals.
+    Eigen::Matrix<double, 3, 1> z_carth;
+    SensorPosition(state.GetRotationMatrix<StateDefinition_T::q>(),
+                   state.Get<StateDefinition_T::p>(),
+                   state.Get<StateDefinition_T::p_ip>(), z_carth);
+    double radius_old = sqrt(
+        z_carth(0, 0) * z_carth(0, 0) + z_carth(1, 0) * z_carth(1, 0)
+            + z_carth(2, 0) * z_carth(2, 0));
+    double theta_old = acos(z_carth(2, 0) / radius_old);
+    double phi_old = atan(z_carth(1, 0) / z_carth(0, 0));
+    // Handle all exeptions that occur when transforming in spherical coordinates.
+    if (z_carth(0, 0) < 0 && z_carth(1, 0) < 0) {
+      phi_old -= M_PI;
+    }
+    if (z_carth(0, 0) < 0 && z_carth(1, 0) > 0) {
+      phi_old += M_PI;
+    }
 
+    msf_core::Vector2 z_spherical;
+    z_spherical << theta_old, phi_old;
+    r = z_a_ - z_spherical;
+    if (r(1, 0) < -M_PI) {
+      r(1, 0) += 2 * M_PI;
+    }
+    if (r(1, 0) > M_PI) {
+      r(1, 0) -= 2 * M_PI;
+    }
   }
 
   /**
@@ -260,35 +177,7 @@ struct AngleMeasurement : public AngleMeasurementBase {
 
       CalculateH(state_nonconst_new, H_new);
 
-      // Get rotation matrices.
-      Eigen::Matrix<double, 3, 3> C_q = state.Get<StateDefinition_T::q>()
-          .conjugate().toRotationMatrix();
-
-      // Construct residuals.
-      Eigen::Matrix<double, 3, 1> z_carth = (state.Get<StateDefinition_T::p>()
-          + C_q.transpose() * state.Get<StateDefinition_T::p_ip>());
-      double radius_old = sqrt(
-          z_carth(0, 0) * z_carth(0, 0) + z_carth(1, 0) * z_carth(1, 0)
-              + z_carth(2, 0) * z_carth(2, 0));
-      double theta_old = acos(z_carth(2, 0) / radius_old);
-      double phi_old = atan(z_carth(1, 0) / z_carth(0, 0));
-      // Handle all exeptions that occur when transforming in spherical coordinates.
-      if (z_carth(0, 0) < 0 && z_carth(1, 0) < 0) {
-        phi_old -= M_PI;
-      }
-      if (z_carth(0, 0) < 0 && z_carth(1, 0) > 0) {
-        phi_old += M_PI;
-      }
-
-      msf_core::Vector2 z_spherical;
-      z_spherical << theta_old, phi_old;
-      r_old = z_a_ - z_spherical;
-      if (r_old(1, 0) < -M_PI) {
-        r_old(1, 0) += 2 * M_PI;
-      }
-      if (r_old(1, 0) > M_PI) {
-        r_old(1, 0) -= 2 * M_PI;
-      }
+      CalculateResidual(state, r_old);
 
       if (!CheckForNumeric(r_old, "r_old")) {
         ROS_ERROR_STREAM("r_old: " << r_old);
@@ -331,9 +220,9 @@ typedef msf_core::MSF_Measurement<geometry_msgs::PointStamped,
 struct DistanceMeasurement : public DistanceMeasurementBase {
  private:
   typedef DistanceMeasurementBase Measurement_t;
-  typedef Measurement_t::Measurement_ptr measptr_t;
+  typedef Measurement_t::Measurement_type measurement_t;
 
-  virtual void MakeFromSensorReadingImpl(measptr_t msg) {
+  virtual void MakeFromSensorReadingImpl(const measurement_t& msg) {
     Eigen::Matrix<double, N_DISTANCE_MEASUREMENTS,
         msf_core::MSF_Core<msf_updates::EKFState>::nErrorStatesAtCompileTime> H_old;
     Eigen::Matrix<double, N_DISTANCE_MEASUREMENTS, 1> r_old;
@@ -341,7 +230,7 @@ struct DistanceMeasurement : public DistanceMeasurementBase {
     H_old.setZero();
 
     // Get measurement.
-    z_d_ << msg->point.z;
+    z_d_ << msg.point.z;
 
     if (fixed_covariance_)  //  Take fix covariance from reconfigure GUI.
     {
@@ -385,10 +274,6 @@ struct DistanceMeasurement : public DistanceMeasurementBase {
 
     H.setZero();
 
-    // Get rotation matrices.
-    Eigen::Matrix<double, 3, 3> C_q = state.Get<StateDefinition_T::q>()
-        .conjugate().toRotationMatrix();
-
     // Preprocess for elements in H matrix.
     // Get indices of states in error vector.
     enum {
@@ -408,56 +293,30 @@ struct DistanceMeasurement : public DistanceMeasurementBase {
     if (fixed_p_pos_imu)
       state_in->ClearCrossCov<StateDefinition_T::p_ip>();
 
-    Eigen::Matrix<double, 3, 1> p_ = state.Get<StateDefinition_T::p>();
-    Eigen::Matrix<double, 3, 1> p_ip = state.Get<StateDefinition_T::p_ip>();
-    Eigen::Matrix<double, 1, 3> dz_dp;
-    dz_dp(0, 0) = p_(0, 0) * 1.0
-        / sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0));
-    dz_dp(0, 1) = p_(1, 0) * 1.0
-        / sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0));
-    dz_dp(0, 2) = p_(2, 0) * 1.0
-        / sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0));
-    Eigen::Matrix<double, 1, 3> dz_dq;
-    dz_dq(0, 0) = (p_(0, 0)
-        * (C_q(0, 1) * p_ip(2, 0) * 2.0 - C_q(0, 2) * p_ip(1, 0) * 2.0)
-        + p_(1, 0)
-            * (C_q(1, 1) * p_ip(2, 0) * 2.0 - C_q(1, 2) * p_ip(1, 0) * 2.0)
-        + p_(2, 0)
-            * (C_q(2, 1) * p_ip(2, 0) * 2.0 - C_q(2, 2) * p_ip(1, 0) * 2.0))
-        * 1.0
-        / sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0))
-        * (-1.0 / 2.0);
-    dz_dq(0, 1) = (p_(0, 0)
-        * (C_q(0, 0) * p_ip(2, 0) * 2.0 - C_q(0, 2) * p_ip(0, 0) * 2.0)
-        + p_(1, 0)
-            * (C_q(1, 0) * p_ip(2, 0) * 2.0 - C_q(1, 2) * p_ip(0, 0) * 2.0)
-        + p_(2, 0)
-            * (C_q(2, 0) * p_ip(2, 0) * 2.0 - C_q(2, 2) * p_ip(0, 0) * 2.0))
-        * 1.0
-        / sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0))
-        * (1.0 / 2.0);
-    dz_dq(0, 2) = (p_(0, 0)
-        * (C_q(0, 0) * p_ip(1, 0) * 2.0 - C_q(0, 1) * p_ip(0, 0) * 2.0)
-        + p_(1, 0)
-            * (C_q(1, 0) * p_ip(1, 0) * 2.0 - C_q(1, 1) * p_ip(0, 0) * 2.0)
-        + p_(2, 0)
-            * (C_q(2, 0) * p_ip(1, 0) * 2.0 - C_q(2, 1) * p_ip(0, 0) * 2.0))
-        * 1.0
-        / sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0))
-        * (-1.0 / 2.0);
-    Eigen::Matrix<double, 1, 3> dz_dp_ip;
-    dz_dp_ip(0, 0) = (C_q(0, 0) * p_(0, 0) + C_q(1, 0) * p_(1, 0)
-        + C_q(2, 0) * p_(2, 0)) * 1.0
-        / sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0));
-    dz_dp_ip(0, 1) = (C_q(0, 1) * p_(0, 0) + C_q(1, 1) * p_(1, 0)
-        + C_q(2, 1) * p_(2, 0)) * 1.0
-        / sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0));
-    dz_dp_ip(0, 2) = (C_q(0, 2) * p_(0, 0) + C_q(1, 2) * p_(1, 0)
-        + C_q(2, 2) * p_(2, 0)) * 1.0
-        / sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0));
-    H.block<1, 3>(0, idxstartcorr_p_) = dz_dp;
-    H.block<1, 3>(0, idxstartcorr_q_) = dz_dq;
-    H.block<1, 3>(0, idxstartcorr_p_pi_) = dz_dp_ip;
+    DistanceJacobian(state.GetRotationMatrix<StateDefinition_T::q>(),
+                     state.Get<StateDefinition_T::p>(),
+                     state.Get<StateDefinition_T::p_ip>(), idxstartcorr_p_,
+                     idxstartcorr_q_, idxstartcorr_p_pi_, H);
+  }
+
+  /**
+   * \brief Residual of the absolute measurement against the given state.
+   */
+  void CalculateResidual(
+      const EKFState_T& state,
+      Eigen::Matrix<double, N_DISTANCE_MEASUREMENTS, 1>& r) const {
+    // Construct residuals
+    Eigen::Matrix<double, 3, 1> z_carth;
+    SensorPosition(state.GetRotationMatrix<StateDefinition_T::q>(),
+                   state.Get<StateDefinition_T::p>(),
+                   state.Get<StateDefinition_T::p_ip>(), z_carth);
+    double radius_old = sqrt(
+        z_carth(0, 0) * z_carth(0, 0) + z_carth(1, 0) * z_carth(1, 0)
+            + z_carth(2, 0) * z_carth(2, 0));
+
+    msf_core::Vector1 z_spherical;
+    z_spherical << radius_old;
+    r = z_d_ - z_spherical;
   }
 
   /**
@@ -476,20 +335,123 @@ struct DistanceMeasurement : public DistanceMeasurementBase {
 
       CalculateH(state_nonconst_new, H_new);
 
-      // Get rotation matrices.
-      Eigen::Matrix<double, 3, 3> C_q = state.Get<StateDefinition_T::q>()
-          .conjugate().toRotationMatrix();
+      CalculateResidual(state, r_old);
 
-      // Construct residuals
-      Eigen::Matrix<double, 3, 1> z_carth = (state.Get<StateDefinition_T::p>()
-          + C_q.transpose() * state.Get<StateDefinition_T::p_ip>());
-      double radius_old = sqrt(
-          z_carth(0, 0) * z_carth(0, 0) + z_carth(1, 0) * z_carth(1, 0)
-              + z_carth(2, 0) * z_carth(2, 0));
+      if (!CheckForNumeric(r_old, "r_old")) {
+        ROS_ERROR_STREAM("r_old: " << r_old);
+        ROS_WARN_STREAM(
+            "state: "
+                << const_cast<EKFState_T&>(state).ToEigenVector().transpose());
+      }
+      if (!CheckForNumeric(H_new, "H_old")) {
+        ROS_ERROR_STREAM("H_old: " << H_new);
+        ROS_WARN_STREAM(
+            "state: "
+                << const_cast<EKFState_T&>(state).ToEigenVector().transpose());
+      }
+      if (!CheckForNumeric(R_, "R_")) {
+        ROS_ERROR_STREAM("R_: " << R_);
+        ROS_WARN_STREAM(
+            "state: "
+                << const_cast<EKFState_T&>(state).ToEigenVector().transpose());
+      }
 
-      msf_core::Vector1 z_spherical;
-      z_spherical << radius_old;
-      r_old = z_d_ - z_spherical;
+      // Call update step in base class.
+      this->CalculateAndApplyCorrection(state_nonconst_new, core, H_new, r_old,
+                                        R_);
+    } else {
+      ROS_ERROR_STREAM_THROTTLE(
+          1,
+          "You chose to apply the position measurement as a relative quantitiy, "
+          "which is currently not implemented.");
+    }
+  }
+};
+/**
+ * \brief An angle and a distance measurement taken at the same time, applied
+ * in a single update. The point holds theta and phi in x and y and the
+ * distance in z, as for the separate measurements.
+ */
+typedef msf_core::MSF_Measurement<geometry_msgs::PointStamped,
+    Eigen::Matrix<double, N_SPHERICAL_MEASUREMENTS, N_SPHERICAL_MEASUREMENTS>,
+    msf_updates::EKFState> SphericalMeasurementBase;
+struct SphericalMeasurement : public SphericalMeasurementBase {
+ private:
+  typedef SphericalMeasurementBase Measurement_t;
+  typedef Measurement_t::Measurement_type measurement_t;
+
+  virtual void MakeFromSensorReadingImpl(const measurement_t& msg) {
+    angle_.MakeFromSensorReading(msg, time);
+    distance_.MakeFromSensorReading(msg, time);
+    SetR();
+  }
+
+  void SetR() {
+    R_.setZero();
+    R_.block<N_ANGLE_MEASUREMENTS, N_ANGLE_MEASUREMENTS>(0, 0) = angle_.GetR();
+    R_.block<N_DISTANCE_MEASUREMENTS, N_DISTANCE_MEASUREMENTS>(
+        N_ANGLE_MEASUREMENTS, N_ANGLE_MEASUREMENTS) = distance_.GetR();
+  }
+
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  AngleMeasurement angle_;
+  DistanceMeasurement distance_;
+
+  typedef msf_updates::EKFState EKFState_T;
+  virtual ~SphericalMeasurement() {
+  }
+  SphericalMeasurement(double n_za, double n_zd, bool fixed_covariance,
+                       bool isabsoluteMeasurement, int sensorID,
+                       int fixedstates)
+      : SphericalMeasurementBase(isabsoluteMeasurement, sensorID),
+        angle_(n_za, fixed_covariance, isabsoluteMeasurement, sensorID,
+               fixedstates),
+        distance_(n_zd, fixed_covariance, isabsoluteMeasurement, sensorID,
+                  fixedstates) {
+  }
+  /**
+   * \brief Joins an angle and a distance measurement with the same
+   * timestamp.
+   */
+  SphericalMeasurement(const AngleMeasurement& angle,
+                       const DistanceMeasurement& distance)
+      : SphericalMeasurementBase(angle.isabsolute_, angle.sensorID_),
+        angle_(angle),
+        distance_(distance) {
+    time = angle.time;
+    SetR();
+  }
+  virtual std::string Type() {
+    return "spherical";
+  }
+
+  /**
+   * The method called by the msf_core to apply the measurement represented by
+   * this object.
+   */
+  virtual void Apply(boost::shared_ptr<EKFState_T> state_nonconst_new,
+                     msf_core::MSF_Core<EKFState_T>& core) {
+    if (isabsolute_) {
+      const EKFState_T& state = *state_nonconst_new;  // Get a const ref, so we can read core states.
+      Eigen::Matrix<double, N_ANGLE_MEASUREMENTS,
+          msf_core::MSF_Core<EKFState_T>::nErrorStatesAtCompileTime> H_angle;
+      Eigen::Matrix<double, N_DISTANCE_MEASUREMENTS,
+          msf_core::MSF_Core<EKFState_T>::nErrorStatesAtCompileTime> H_distance;
+      Eigen::Matrix<double, N_ANGLE_MEASUREMENTS, 1> r_angle;
+      Eigen::Matrix<double, N_DISTANCE_MEASUREMENTS, 1> r_distance;
+
+      angle_.CalculateH(state_nonconst_new, H_angle);
+      distance_.CalculateH(state_nonconst_new, H_distance);
+      angle_.CalculateResidual(state, r_angle);
+      distance_.CalculateResidual(state, r_distance);
+
+      Eigen::Matrix<double, N_SPHERICAL_MEASUREMENTS,
+          msf_core::MSF_Core<EKFState_T>::nErrorStatesAtCompileTime> H_new;
+      Eigen::Matrix<double, N_SPHERICAL_MEASUREMENTS, 1> r_old;
+      H_new << H_angle, H_distance;
+      r_old << r_angle, r_distance;
 
       if (!CheckForNumeric(r_old, "r_old")) {
         ROS_ERROR_STREAM("r_old: " << r_old);
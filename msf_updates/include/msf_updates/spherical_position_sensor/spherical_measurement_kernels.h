@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <slynen at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Generated by msf_updates/scripts/generate_measurement_kernels.py.
+// Do not edit, change the script and run it again.
+#ifndef SPHERICAL_MEASUREMENT_KERNELS_H_
+#define SPHERICAL_MEASUREMENT_KERNELS_H_
+
+#include <cmath>
+
+#include <Eigen/Dense>
+
+namespace msf_spherical_position {
+/*
+ * Measurement Jacobians and predictions of the spherical position sensor.
+ */
+
+/**
+ * \brief H of the angle measurement theta = acos(z / r), phi = atan(y / x) of the
+ * position of the sensor. C_q is the rotation matrix of q.
+ */
+template<typename Derived>
+inline void AngleJacobian(const Eigen::Matrix<double, 3, 3>& C_q,
+                          const Eigen::Matrix<double, 3, 1>& p,
+                          const Eigen::Matrix<double, 3, 1>& p_ip,
+                          int idxstartcorr_p,
+                          int idxstartcorr_q,
+                          int idxstartcorr_p_ip,
+                          Eigen::MatrixBase<Derived>& H) {
+  const double C_q_00 = C_q(0, 0);
+  const double C_q_01 = C_q(0, 1);
+  const double C_q_02 = C_q(0, 2);
+  const double C_q_10 = C_q(1, 0);
+  const double C_q_11 = C_q(1, 1);
+  const double C_q_12 = C_q(1, 2);
+  const double C_q_20 = C_q(2, 0);
+  const double C_q_21 = C_q(2, 1);
+  const double C_q_22 = C_q(2, 2);
+  const double p_0 = p(0);
+  const double p_1 = p(1);
+  const double p_2 = p(2);
+  const double p_ip_0 = p_ip(0);
+  const double p_ip_1 = p_ip(1);
+  const double p_ip_2 = p_ip(2);
+
+  const double t0 = p_0 * p_0 + p_1 * p_1;
+  const double t1 = 1.0 / (p_2 * p_2 + t0);
+  const double t2 = std::sqrt(t0);
+  const double t3 = p_2 / t2;
+  const double t4 = t1 * t3;
+  const double t5 = 1.0 / t0;
+  const double t6 = p_0 * t3;
+  const double t7 = p_1 * t3;
+  const double t8 = C_q_20 * t6 + C_q_21 * t7 - C_q_22 * t2;
+  const double t9 = C_q_10 * t6 + C_q_11 * t7 - C_q_12 * t2;
+  const double t10 = C_q_00 * t6 + C_q_01 * t7 - C_q_02 * t2;
+  const double t11 = C_q_20 * p_1 - C_q_21 * p_0;
+  const double t12 = C_q_10 * p_1 - C_q_11 * p_0;
+  const double t13 = C_q_00 * p_1 - C_q_01 * p_0;
+
+  H(0, idxstartcorr_p + 0) = p_0 * t4;
+  H(0, idxstartcorr_p + 1) = p_1 * t4;
+  H(0, idxstartcorr_p + 2) = -t1 * t2;
+  H(1, idxstartcorr_p + 0) = -p_1 * t5;
+  H(1, idxstartcorr_p + 1) = p_0 * t5;
+  H(1, idxstartcorr_p + 2) = 0.0;
+  H(0, idxstartcorr_q + 0) = t1 * (p_ip_1 * t8 - p_ip_2 * t9);
+  H(0, idxstartcorr_q + 1) = t1 * (-p_ip_0 * t8 + p_ip_2 * t10);
+  H(0, idxstartcorr_q + 2) = t1 * (p_ip_0 * t9 - p_ip_1 * t10);
+  H(1, idxstartcorr_q + 0) = t5 * (-p_ip_1 * t11 + p_ip_2 * t12);
+  H(1, idxstartcorr_q + 1) = t5 * (p_ip_0 * t11 - p_ip_2 * t13);
+  H(1, idxstartcorr_q + 2) = t5 * (-p_ip_0 * t12 + p_ip_1 * t13);
+  H(0, idxstartcorr_p_ip + 0) = t1 * t10;
+  H(0, idxstartcorr_p_ip + 1) = t1 * t9;
+  H(0, idxstartcorr_p_ip + 2) = t1 * t8;
+  H(1, idxstartcorr_p_ip + 0) = -t13 * t5;
+  H(1, idxstartcorr_p_ip + 1) = -t12 * t5;
+  H(1, idxstartcorr_p_ip + 2) = -t11 * t5;
+}
+
+/**
+ * \brief H of the distance measurement r = |p + C_q * p_ip|. C_q is the rotation
+ * matrix of q.
+ */
+template<typename Derived>
+inline void DistanceJacobian(const Eigen::Matrix<double, 3, 3>& C_q,
+                             const Eigen::Matrix<double, 3, 1>& p,
+                             const Eigen::Matrix<double, 3, 1>& p_ip,
+                             int idxstartcorr_p,
+                             int idxstartcorr_q,
+                             int idxstartcorr_p_ip,
+                             Eigen::MatrixBase<Derived>& H) {
+  const double C_q_00 = C_q(0, 0);
+  const double C_q_01 = C_q(0, 1);
+  const double C_q_02 = C_q(0, 2);
+  const double C_q_10 = C_q(1, 0);
+  const double C_q_11 = C_q(1, 1);
+  const double C_q_12 = C_q(1, 2);
+  const double C_q_20 = C_q(2, 0);
+  const double C_q_21 = C_q(2, 1);
+  const double C_q_22 = C_q(2, 2);
+  const double p_0 = p(0);
+  const double p_1 = p(1);
+  const double p_2 = p(2);
+  const double p_ip_0 = p_ip(0);
+  const double p_ip_1 = p_ip(1);
+  const double p_ip_2 = p_ip(2);
+
+  const double t0 = 1.0 / std::sqrt(p_0 * p_0 + p_1 * p_1 + p_2 * p_2);
+  const double t1 = C_q_20 * p_0 + C_q_21 * p_1 + C_q_22 * p_2;
+  const double t2 = C_q_10 * p_0 + C_q_11 * p_1 + C_q_12 * p_2;
+  const double t3 = C_q_00 * p_0 + C_q_01 * p_1 + C_q_02 * p_2;
+
+  H(0, idxstartcorr_p + 0) = p_0 * t0;
+  H(0, idxstartcorr_p + 1) = p_1 * t0;
+  H(0, idxstartcorr_p + 2) = p_2 * t0;
+  H(0, idxstartcorr_q + 0) = t0 * (p_ip_1 * t1 - p_ip_2 * t2);
+  H(0, idxstartcorr_q + 1) = t0 * (-p_ip_0 * t1 + p_ip_2 * t3);
+  H(0, idxstartcorr_q + 2) = t0 * (p_ip_0 * t2 - p_ip_1 * t3);
+  H(0, idxstartcorr_p_ip + 0) = t0 * t3;
+  H(0, idxstartcorr_p_ip + 1) = t0 * t2;
+  H(0, idxstartcorr_p_ip + 2) = t0 * t1;
+}
+
+/**
+ * \brief Position of the sensor p + C_q * p_ip, from which the angles and the
+ * distance are predicted.
+ */
+inline void SensorPosition(const Eigen::Matrix<double, 3, 3>& C_q,
+                           const Eigen::Matrix<double, 3, 1>& p,
+                           const Eigen::Matrix<double, 3, 1>& p_ip,
+                           Eigen::Matrix<double, 3, 1>& z_p) {
+  const double C_q_00 = C_q(0, 0);
+  const double C_q_01 = C_q(0, 1);
+  const double C_q_02 = C_q(0, 2);
+  const double C_q_10 = C_q(1, 0);
+  const double C_q_11 = C_q(1, 1);
+  const double C_q_12 = C_q(1, 2);
+  const double C_q_20 = C_q(2, 0);
+  const double C_q_21 = C_q(2, 1);
+  const double C_q_22 = C_q(2, 2);
+  const double p_0 = p(0);
+  const double p_1 = p(1);
+  const double p_2 = p(2);
+  const double p_ip_0 = p_ip(0);
+  const double p_ip_1 = p_ip(1);
+  const double p_ip_2 = p_ip(2);
+
+  z_p(0) = C_q_00 * p_ip_0 + C_q_01 * p_ip_1 + C_q_02 * p_ip_2 + p_0;
+  z_p(1) = C_q_10 * p_ip_0 + C_q_11 * p_ip_1 + C_q_12 * p_ip_2 + p_1;
+  z_p(2) = C_q_20 * p_ip_0 + C_q_21 * p_ip_1 + C_q_22 * p_ip_2 + p_2;
+}
+}  // namespace msf_spherical_position
+#endif  // SPHERICAL_MEASUREMENT_KERNELS_H_
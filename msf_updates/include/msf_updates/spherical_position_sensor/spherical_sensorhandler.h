@@ -17,10 +17,76 @@
 #ifndef SPHERICAL_POSITION_SENSOR_H
 #define SPHERICAL_POSITION_SENSOR_H
 
+#include <cmath>
 #include <msf_core/msf_sensormanagerROS.h>
 #include <geometry_msgs/PointStamped.h>
+#include <msf_updates/spherical_position_sensor/spherical_measurement.h>
 
 namespace msf_spherical_position {
+/**
+ * \brief Joins angle and distance readings with the same timestamp into one
+ * SphericalMeasurement, so a total station reading costs one update instead
+ * of two. A reading is held back until the next reading of either sensor
+ * arrives. Readings without a partner are applied as separate measurements.
+ */
+class SphericalMeasurementPairing {
+ public:
+  SphericalMeasurementPairing(
+      msf_core::MSF_SensorManager<msf_updates::EKFState>& manager,
+      double max_dt)
+      : manager_(manager),
+        max_dt_(max_dt),
+        pending_stamp_(0) {
+  }
+  /// The stamp is the one of the sensor message, before delay compensation.
+  void AddMeasurement(const boost::shared_ptr<AngleMeasurement>& angle,
+                      double stamp) {
+    if (pending_distance_ && std::abs(stamp - pending_stamp_) <= max_dt_) {
+      Apply(angle, pending_distance_);
+      pending_distance_.reset();
+      return;
+    }
+    Flush();
+    pending_angle_ = angle;
+    pending_stamp_ = stamp;
+  }
+  void AddMeasurement(const boost::shared_ptr<DistanceMeasurement>& distance,
+                      double stamp) {
+    if (pending_angle_ && std::abs(stamp - pending_stamp_) <= max_dt_) {
+      Apply(pending_angle_, distance);
+      pending_angle_.reset();
+      return;
+    }
+    Flush();
+    pending_distance_ = distance;
+    pending_stamp_ = stamp;
+  }
+  /// Applies the reading which waits for its partner on its own.
+  void Flush() {
+    if (pending_angle_) {
+      manager_.msf_core_->AddMeasurement(pending_angle_);
+      pending_angle_.reset();
+    }
+    if (pending_distance_) {
+      manager_.msf_core_->AddMeasurement(pending_distance_);
+      pending_distance_.reset();
+    }
+  }
+
+ private:
+  void Apply(const boost::shared_ptr<AngleMeasurement>& angle,
+             const boost::shared_ptr<DistanceMeasurement>& distance) {
+    boost::shared_ptr<SphericalMeasurement> meas(
+        new SphericalMeasurement(*angle, *distance));
+    manager_.msf_core_->AddMeasurement(meas);
+  }
+
+  msf_core::MSF_SensorManager<msf_updates::EKFState>& manager_;
+  double max_dt_;  ///< Maximum difference of the stamps of a pair [s].
+  double pending_stamp_;
+  boost::shared_ptr<AngleMeasurement> pending_angle_;
+  boost::shared_ptr<DistanceMeasurement> pending_distance_;
+};
 
 template<typename MEASUREMENT_TYPE, typename MANAGER_TYPE>
 class AngleSensorHandler : public msf_core::SensorHandler<
@@ -32,6 +98,7 @@ class AngleSensorHandler : public msf_core::SensorHandler<
                        // measurement provided by this sensor.
 
   ros::Subscriber subPointStamped_;
+  boost::shared_ptr<SphericalMeasurementPairing> pairing_;
   bool use_fixed_covariance_;
   bool provides_absolute_measurements_;  ///< Does this sensor measure relative or absolute values.
 
@@ -47,6 +114,10 @@ class AngleSensorHandler : public msf_core::SensorHandler<
   // Setters for configure values.
   void SetNoises(double n_za);
   void SetDelay(double delay);
+  /// Readings are passed to the pairing instead of the core if set.
+  void SetPairing(const boost::shared_ptr<SphericalMeasurementPairing>& pairing) {
+    pairing_ = pairing;
+  }
 };
 
 template<typename MEASUREMENT_TYPE, typename MANAGER_TYPE>
@@ -59,6 +130,7 @@ class DistanceSensorHandler : public msf_core::SensorHandler<
                         //the measurement provided by this sensor.
 
   ros::Subscriber subPointStamped_;
+  boost::shared_ptr<SphericalMeasurementPairing> pairing_;
 
   bool use_fixed_covariance_;
   bool provides_absolute_measurements_;  ///< Does this sensor measure relative or absolute values.
@@ -75,6 +147,10 @@ class DistanceSensorHandler : public msf_core::SensorHandler<
   // Setters for configure values.
   void SetNoises(double n_za);
   void SetDelay(double delay);
+  /// Readings are passed to the pairing instead of the core if set.
+  void SetPairing(const boost::shared_ptr<SphericalMeasurementPairing>& pairing) {
+    pairing_ = pairing;
+  }
 };
 }  // namespace msf_spherical_position
 #include "./implementation/spherical_sensorhandler.hpp"
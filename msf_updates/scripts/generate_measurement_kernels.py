@@ -0,0 +1,344 @@
+#!/usr/bin/env python
+#
+# Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+# You can contact the author at <slynen at ethz dot ch>
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Generates the measurement Jacobian and prediction kernels of the shipped
+# measurement models with common subexpression elimination, like CalcQCore
+# for the process noise. Needs sympy. Run from anywhere, the headers are
+# written next to the measurements:
+#
+#   msf_updates/scripts/generate_measurement_kernels.py
+#
+# The rotation matrices are inputs, so the kernels use the ones cached in the
+# states. The derivatives are taken w.r.t. the error states, i.e. position
+# offsets and small rotations dtheta with C(q * dq) = C(q) * (I + [dtheta]x).
+
+import os
+import re
+import sympy as sp
+from sympy.printing.cxx import CXX11CodePrinter
+
+INCLUDE_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                           os.pardir, 'include', 'msf_updates')
+
+LICENSE = """/*
+ * Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <slynen at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+"""
+
+
+class KernelPrinter(CXX11CodePrinter):
+  """Writes small integer and half powers as products and square roots."""
+
+  def _print_Pow(self, expr):
+    base, exp = expr.as_base_exp()
+    b = self.parenthesize(base, sp.printing.precedence.PRECEDENCE['Mul'])
+    if exp == 2:
+      return '%s * %s' % (b, b)
+    if exp == 3:
+      return '%s * %s * %s' % (b, b, b)
+    if exp == -1:
+      return '1.0 / %s' % b
+    if exp == -2:
+      return '1.0 / (%s * %s)' % (b, b)
+    if exp == sp.Rational(1, 2):
+      return 'std::sqrt(%s)' % self._print(base)
+    if exp == -sp.Rational(1, 2):
+      return '1.0 / std::sqrt(%s)' % self._print(base)
+    if exp == sp.Rational(3, 2):
+      return '%s * std::sqrt(%s)' % (b, self._print(base))
+    if exp == -sp.Rational(3, 2):
+      return '1.0 / (%s * std::sqrt(%s))' % (b, self._print(base))
+    return CXX11CodePrinter._print_Pow(self, expr)
+
+
+def print_expr(expr):
+  """C++ code of expr, with spaces around the operators and doubles."""
+  if expr.is_Integer:
+    return '%d.0' % int(expr)
+  return re.sub(r'(?<=\S)([*/])(?=\S)', r' \1 ', KernelPrinter().doprint(expr))
+
+
+def vector(name):
+  return sp.Matrix(sp.symbols('%s_0:3' % name, real=True))
+
+
+def rotation(name):
+  return sp.Matrix(3, 3, lambda i, j: sp.Symbol('%s_%d%d' % (name, i, j),
+                                                real=True))
+
+
+def skew(v):
+  return sp.Matrix([[0, -v[2], v[1]], [v[2], 0, -v[0]], [-v[1], v[0], 0]])
+
+
+def jacobian(expr, wrt):
+  return sp.Matrix(expr).jacobian(sp.Matrix(wrt))
+
+
+class Input(object):
+  def __init__(self, kind, name):
+    self.kind = kind
+    self.name = name
+    if kind == 'rotation':
+      self.value = rotation(name)
+    elif kind == 'vector':
+      self.value = vector(name)
+    else:
+      self.value = sp.Symbol(name, real=True)
+
+  def declaration(self):
+    return {'rotation': 'const Eigen::Matrix<double, 3, 3>& ',
+            'vector': 'const Eigen::Matrix<double, 3, 1>& ',
+            'scalar': 'double '}[self.kind] + self.name
+
+  def unpack(self):
+    if self.kind == 'scalar':
+      return []
+    if self.kind == 'rotation':
+      return [(self.value[i, j], '%s(%d, %d)' % (self.name, i, j))
+              for i in range(3) for j in range(3)]
+    return [(self.value[i], '%s(%d)' % (self.name, i)) for i in range(3)]
+
+
+class Kernel(object):
+  """
+  A function writing either blocks of H, at the columns of the error states,
+  or a vector output.
+  """
+
+  def __init__(self, name, doc, inputs):
+    self.name = name
+    self.doc = doc
+    self.inputs = inputs
+    self.blocks = []
+    self.output = None
+
+  def add_block(self, state, row, value):
+    self.blocks.append((state, row, sp.Matrix(value)))
+
+  def set_output(self, name, value):
+    self.output = (name, sp.Matrix(value))
+
+  def emit(self):
+    targets = []
+    exprs = []
+    if self.output is None:
+      for state, row, value in self.blocks:
+        for i in range(value.rows):
+          for j in range(value.cols):
+            targets.append('H(%d, idxstartcorr_%s + %d)' % (row + i, state, j))
+            exprs.append(value[i, j])
+    else:
+      name, value = self.output
+      for i in range(value.rows):
+        targets.append('%s(%d)' % (name, i))
+        exprs.append(value[i])
+    replacements, reduced = sp.cse(exprs,
+                                   symbols=sp.numbered_symbols('t'),
+                                   optimizations='basic')
+
+    used = set()
+    for expr in [e for _, e in replacements] + reduced:
+      used |= expr.free_symbols
+
+    args = [i.declaration() for i in self.inputs]
+    if self.output is None:
+      args += ['int idxstartcorr_%s' % state
+               for state in sorted(set(b[0] for b in self.blocks),
+                                   key=[b[0] for b in self.blocks].index)]
+      args.append('Eigen::MatrixBase<Derived>& H')
+      head = 'template<typename Derived>\ninline void %s(' % self.name
+    else:
+      args.append('Eigen::Matrix<double, %d, 1>& %s' % (self.output[1].rows,
+                                                        self.output[0]))
+      head = 'inline void %s(' % self.name
+
+    lines = ['/**']
+    lines += [(' * ' + l).rstrip() for l in self.doc.strip().split('\n')]
+    lines.append(' */')
+    lines.append(head + (',\n' + ' ' * len(head.split('\n')[-1])).join(args)
+                 + ') {')
+    for i in self.inputs:
+      for symbol, access in i.unpack():
+        if symbol in used:
+          lines.append('  const double %s = %s;' % (symbol, access))
+    lines.append('')
+    for symbol, expr in replacements:
+      lines.append('  const double %s = %s;' % (symbol, print_expr(expr)))
+    if replacements:
+      lines.append('')
+    for target, expr in zip(targets, reduced):
+      lines.append('  %s = %s;' % (target, print_expr(expr)))
+    lines.append('}')
+    return '\n'.join(lines) + '\n'
+
+
+def write_header(path, guard, namespaces, description, kernels):
+  text = LICENSE
+  text += '// Generated by msf_updates/scripts/generate_measurement_kernels.py.\n'
+  text += '// Do not edit, change the script and run it again.\n'
+  text += '#ifndef %s\n#define %s\n\n' % (guard, guard)
+  text += '#include <cmath>\n\n#include <Eigen/Dense>\n\n'
+  for namespace in namespaces:
+    text += 'namespace %s {\n' % namespace
+  text += '/*\n' + ''.join((' * ' + l).rstrip() + '\n'
+                           for l in description.strip().split('\n')) + ' */\n\n'
+  text += '\n'.join(k.emit() for k in kernels)
+  for namespace in reversed(namespaces):
+    text += '}  // namespace %s\n' % namespace
+  text += '#endif  // %s\n' % guard
+  with open(os.path.join(INCLUDE_DIR, path), 'w') as f:
+    f.write(text)
+
+
+def pose_kernels():
+  C_q, C_wv, C_ic = (Input('rotation', n) for n in ('C_q', 'C_wv', 'C_ic'))
+  p, p_wv, p_ic = (Input('vector', n) for n in ('p', 'p_wv', 'p_ic'))
+  L = Input('scalar', 'L')
+  dtheta_q, dtheta_wv = vector('dtheta_q'), vector('dtheta_wv')
+  at_zero = dict((s, 0) for s in list(dtheta_q) + list(dtheta_wv))
+
+  # Position of the camera in the vision frame, scaled.
+  position = (C_wv.value * (sp.eye(3) + skew(dtheta_wv))
+              * (p.value - p_wv.value + C_q.value * (sp.eye(3) + skew(dtheta_q))
+                 * p_ic.value) * L.value)
+
+  jac = Kernel('PoseJacobian', """
+\\brief H of the pose measurement: the rows of the position, then the ones of
+the attitude. C_q, C_wv and C_ic are the rotation matrices of q, q_wv and q_ic.
+""", [C_q, C_wv, C_ic, p, p_wv, p_ic, L])
+  jac.add_block('p', 0, jacobian(position, p.value).subs(at_zero))
+  jac.add_block('q', 0, jacobian(position, dtheta_q).subs(at_zero))
+  jac.add_block('L', 0, jacobian(position, [L.value]).subs(at_zero))
+  jac.add_block('q_wv', 0, jacobian(position, dtheta_wv).subs(at_zero))
+  jac.add_block('p_ic', 0, jacobian(position, p_ic.value).subs(at_zero))
+  # The drift of the position is not scaled, as in the original filter.
+  jac.add_block('p_wv', 0, -sp.eye(3))
+  jac.add_block('q', 3, C_ic.value.T)
+  jac.add_block('q_wv', 3, C_ic.value.T * C_q.value.T)
+  jac.add_block('q_ic', 3, sp.eye(3))
+
+  prediction = Kernel('PosePositionPrediction', """
+\\brief Position the pose measurement expects: C_wv * (p - p_wv + C_q * p_ic) * L.
+""", [C_q, C_wv, p, p_wv, p_ic, L])
+  prediction.set_output('z_p', position.subs(at_zero))
+
+  write_header(os.path.join('pose_sensor_handler', 'pose_measurement_kernels.h'),
+               'POSE_MEASUREMENT_KERNELS_H_',
+               ['msf_updates', 'pose_measurement'], """
+Measurement Jacobian and prediction of the pose sensor.
+""", [jac, prediction])
+
+
+def position_kernels():
+  C_q = Input('rotation', 'C_q')
+  p, p_ip = Input('vector', 'p'), Input('vector', 'p_ip')
+  dtheta_q = vector('dtheta_q')
+  at_zero = dict((s, 0) for s in dtheta_q)
+
+  position = p.value + C_q.value * (sp.eye(3) + skew(dtheta_q)) * p_ip.value
+
+  jac = Kernel('PositionJacobian', """
+\\brief H of the position measurement. C_q is the rotation matrix of q.
+""", [C_q, p, p_ip])
+  jac.add_block('p', 0, jacobian(position, p.value).subs(at_zero))
+  jac.add_block('q', 0, jacobian(position, dtheta_q).subs(at_zero))
+  jac.add_block('p_ip', 0, jacobian(position, p_ip.value).subs(at_zero))
+
+  prediction = Kernel('PositionPrediction', """
+\\brief Position the position measurement expects: p + C_q * p_ip.
+""", [C_q, p, p_ip])
+  prediction.set_output('z_p', position.subs(at_zero))
+
+  write_header(
+      os.path.join('position_sensor_handler', 'position_measurement_kernels.h'),
+      'POSITION_MEASUREMENT_KERNELS_H_',
+      ['msf_updates', 'position_measurement'], """
+Measurement Jacobian and prediction of the position sensor.
+""", [jac, prediction])
+
+
+def spherical_kernels():
+  C_q = Input('rotation', 'C_q')
+  p, p_ip = Input('vector', 'p'), Input('vector', 'p_ip')
+  x = vector('x')
+  at_p = dict(zip(x, p.value))
+  rho = sp.sqrt(x[0] ** 2 + x[1] ** 2)
+  radius = sp.sqrt(x[0] ** 2 + x[1] ** 2 + x[2] ** 2)
+
+  # The original filter takes the derivatives at p rather than at the position
+  # of the sensor and chains them with the transposed rotation, which the
+  # kernels reproduce.
+  lever = C_q.value.T
+
+  def add_blocks(kernel, J):
+    kernel.add_block('p', 0, J)
+    kernel.add_block('q', 0, -J * lever * skew(p_ip.value))
+    kernel.add_block('p_ip', 0, J * lever)
+
+  angle = Kernel('AngleJacobian', """
+\\brief H of the angle measurement theta = acos(z / r), phi = atan(y / x) of the
+position of the sensor. C_q is the rotation matrix of q.
+""", [C_q, p, p_ip])
+  add_blocks(angle, sp.Matrix([
+      [x[0] * x[2] / (rho * radius ** 2), x[1] * x[2] / (rho * radius ** 2),
+       -rho / radius ** 2],
+      [-x[1] / rho ** 2, x[0] / rho ** 2, 0]]).subs(at_p))
+  # Check the simplified derivatives at some point.
+  theta_phi = sp.Matrix([sp.acos(x[2] / radius), sp.atan(x[1] / x[0])])
+  point = dict(zip(x, (0.3, -1.2, 0.7)))
+  assert (jacobian(theta_phi, x).subs(point)
+          - angle.blocks[0][2].subs(dict(zip(p.value, x))).subs(point)).norm() < 1e-12
+
+  distance = Kernel('DistanceJacobian', """
+\\brief H of the distance measurement r = |p + C_q * p_ip|. C_q is the rotation
+matrix of q.
+""", [C_q, p, p_ip])
+  add_blocks(distance, jacobian([radius], x).subs(at_p))
+
+  position = p.value + C_q.value * p_ip.value
+  cartesian = Kernel('SensorPosition', """
+\\brief Position of the sensor p + C_q * p_ip, from which the angles and the
+distance are predicted.
+""", [C_q, p, p_ip])
+  cartesian.set_output('z_p', position)
+
+  write_header(
+      os.path.join('spherical_position_sensor',
+                   'spherical_measurement_kernels.h'),
+      'SPHERICAL_MEASUREMENT_KERNELS_H_', ['msf_spherical_position'], """
+Measurement Jacobians and predictions of the spherical position sensor.
+""", [angle, distance, cartesian])
+
+
+if __name__ == '__main__':
+  pose_kernels()
+  position_kernels()
+  spherical_kernels()
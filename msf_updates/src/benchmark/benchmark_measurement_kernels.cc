@@ -0,0 +1,408 @@
+/*
+ * Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <slynen at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/*
+ * Compares the generated measurement kernels of the pose, position and
+ * spherical position sensors to the Eigen expressions they replace, on random
+ * states. Prints the largest difference and the time per call of both and
+ * fails if they differ by more than the rounding errors.
+ *
+ * Usage: benchmark_measurement_kernels [iterations]
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <msf_core/eigen_utils.h>
+#include <msf_updates/pose_sensor_handler/pose_measurement_kernels.h>
+#include <msf_updates/position_sensor_handler/position_measurement_kernels.h>
+#include <msf_updates/spherical_position_sensor/spherical_measurement_kernels.h>
+
+namespace {
+typedef std::chrono::steady_clock Clock;
+typedef Eigen::Matrix<double, 3, 3> Matrix3;
+typedef Eigen::Matrix<double, 3, 1> Vector3;
+
+/// Error state layout of pose_msf, i.e. p, v, q, b_w, b_a, L, q_wv, p_wv,
+/// q_ic, p_ic.
+enum {
+  nErrorStates = 28,
+  idx_p = 0,
+  idx_q = 6,
+  idx_L = 15,
+  idx_q_wv = 16,
+  idx_p_wv = 19,
+  idx_q_ic = 22,
+  idx_p_ic = 25,
+  /// p_ip of the position and spherical sensors.
+  idx_p_ip = 15
+};
+typedef Eigen::Matrix<double, 6, nErrorStates> PoseH;
+typedef Eigen::Matrix<double, 3, nErrorStates> PositionH;
+typedef Eigen::Matrix<double, 2, nErrorStates> AngleH;
+typedef Eigen::Matrix<double, 1, nErrorStates> DistanceH;
+
+struct State {
+  Matrix3 C_q, C_wv, C_ic;
+  Vector3 p, p_wv, p_ic;
+  double L;
+};
+
+State RandomState(std::mt19937& generator) {
+  std::normal_distribution<double> normal;
+  State state;
+  state.C_q = Eigen::Quaterniond(Eigen::Vector4d::NullaryExpr(
+      [&]() {return normal(generator);}).normalized()).toRotationMatrix();
+  state.C_wv = Eigen::Quaterniond(Eigen::Vector4d::NullaryExpr(
+      [&]() {return normal(generator);}).normalized()).toRotationMatrix();
+  state.C_ic = Eigen::Quaterniond(Eigen::Vector4d::NullaryExpr(
+      [&]() {return normal(generator);}).normalized()).toRotationMatrix();
+  state.p = 5 * Vector3::NullaryExpr([&]() {return normal(generator);});
+  state.p_wv = Vector3::NullaryExpr([&]() {return normal(generator);});
+  state.p_ic = 0.1 * Vector3::NullaryExpr([&]() {return normal(generator);});
+  state.L = 1 + 0.1 * normal(generator);
+  return state;
+}
+
+// The implementations the kernels replace.
+void ReferencePoseH(const State& s, PoseH& H) {
+  const Matrix3& C_wv = s.C_wv;
+  const Matrix3& C_q = s.C_q;
+  const Matrix3 C_ci = s.C_ic.transpose();
+  const Vector3 vecold = (-s.p_wv + s.p + C_q * s.p_ic) * s.L;
+  const Matrix3 skewold = Skew(vecold);
+  const Matrix3 pci_sk = Skew(s.p_ic);
+  H.setZero();
+  H.block<3, 3>(0, idx_p) = C_wv * s.L;
+  H.block<3, 3>(0, idx_q) = -C_wv * C_q * pci_sk * s.L;
+  H.block<3, 1>(0, idx_L) = C_wv * C_q * s.p_ic + C_wv * (-s.p_wv + s.p);
+  H.block<3, 3>(0, idx_q_wv) = -C_wv * skewold;
+  H.block<3, 3>(0, idx_p_ic) = C_wv * C_q * s.L;
+  H.block<3, 3>(0, idx_p_wv) = -Matrix3::Identity();
+  H.block<3, 3>(3, idx_q) = C_ci;
+  H.block<3, 3>(3, idx_q_wv) = C_ci * C_q.transpose();
+  H.block<3, 3>(3, idx_q_ic) = Matrix3::Identity();
+}
+
+void ReferencePosePrediction(const State& s, Vector3& z_p) {
+  z_p = s.C_wv * (-s.p_wv + s.p + s.C_q * s.p_ic) * s.L;
+}
+
+void ReferencePositionH(const State& s, PositionH& H) {
+  H.setZero();
+  H.block<3, 3>(0, idx_p) = Matrix3::Identity();
+  H.block<3, 3>(0, idx_q) = -s.C_q * Skew(s.p_ic);
+  H.block<3, 3>(0, idx_p_ip) = s.C_q;
+}
+
+void ReferencePositionPrediction(const State& s, Vector3& z_p) {
+  z_p = s.p + s.C_q * s.p_ic;
+}
+
+void ReferenceAngleH(const State& s, AngleH& H) {
+  const Matrix3 C_q = s.C_q.transpose();
+  const Vector3& p_ = s.p;
+  const Vector3& p_ip = s.p_ic;
+  H.setZero();
+  Eigen::Matrix<double, 2, 3> dz_dp;
+  dz_dp(0, 0) = (p_(0, 0) * p_(2, 0) * 1.0
+      / sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0)))
+      / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0));
+  dz_dp(0, 1) = (p_(1, 0) * p_(2, 0) * 1.0
+      / sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0)))
+      / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0));
+  dz_dp(0, 2) = -sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0))
+      / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0));
+  dz_dp(1, 0) = -p_(1, 0) / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0));
+  dz_dp(1, 1) = p_(0, 0) / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0));
+  dz_dp(1, 2) = 0;
+  Eigen::Matrix<double, 2, 3> dz_dq;
+  dz_dq(0, 0) = 1.0
+      / sqrt(
+          1.0
+              / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0)
+                  + p_(2, 0) * p_(2, 0))) * 1.0
+      / sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0)) * 1.0
+      / pow(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0),
+            3.0 / 2.0)
+      * (C_q(2, 1) * p_ip(2, 0) * (p_(0, 0) * p_(0, 0))
+          - C_q(2, 2) * p_ip(1, 0) * (p_(0, 0) * p_(0, 0))
+          + C_q(2, 1) * p_ip(2, 0) * (p_(1, 0) * p_(1, 0))
+          - C_q(2, 2) * p_ip(1, 0) * (p_(1, 0) * p_(1, 0))
+          - C_q(0, 1) * p_ip(2, 0) * p_(0, 0) * p_(2, 0)
+          + C_q(0, 2) * p_ip(1, 0) * p_(0, 0) * p_(2, 0)
+          - C_q(1, 1) * p_ip(2, 0) * p_(1, 0) * p_(2, 0)
+          + C_q(1, 2) * p_ip(1, 0) * p_(1, 0) * p_(2, 0));
+  dz_dq(0, 1) = -1.0
+      / sqrt(
+          -(p_(2, 0) * p_(2, 0))
+              / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0)
+                  + p_(2, 0) * p_(2, 0)) + 1.0) * 1.0
+      / pow(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0),
+            3.0 / 2.0)
+      * (C_q(2, 0) * p_ip(2, 0) * (p_(0, 0) * p_(0, 0))
+          - C_q(2, 2) * p_ip(0, 0) * (p_(0, 0) * p_(0, 0))
+          + C_q(2, 0) * p_ip(2, 0) * (p_(1, 0) * p_(1, 0))
+          - C_q(2, 2) * p_ip(0, 0) * (p_(1, 0) * p_(1, 0))
+          - C_q(0, 0) * p_ip(2, 0) * p_(0, 0) * p_(2, 0)
+          + C_q(0, 2) * p_ip(0, 0) * p_(0, 0) * p_(2, 0)
+          - C_q(1, 0) * p_ip(2, 0) * p_(1, 0) * p_(2, 0)
+          + C_q(1, 2) * p_ip(0, 0) * p_(1, 0) * p_(2, 0));
+  dz_dq(0, 2) = 1.0
+      / sqrt(
+          1.0
+              / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0)
+                  + p_(2, 0) * p_(2, 0))) * 1.0
+      / sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0)) * 1.0
+      / pow(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0),
+            3.0 / 2.0)
+      * (C_q(2, 0) * p_ip(1, 0) * (p_(0, 0) * p_(0, 0))
+          - C_q(2, 1) * p_ip(0, 0) * (p_(0, 0) * p_(0, 0))
+          + C_q(2, 0) * p_ip(1, 0) * (p_(1, 0) * p_(1, 0))
+          - C_q(2, 1) * p_ip(0, 0) * (p_(1, 0) * p_(1, 0))
+          - C_q(0, 0) * p_ip(1, 0) * p_(0, 0) * p_(2, 0)
+          + C_q(0, 1) * p_ip(0, 0) * p_(0, 0) * p_(2, 0)
+          - C_q(1, 0) * p_ip(1, 0) * p_(1, 0) * p_(2, 0)
+          + C_q(1, 1) * p_ip(0, 0) * p_(1, 0) * p_(2, 0));
+  dz_dq(1, 0) = (p_(1, 0) * (C_q(0, 1) * p_ip(2, 0) - C_q(0, 2) * p_ip(1, 0))
+      - p_(0, 0) * (C_q(1, 1) * p_ip(2, 0) - C_q(1, 2) * p_ip(1, 0)))
+      / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0));
+  dz_dq(1, 1) = -(p_(1, 0) * (C_q(0, 0) * p_ip(2, 0) - C_q(0, 2) * p_ip(0, 0))
+      - p_(0, 0) * (C_q(1, 0) * p_ip(2, 0) - C_q(1, 2) * p_ip(0, 0)))
+      / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0));
+  dz_dq(1, 2) = (p_(1, 0) * (C_q(0, 0) * p_ip(1, 0) - C_q(0, 1) * p_ip(0, 0))
+      - p_(0, 0) * (C_q(1, 0) * p_ip(1, 0) - C_q(1, 1) * p_ip(0, 0)))
+      / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0));
+  Eigen::Matrix<double, 2, 3> dz_dp_ip;
+  dz_dp_ip(0, 0) =
+      -1.0
+          / sqrt(
+              -(p_(2, 0) * p_(2, 0))
+                  / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0)
+                      + p_(2, 0) * p_(2, 0)) + 1.0) * 1.0
+          / pow(
+              p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0),
+              3.0 / 2.0)
+          * (C_q(2, 0) * (p_(0, 0) * p_(0, 0))
+              + C_q(2, 0) * (p_(1, 0) * p_(1, 0))
+              - C_q(0, 0) * p_(0, 0) * p_(2, 0)
+              - C_q(1, 0) * p_(1, 0) * p_(2, 0));
+  dz_dp_ip(0, 1) =
+      -1.0
+          / sqrt(
+              -(p_(2, 0) * p_(2, 0))
+                  / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0)
+                      + p_(2, 0) * p_(2, 0)) + 1.0) * 1.0
+          / pow(
+              p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0),
+              3.0 / 2.0)
+          * (C_q(2, 1) * (p_(0, 0) * p_(0, 0))
+              + C_q(2, 1) * (p_(1, 0) * p_(1, 0))
+              - C_q(0, 1) * p_(0, 0) * p_(2, 0)
+              - C_q(1, 1) * p_(1, 0) * p_(2, 0));
+  dz_dp_ip(0, 2) =
+      -1.0
+          / sqrt(
+              -(p_(2, 0) * p_(2, 0))
+                  / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0)
+                      + p_(2, 0) * p_(2, 0)) + 1.0) * 1.0
+          / pow(
+              p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0),
+              3.0 / 2.0)
+          * (C_q(2, 2) * (p_(0, 0) * p_(0, 0))
+              + C_q(2, 2) * (p_(1, 0) * p_(1, 0))
+              - C_q(0, 2) * p_(0, 0) * p_(2, 0)
+              - C_q(1, 2) * p_(1, 0) * p_(2, 0));
+  dz_dp_ip(1, 0) = -(C_q(0, 0) * p_(1, 0) - C_q(1, 0) * p_(0, 0))
+      / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0));
+  dz_dp_ip(1, 1) = -(C_q(0, 1) * p_(1, 0) - C_q(1, 1) * p_(0, 0))
+      / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0));
+  dz_dp_ip(1, 2) = -(C_q(0, 2) * p_(1, 0) - C_q(1, 2) * p_(0, 0))
+      / (p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0));
+  H.block<2, 3>(0, idx_p) = dz_dp;
+  H.block<2, 3>(0, idx_q) = dz_dq;
+  H.block<2, 3>(0, idx_p_ip) = dz_dp_ip;
+}
+
+void ReferenceDistanceH(const State& s, DistanceH& H) {
+  const Matrix3 C_q = s.C_q.transpose();
+  const Vector3& p_ = s.p;
+  const Vector3& p_ip = s.p_ic;
+  H.setZero();
+  Eigen::Matrix<double, 1, 3> dz_dp;
+  dz_dp(0, 0) = p_(0, 0) * 1.0
+      / sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0));
+  dz_dp(0, 1) = p_(1, 0) * 1.0
+      / sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0));
+  dz_dp(0, 2) = p_(2, 0) * 1.0
+      / sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0));
+  Eigen::Matrix<double, 1, 3> dz_dq;
+  dz_dq(0, 0) = (p_(0, 0)
+      * (C_q(0, 1) * p_ip(2, 0) * 2.0 - C_q(0, 2) * p_ip(1, 0) * 2.0)
+      + p_(1, 0)
+          * (C_q(1, 1) * p_ip(2, 0) * 2.0 - C_q(1, 2) * p_ip(1, 0) * 2.0)
+      + p_(2, 0)
+          * (C_q(2, 1) * p_ip(2, 0) * 2.0 - C_q(2, 2) * p_ip(1, 0) * 2.0))
+      * 1.0
+      / sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0))
+      * (-1.0 / 2.0);
+  dz_dq(0, 1) = (p_(0, 0)
+      * (C_q(0, 0) * p_ip(2, 0) * 2.0 - C_q(0, 2) * p_ip(0, 0) * 2.0)
+      + p_(1, 0)
+          * (C_q(1, 0) * p_ip(2, 0) * 2.0 - C_q(1, 2) * p_ip(0, 0) * 2.0)
+      + p_(2, 0)
+          * (C_q(2, 0) * p_ip(2, 0) * 2.0 - C_q(2, 2) * p_ip(0, 0) * 2.0))
+      * 1.0
+      / sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0))
+      * (1.0 / 2.0);
+  dz_dq(0, 2) = (p_(0, 0)
+      * (C_q(0, 0) * p_ip(1, 0) * 2.0 - C_q(0, 1) * p_ip(0, 0) * 2.0)
+      + p_(1, 0)
+          * (C_q(1, 0) * p_ip(1, 0) * 2.0 - C_q(1, 1) * p_ip(0, 0) * 2.0)
+      + p_(2, 0)
+          * (C_q(2, 0) * p_ip(1, 0) * 2.0 - C_q(2, 1) * p_ip(0, 0) * 2.0))
+      * 1.0
+      / sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0))
+      * (-1.0 / 2.0);
+  Eigen::Matrix<double, 1, 3> dz_dp_ip;
+  dz_dp_ip(0, 0) = (C_q(0, 0) * p_(0, 0) + C_q(1, 0) * p_(1, 0)
+      + C_q(2, 0) * p_(2, 0)) * 1.0
+      / sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0));
+  dz_dp_ip(0, 1) = (C_q(0, 1) * p_(0, 0) + C_q(1, 1) * p_(1, 0)
+      + C_q(2, 1) * p_(2, 0)) * 1.0
+      / sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0));
+  dz_dp_ip(0, 2) = (C_q(0, 2) * p_(0, 0) + C_q(1, 2) * p_(1, 0)
+      + C_q(2, 2) * p_(2, 0)) * 1.0
+      / sqrt(p_(0, 0) * p_(0, 0) + p_(1, 0) * p_(1, 0) + p_(2, 0) * p_(2, 0));
+  H.block<1, 3>(0, idx_p) = dz_dp;
+  H.block<1, 3>(0, idx_q) = dz_dq;
+  H.block<1, 3>(0, idx_p_ip) = dz_dp_ip;
+}
+
+// The generated kernels, with the same interface.
+void KernelPoseH(const State& s, PoseH& H) {
+  H.setZero();
+  msf_updates::pose_measurement::PoseJacobian(
+      s.C_q, s.C_wv, s.C_ic, s.p, s.p_wv, s.p_ic, s.L, idx_p, idx_q, idx_L,
+      idx_q_wv, idx_p_ic, idx_p_wv, idx_q_ic, H);
+}
+
+void KernelPosePrediction(const State& s, Vector3& z_p) {
+  msf_updates::pose_measurement::PosePositionPrediction(s.C_q, s.C_wv, s.p,
+                                                        s.p_wv, s.p_ic, s.L,
+                                                        z_p);
+}
+
+void KernelPositionH(const State& s, PositionH& H) {
+  H.setZero();
+  msf_updates::position_measurement::PositionJacobian(s.C_q, s.p, s.p_ic,
+                                                      idx_p, idx_q, idx_p_ip,
+                                                      H);
+}
+
+void KernelPositionPrediction(const State& s, Vector3& z_p) {
+  msf_updates::position_measurement::PositionPrediction(s.C_q, s.p, s.p_ic,
+                                                        z_p);
+}
+
+void KernelAngleH(const State& s, AngleH& H) {
+  H.setZero();
+  msf_spherical_position::AngleJacobian(s.C_q, s.p, s.p_ic, idx_p, idx_q,
+                                        idx_p_ip, H);
+}
+
+void KernelDistanceH(const State& s, DistanceH& H) {
+  H.setZero();
+  msf_spherical_position::DistanceJacobian(s.C_q, s.p, s.p_ic, idx_p, idx_q,
+                                           idx_p_ip, H);
+}
+
+/// Calls f on every state, returns the time per call [ns].
+template<typename Output_T>
+double Time(const std::function<void(const State&, Output_T&)>& f,
+            const std::vector<State>& states, int repetitions,
+            double& checksum) {
+  Output_T output;
+  const Clock::time_point start = Clock::now();
+  for (int r = 0; r < repetitions; ++r) {
+    for (size_t i = 0; i < states.size(); ++i) {
+      f(states[i], output);
+      checksum += output(0, 0);
+    }
+  }
+  return std::chrono::duration<double, std::nano>(Clock::now() - start)
+      .count() / (repetitions * states.size());
+}
+
+/// Prints one line of the comparison, returns false if the outputs differ.
+template<typename Output_T>
+bool Compare(const char* name,
+             const std::function<void(const State&, Output_T&)>& reference,
+             const std::function<void(const State&, Output_T&)>& kernel,
+             const std::vector<State>& states, int repetitions) {
+  double max_error = 0;
+  Output_T expected, actual;
+  for (size_t i = 0; i < states.size(); ++i) {
+    reference(states[i], expected);
+    kernel(states[i], actual);
+    max_error = std::max(max_error, (expected - actual).cwiseAbs().maxCoeff()
+        / std::max(1.0, expected.cwiseAbs().maxCoeff()));
+  }
+  double checksum = 0;
+  const double time_reference = Time(reference, states, repetitions, checksum);
+  const double time_kernel = Time(kernel, states, repetitions, checksum);
+  const bool ok = max_error < 1e-12;
+  std::printf("%22s %12.2e %16.1f %16.1f %s\n", name, max_error,
+              time_reference, time_kernel, ok ? "" : "FAILED");
+  // Keeps the calls from being optimized away.
+  if (checksum == 0.123)
+    std::printf("\n");
+  return ok;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  int repetitions = 1000;
+  if (argc > 1)
+    repetitions = std::atoi(argv[1]);
+  std::mt19937 generator(42);
+  std::vector<State> states;
+  for (int i = 0; i < 1000; ++i)
+    states.push_back(RandomState(generator));
+
+  std::printf("%22s %12s %16s %16s\n", "kernel", "max error",
+              "reference [ns]", "generated [ns]");
+  bool ok = true;
+  ok &= Compare<PoseH>("pose H", ReferencePoseH, KernelPoseH, states,
+                       repetitions);
+  ok &= Compare<Vector3>("pose prediction", ReferencePosePrediction,
+                         KernelPosePrediction, states, repetitions);
+  ok &= Compare<PositionH>("position H", ReferencePositionH, KernelPositionH,
+                           states, repetitions);
+  ok &= Compare<Vector3>("position prediction", ReferencePositionPrediction,
+                         KernelPositionPrediction, states, repetitions);
+  ok &= Compare<AngleH>("spherical angle H", ReferenceAngleH, KernelAngleH,
+                        states, repetitions);
+  ok &= Compare<DistanceH>("spherical distance H", ReferenceDistanceH,
+                           KernelDistanceH, states, repetitions);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2012-2013 Simon Lynen, ASL, ETH Zurich, Switzerland
+ * You can contact the author at <slynen at ethz dot ch>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/*
+ * Runs the pose_msf filter on simulated IMU readings at 200 Hz and delayed
+ * position measurements at 20 Hz, which fall between two IMU readings. Once
+ * with a state inserted into the buffer for every measurement and once with
+ * virtual states (core/virtual_measurement_states), on the same data. Prints
+ * the processing time of the IMU readings and measurements per measurement and
+ * the final position error and standard deviation.
+ *
+ * Usage: benchmark_virtual_states [seconds]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+#include <msf_core/msf_core.h>
+#include <msf_core/msf_IMUHandler.h>
+#include <msf_core/msf_sensormanager.h>
+#include "../pose_msf/msf_statedef.hpp"
+
+namespace {
+typedef msf_updates::EKFState EKFState_T;
+typedef EKFState_T::StateDefinition_T StateDefinition_T;
+typedef std::chrono::steady_clock Clock;
+
+enum {
+  nErrorStates = EKFState_T::nErrorStatesAtCompileTime,
+  /// The position is the first core state.
+  idxErrorState_p = 0
+};
+
+const double kImuPeriod = 0.005;
+const double kMeasurementPeriod = 0.05;
+/// Offset of the measurements from the IMU readings [s].
+const double kMeasurementOffset = 0.0025;
+const double kMeasurementDelay = 0.03;
+const double kMeasurementStddev = 0.01;
+
+class Manager : public msf_core::MSF_SensorManager<EKFState_T> {
+ public:
+  void Init(double /*scale*/) const {
+  }
+  void ResetState(EKFState_T& /*state*/) const {
+  }
+  void InitState(EKFState_T& /*state*/) const {
+  }
+  void CalculateQAuxiliaryStates(EKFState_T& /*state*/, double /*dt*/) const {
+  }
+  void SetStateCovariance(EKFState_T::P_type& /*P*/) const {
+  }
+  void AugmentCorrectionVector(
+      Eigen::Matrix<double, nErrorStates, 1>& /*correction*/) const {
+  }
+  void SanityCheckCorrection(
+      EKFState_T& /*delaystate*/, const EKFState_T& /*buffstate*/,
+      Eigen::Matrix<double, nErrorStates, 1>& /*correction*/) const {
+  }
+  bool GetParamFixedBias() const {
+    return false;
+  }
+  double GetParamNoiseAcc() const {
+    return 0.083;
+  }
+  double GetParamNoiseAccbias() const {
+    return 0.0083;
+  }
+  double GetParamNoiseGyr() const {
+    return 0.0013;
+  }
+  double GetParamNoiseGyrbias() const {
+    return 0.00013;
+  }
+  double GetParamFuzzyTrackingThreshold() const {
+    return 0.1;
+  }
+  double GetParamMaxProcessingLag() const {
+    return 0;
+  }
+  void PublishStateInitial(const shared_ptr<EKFState_T>& /*state*/) const {
+  }
+  void PublishStateAfterPropagation(
+      const shared_ptr<EKFState_T>& /*state*/) const {
+  }
+  void PublishStateAfterUpdate(const shared_ptr<EKFState_T>& /*state*/) const {
+  }
+};
+
+class IMUHandler : public msf_core::IMUHandler<EKFState_T> {
+ public:
+  IMUHandler(Manager& manager)
+      : msf_core::IMUHandler<EKFState_T>(manager, "", "") {
+  }
+  virtual bool Initialize() {
+    return true;
+  }
+};
+
+/// Absolute measurement of the position of the IMU.
+class PositionMeasurement : public msf_core::MSF_MeasurementBase<EKFState_T> {
+ public:
+  PositionMeasurement(const Eigen::Vector3d& z, double time)
+      : msf_core::MSF_MeasurementBase<EKFState_T>(true, 0),
+        z_(z) {
+    this->time = time;
+  }
+  virtual void Apply(shared_ptr<EKFState_T> state,
+                     msf_core::MSF_Core<EKFState_T>& core) {
+    Eigen::Matrix<double, 3, nErrorStates> H;
+    H.setZero();
+    H.block<3, 3>(0, idxErrorState_p).setIdentity();
+    const EKFState_T& state_const = *state;
+    const Eigen::Vector3d residual = z_
+        - state_const.Get<StateDefinition_T::p>();
+    const Eigen::Matrix3d R = Eigen::Matrix3d::Identity()
+        * kMeasurementStddev * kMeasurementStddev;
+    this->CalculateAndApplyCorrection(state, core, H, residual, R);
+  }
+  virtual std::string Type() {
+    return "position";
+  }
+ private:
+  Eigen::Vector3d z_;
+};
+
+struct Result {
+  double seconds_per_measurement;
+  double position_error;
+  double position_stddev;
+};
+
+/// Runs the filter on a robot standing at the origin.
+Result Run(double duration, bool virtual_states) {
+  Manager manager;
+  IMUHandler imu_handler(manager);
+  msf_core::MSF_Core<EKFState_T>& core = *manager.msf_core_;
+  core.SetVirtualMeasurementStates(virtual_states);
+
+  const double t0 = 1000;
+  const Eigen::Vector3d g(0, 0, 9.81);
+  shared_ptr<msf_core::MSF_InitMeasurement<EKFState_T> > init(
+      new msf_core::MSF_InitMeasurement<EKFState_T>(true));
+  init->time = t0;
+  init->SetStateInitValue<StateDefinition_T::p>(Eigen::Vector3d(0.1, 0, 0));
+  init->SetStateInitValue<StateDefinition_T::v>(Eigen::Vector3d::Zero());
+  init->SetStateInitValue<StateDefinition_T::q>(
+      Eigen::Quaterniond::Identity());
+  init->SetStateInitValue<StateDefinition_T::b_w>(Eigen::Vector3d::Zero());
+  init->SetStateInitValue<StateDefinition_T::b_a>(Eigen::Vector3d::Zero());
+  init->SetStateInitValue<StateDefinition_T::L>(
+      Eigen::Matrix<double, 1, 1>::Constant(1));
+  init->SetStateInitValue<StateDefinition_T::q_wv>(
+      Eigen::Quaterniond::Identity());
+  init->SetStateInitValue<StateDefinition_T::p_wv>(Eigen::Vector3d::Zero());
+  init->SetStateInitValue<StateDefinition_T::q_ic>(
+      Eigen::Quaterniond::Identity());
+  init->SetStateInitValue<StateDefinition_T::p_ic>(Eigen::Vector3d::Zero());
+  init->Getw_m().setZero();
+  init->Geta_m() = g;
+  core.Init(init);
+
+  std::mt19937 generator(42);
+  std::normal_distribution<double> imu_noise(0, 0.01);
+  std::normal_distribution<double> measurement_noise(0, kMeasurementStddev);
+
+  Clock::duration elapsed = Clock::duration::zero();
+  int num_measurements = 0;
+  double next_measurement = t0 + kMeasurementPeriod + kMeasurementOffset;
+  const int num_imu = static_cast<int>(duration / kImuPeriod);
+  for (int i = 1; i <= num_imu; ++i) {
+    const double t = t0 + i * kImuPeriod;
+    const Eigen::Vector3d a_m = g + Eigen::Vector3d(imu_noise(generator),
+                                                    imu_noise(generator),
+                                                    imu_noise(generator));
+    const Eigen::Vector3d w_m = 0.1 * Eigen::Vector3d(imu_noise(generator),
+                                                      imu_noise(generator),
+                                                      imu_noise(generator));
+    const Clock::time_point start = Clock::now();
+    imu_handler.ProcessIMU(a_m, w_m, t, i);
+    if (t >= next_measurement + kMeasurementDelay) {
+      const Eigen::Vector3d z(measurement_noise(generator),
+                              measurement_noise(generator),
+                              measurement_noise(generator));
+      core.AddMeasurement(shared_ptr<PositionMeasurement>(
+          new PositionMeasurement(z, next_measurement)));
+      next_measurement += kMeasurementPeriod;
+      ++num_measurements;
+    }
+    elapsed += Clock::now() - start;
+  }
+
+  const shared_ptr<const EKFState_T> state = core.GetClosestState(
+      t0 + num_imu * kImuPeriod);
+  Result result;
+  result.seconds_per_measurement = std::chrono::duration<double>(elapsed)
+      .count() / num_measurements;
+  result.position_error = state->Get<StateDefinition_T::p>().norm();
+  result.position_stddev = std::sqrt(
+      state->P.block<3, 3>(idxErrorState_p, idxErrorState_p).trace());
+  return result;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  ros::Time::init();
+  double duration = 60;
+  if (argc > 1)
+    duration = std::atof(argv[1]);
+
+  std::printf("%10s %22s %18s %18s\n", "states", "time/measurement [us]",
+              "position err [m]", "position std [m]");
+  const bool modes[] = { false, true };
+  for (bool virtual_states : modes) {
+    const Result result = Run(duration, virtual_states);
+    std::printf("%10s %22.1f %18.4f %18.4f\n",
+                virtual_states ? "virtual" : "inserted",
+                result.seconds_per_measurement * 1e6, result.position_error,
+                result.position_stddev);
+  }
+  return 0;
+}
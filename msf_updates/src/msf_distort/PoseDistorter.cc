@@ -16,75 +16,131 @@
  */
 #include <msf_updates/PoseDistorter.h>
 #include <msf_core/eigen_utils.h>
-#include <ros/ros.h>
+#include <msf_core/msf_macros.h>
+#include <cassert>
+#include <iomanip>
 
 namespace msf_updates {
 
+namespace {
+// Rows of the draw vectors.
+enum {
+  idxPos = 0,
+  idxScale = 3,
+  idxAtt = 4
+};
+}
+
 PoseDistorter::PoseDistorter(const Eigen::Vector3d& meanposdrift,
                              const Eigen::Vector3d& stddevposdrift,
                              const Eigen::Vector3d& meanattdrift,
                              const Eigen::Vector3d& stddevattdrift,
                              const double meanscaledrift,
-                             const double stddevscaledrift)
-    : gen_(rd_()) {
-  posdrift_.setZero();
-  attdrift_.setIdentity();
-  scaledrift_ = 1;
-  for (int i = 0; i < 3; ++i) {
-    d_pos_[i] = distribution_t(meanposdrift(i), stddevposdrift(i));
-    d_att_[i] = distribution_t(meanattdrift(i), stddevattdrift(i));
-  }
-  d_scale = distribution_t(meanscaledrift, stddevscaledrift);
-
-  MSF_WARN_STREAM(
-      "Distortion:\nPosition: Mean:"<<meanposdrift.transpose()<<" stddev: "<<stddevposdrift.transpose()<< "\nAttitude: Mean:"<<meanattdrift.transpose()<<" stddev: "<<stddevattdrift.transpose()<< "\nScale: Mean:"<<meanscaledrift<<" stddev: "<<stddevscaledrift);
+                             const double stddevscaledrift) {
+  Init(meanposdrift, stddevposdrift, meanattdrift, stddevattdrift,
+       meanscaledrift, stddevscaledrift);
+  std::random_device rd;
+  Reset(rd());
+}
 
+PoseDistorter::PoseDistorter(const Eigen::Vector3d& meanposdrift,
+                             const Eigen::Vector3d& stddevposdrift,
+                             const Eigen::Vector3d& meanattdrift,
+                             const Eigen::Vector3d& stddevattdrift,
+                             const double meanscaledrift,
+                             const double stddevscaledrift,
+                             unsigned int seed) {
+  Init(meanposdrift, stddevposdrift, meanattdrift, stddevattdrift,
+       meanscaledrift, stddevscaledrift);
+  Reset(seed);
 }
 
 PoseDistorter::~PoseDistorter() {
 
 }
 
-void PoseDistorter::Distort(Eigen::Vector3d& pos, double dt) {
-  //calculate distortions
-  Eigen::Vector3d deltapos;
-  deltapos << d_pos_[0](gen_) * dt, d_pos_[1](gen_) * dt, d_pos_[2](gen_) * dt;
+void PoseDistorter::Init(const Eigen::Vector3d& meanposdrift,
+                         const Eigen::Vector3d& stddevposdrift,
+                         const Eigen::Vector3d& meanattdrift,
+                         const Eigen::Vector3d& stddevattdrift,
+                         const double meanscaledrift,
+                         const double stddevscaledrift) {
+  verbose_ = false;
+  mean_ << meanposdrift, meanscaledrift, meanattdrift;
+  stddev_ << stddevposdrift, stddevscaledrift, stddevattdrift;
+
+  MSF_WARN_STREAM(
+      "Distortion:\nPosition: Mean:"<<meanposdrift.transpose()<<" stddev: "<<
+      stddevposdrift.transpose()<< "\nAttitude: Mean:"<<
+      meanattdrift.transpose()<<" stddev: "<<stddevattdrift.transpose()<<
+      "\nScale: Mean:"<<meanscaledrift<<" stddev: "<<stddevscaledrift);
+}
+
+void PoseDistorter::Reset(unsigned int seed) {
+  gen_.seed(seed);
+  d_std_.reset();
+  posdrift_.setZero();
+  attdrift_.setIdentity();
+  scaledrift_ = 1;
+}
 
-  double deltascale = d_scale(gen_) * dt;
+void PoseDistorter::DrawRates(size_t n, double dt) {
+  if (static_cast<size_t>(draws_.cols()) < n)
+    draws_.resize(Eigen::NoChange, n);
 
-  //add to rand walk
+  // Draw all random numbers in sample order, then scale them at once.
+  double* data = draws_.data();
+  const size_t ndraws = n * nDrawsPerSample;
+  for (size_t i = 0; i < ndraws; ++i)
+    data[i] = d_std_(gen_);
+
+  draws_.leftCols(n).array().colwise() *= (stddev_ * dt).array();
+  draws_.leftCols(n).colwise() += mean_ * dt;
+}
+
+void PoseDistorter::ApplyPosition(Eigen::Vector3d& pos,
+                                  const Eigen::Vector3d& deltapos,
+                                  double deltascale) {
+  // Add to rand walk.
   posdrift_ += deltapos;
   scaledrift_ += deltascale;
 
-  std::stringstream ss;
-  ss << "Distort POS original: [" << pos.transpose() << "] posdrift: ["
-      << posdrift_.transpose() << "] scale: " << scaledrift_;
+  MSF_INFO_STREAM_COND(
+      verbose_, "Distort POS original: [" << pos.transpose() << "] posdrift: ["
+      << posdrift_.transpose() << "] scale: " << scaledrift_);
 
-  //augment state
+  // Augment state.
   pos += posdrift_;
   pos *= scaledrift_;
-  ss << " distorted: [" << pos.transpose() << "]";
-
-  MSF_INFO_STREAM(ss.str());
-
 }
 
-void PoseDistorter::Distort(Eigen::Quaterniond& att, double dt) {
-  //calculate distortions
-  Eigen::Vector3d rpydist;
-  rpydist << d_att_[0](gen_) * dt, d_att_[1](gen_) * dt, d_att_[2](gen_) * dt;
+void PoseDistorter::ApplyAttitude(Eigen::Quaterniond& att,
+                                  const Eigen::Vector3d& rpydist) {
   Eigen::Quaterniond deltaquat = QuaternionFromSmallAngle(rpydist);
-
   deltaquat.normalize();
 
-  //add to rand walk
+  // Add to rand walk.
   attdrift_ *= deltaquat;
 
-  //augment state
+  // Augment state.
   att *= attdrift_;
-  MSF_INFO_STREAM(
-      "Distort att:  ["<<attdrift_.w()<<", "<<attdrift_.x()<<", "<<attdrift_.y()<<", "<<attdrift_.z()<<"]");
+  MSF_INFO_STREAM_COND(verbose_, "Distort att: "<<STREAMQUAT(attdrift_));
+}
+
+void PoseDistorter::Distort(Eigen::Vector3d& pos, double dt) {
+  Eigen::Matrix<double, 4, 1> rates;
+  for (int i = 0; i < 4; ++i)
+    rates(i) = d_std_(gen_) * (stddev_(idxPos + i) * dt)
+        + mean_(idxPos + i) * dt;
+  ApplyPosition(pos, rates.head<3>(), rates(idxScale));
+}
 
+void PoseDistorter::Distort(Eigen::Quaterniond& att, double dt) {
+  Eigen::Vector3d rpydist;
+  for (int i = 0; i < 3; ++i)
+    rpydist(i) = d_std_(gen_) * (stddev_(idxAtt + i) * dt)
+        + mean_(idxAtt + i) * dt;
+  ApplyAttitude(att, rpydist);
 }
 
 void PoseDistorter::Distort(Eigen::Vector3d& pos, Eigen::Quaterniond& att,
@@ -93,4 +149,47 @@ void PoseDistorter::Distort(Eigen::Vector3d& pos, Eigen::Quaterniond& att,
   Distort(att, dt);
 }
 
-} /* namespace msf_updates */
+void PoseDistorter::Distort(PositionVector& pos, AttitudeVector& att,
+                            double dt) {
+  assert(pos.size() == att.size());
+  const size_t n = pos.size();
+  DrawRates(n, dt);
+  for (size_t i = 0; i < n; ++i) {
+    ApplyPosition(pos[i], draws_.block<3, 1>(idxPos, i), draws_(idxScale, i));
+    ApplyAttitude(att[i], draws_.block<3, 1>(idxAtt, i));
+  }
+}
+
+void PoseDistorter::Distort(PositionVector& pos, double dt) {
+  const size_t n = pos.size();
+  // Position only uses the first four rows, draw them in sample order.
+  if (static_cast<size_t>(draws_.cols()) < n)
+    draws_.resize(Eigen::NoChange, n);
+  for (size_t i = 0; i < n; ++i)
+    for (int j = idxPos; j < idxAtt; ++j)
+      draws_(j, i) = d_std_(gen_);
+  draws_.topLeftCorner(idxAtt, n).array().colwise() *=
+      (stddev_.head<idxAtt>() * dt).array();
+  draws_.topLeftCorner(idxAtt, n).colwise() += mean_.head<idxAtt>() * dt;
+
+  for (size_t i = 0; i < n; ++i)
+    ApplyPosition(pos[i], draws_.block<3, 1>(idxPos, i), draws_(idxScale, i));
+}
+
+void PoseDistorter::Distort(AttitudeVector& att, double dt) {
+  const size_t n = att.size();
+  // Attitude only uses the last three rows, draw them in sample order.
+  if (static_cast<size_t>(draws_.cols()) < n)
+    draws_.resize(Eigen::NoChange, n);
+  for (size_t i = 0; i < n; ++i)
+    for (int j = idxAtt; j < nDrawsPerSample; ++j)
+      draws_(j, i) = d_std_(gen_);
+  draws_.bottomLeftCorner(3, n).array().colwise() *=
+      (stddev_.tail<3>() * dt).array();
+  draws_.bottomLeftCorner(3, n).colwise() += mean_.tail<3>() * dt;
+
+  for (size_t i = 0; i < n; ++i)
+    ApplyAttitude(att[i], draws_.block<3, 1>(idxAtt, i));
+}
+
+}  // namespace msf_updates
@@ -271,9 +271,7 @@ class PoseSensorManager : public msf_core::MSF_SensorManagerROS<
         (dt * npicv.cwiseProduct(npicv)).asDiagonal();
   }
 
-  virtual void SetStateCovariance(
-      Eigen::Matrix<double, EKFState_T::nErrorStatesAtCompileTime,
-          EKFState_T::nErrorStatesAtCompileTime>& P) const {
+  virtual void SetStateCovariance(EKFState_T::P_type& P) const {
     UNUSED(P);
     // Nothing, we only use the simulated cov for the core plus diagonal for the
     // rest.
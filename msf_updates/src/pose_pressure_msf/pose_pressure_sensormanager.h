@@ -231,9 +231,7 @@ class PosePressureSensorManager : public msf_core::MSF_SensorManagerROS<
         .asDiagonal();
   }
 
-  virtual void SetStateCovariance(
-      Eigen::Matrix<double, EKFState_T::nErrorStatesAtCompileTime,
-          EKFState_T::nErrorStatesAtCompileTime>& P) const {
+  virtual void SetStateCovariance(EKFState_T::P_type& P) const {
     UNUSED(P);
   }
 
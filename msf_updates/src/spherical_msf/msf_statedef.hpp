@@ -17,52 +17,23 @@
 #ifndef MSF_STATEDEF_HPP_
 #define MSF_STATEDEF_HPP_
 
-#include <Eigen/Dense>
-#include <msf_core/msf_fwds.h>
-#include <boost/fusion/container.hpp>
-#include <boost/static_assert.hpp>
+#include <msf_core/msf_statecomposition.h>
+#include <msf_updates/position_sensor_handler/position_states.h>
 
 namespace msf_updates {
-
 /*
  * This file contains the state definition of the EKF as defined for a given set
- * of sensors / states to estimate.
- */
-
-enum StateDefinition {  // Must not manually set the enum values!
-  p,
-  v,
-  q,
-  b_w,
-  b_a,
-  p_ip
-};
-
-namespace {
-
-/***
- * Setup core state, then auxiliary state.
+ * of sensors / states to estimate: the core states followed by the calibration
+ * states of each sensor, in the order of the packs.
  */
-typedef boost::fusion::vector<
-    // States varying during propagation - must not change the ordering here for
-    // now, CalcQ has the ordering hardcoded.
-    msf_core::StateVar_T<Eigen::Matrix<double, 3, 1>, p,
-        msf_core::CoreStateWithPropagation>,  ///< Position (IMU centered).          (0-2 / 0-2)
-    msf_core::StateVar_T<Eigen::Matrix<double, 3, 1>, v,
-        msf_core::CoreStateWithPropagation>,  ///< Velocity.                         (3- 5 / 3- 5)
-    msf_core::StateVar_T<Eigen::Quaternion<double>, q,
-        msf_core::CoreStateWithPropagation>,  ///< Attitude.                         (6- 9 / 6- 8)
-    msf_core::StateVar_T<Eigen::Matrix<double, 3, 1>, b_w,
-        msf_core::CoreStateWithoutPropagation>,  ///< Gyro biases.                      (10-12 / 9-11)
-    msf_core::StateVar_T<Eigen::Matrix<double, 3, 1>, b_a,
-        msf_core::CoreStateWithoutPropagation>,  ///< Acceleration biases.             (13-15 / 12-14)
+typedef msf_core::ComposeStates<
+    msf_core::CoreStatePack,
+    msf_updates::position_measurement::PositionSensorStatePack> StateComposition_T;
 
-    // States not varying during propagation.
-    msf_core::StateVar_T<Eigen::Matrix<double, 3, 1>, p_ip>  ///< Prism-imu position calibration.
-> fullState_T;
-}
+typedef StateComposition_T::StateDefinition StateDefinition;
+typedef StateComposition_T::StateSequence_T fullState_T;
 
-typedef msf_core::GenericState_T<fullState_T, StateDefinition> EKFState;
+typedef msf_core::GenericState_T<fullState_T, StateDefinition> EKFState;  ///< The state we want to use in this EKF.
 typedef boost::shared_ptr<EKFState> EKFStatePtr;
 typedef boost::shared_ptr<const EKFState> EKFStateConstPtr;
 }
@@ -52,6 +52,21 @@ class SensorManager : public msf_core::MSF_SensorManagerROS<
         new DistanceSensorHandler_T(*this, "", "spherical_position_sensor"));
     AddHandler(distance_handler_);
 
+    // Apply angle and distance readings with the same stamp in one update.
+    bool joint_update;
+    pnh.param("joint_update", joint_update, false);
+    if (joint_update) {
+      double joint_update_max_dt;
+      pnh.param("joint_update_max_dt", joint_update_max_dt, 1e-3);
+      pairing_.reset(
+          new SphericalMeasurementPairing(*this, joint_update_max_dt));
+      angle_handler_->SetPairing(pairing_);
+      distance_handler_->SetPairing(pairing_);
+      ROS_INFO_STREAM("Spherical position sensor applies angle and distance "
+                      "readings within " << joint_update_max_dt
+                      << " s as one update");
+    }
+
     reconf_server_.reset(new ReconfigureServer(pnh));
     ReconfigureServer::CallbackType f = boost::bind(&SensorManager::Config,
                                                     this, _1, _2);
@@ -67,6 +82,7 @@ class SensorManager : public msf_core::MSF_SensorManagerROS<
  private:
   boost::shared_ptr<AngleSensorHandler_T> angle_handler_;
   boost::shared_ptr<DistanceSensorHandler_T> distance_handler_;
+  boost::shared_ptr<SphericalMeasurementPairing> pairing_;
 
   Config_T config_;
   ReconfigureServerPtr reconf_server_;
@@ -180,9 +196,7 @@ class SensorManager : public msf_core::MSF_SensorManagerROS<
         (dt * npipv.cwiseProduct(npipv)).asDiagonal();
   }
 
-  virtual void SetStateCovariance(
-      Eigen::Matrix<double, EKFState_T::nErrorStatesAtCompileTime,
-          EKFState_T::nErrorStatesAtCompileTime>& P) const {
+  virtual void SetStateCovariance(EKFState_T::P_type& P) const {
     UNUSED(P);
     // Nothing, we only use the simulated cov for the core plus diagonal for the rest.
   }
@@ -34,7 +34,8 @@ int main(){
   double meanscaledrift = 0.001;
   double stddevscaledrift = 0.0001;
 
-  msf_updates::PoseDistorter dist(meanpos, stddevpos, meanatt, stddevatt, meanscaledrift, stddevscaledrift);
+  const unsigned int seed = 42;
+  msf_updates::PoseDistorter dist(meanpos, stddevpos, meanatt, stddevatt, meanscaledrift, stddevscaledrift, seed);
 
   Eigen::Vector3d pos;
   pos.setZero();
@@ -50,4 +51,15 @@ int main(){
     std::cout<<"att "<<i<<": ["<<att.w()<<", "<<att.x()<<", "<<att.y()<<", "<<att.z()<<"]"<<std::endl<<std::endl;
   }
 
+  // The batch interface draws the same sequence for the same seed.
+  msf_updates::PoseDistorter batchdist(meanpos, stddevpos, meanatt, stddevatt, meanscaledrift, stddevscaledrift, seed);
+  msf_updates::PoseDistorter::PositionVector positions(10, Eigen::Vector3d::Zero());
+  msf_updates::PoseDistorter::AttitudeVector attitudes(10, Eigen::Quaterniond::Identity());
+  batchdist.Distort(positions, attitudes, dt);
+
+  std::cout<<"batch distortions"<<std::endl;
+  std::cout<<"pos 9: ["<<positions.back().transpose()<<"]"<<std::endl;
+  std::cout<<"att 9: ["<<attitudes.back().w()<<", "<<attitudes.back().x()<<", "<<attitudes.back().y()<<", "<<attitudes.back().z()<<"]"<<std::endl;
+  std::cout<<"drift difference to single sample interface: "<<(dist.GetPositionDrift() - batchdist.GetPositionDrift()).norm()<<std::endl;
+
 }